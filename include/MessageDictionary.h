@@ -0,0 +1,22 @@
+/*
+ * Pre-shared dictionary for dictionary-coded messages (lib/Lzss), compiled into the
+ * sender and every receiver; they must be built from the same version
+ * - Generated by the dict tool from bench/corpus/messages.txt, don't edit; retrain with
+ *   .pio/build/dict/program train bench/corpus/messages.txt --write
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <Lzss.h>
+
+static const uint8_t MESSAGE_DICT_ID = 0x07;
+static const char MESSAGE_DICT_TEXT[] =
+    "ET {\"id\":3,\"temp\":3{\"id\":2,\"temp\":2node 1 ok uptime=,\"amp\":{\"id\""
+    ":4,\"temp\":3{\"id\":5,\"temp\":,\"volt\":1node 3 ok uptime=WARN node ,\""
+    "event\":\"node {\"id\":3,\"temp\":{\"id\":3,\",\"ts\":17000,\"rpm\":2,\"rpm\":1"
+    "s free=1{\"id\":4,\"temp\":{\"id\":2,\"temp\":,\"state\":\"FAULT\"}{\"id\":1,\""
+    "temp\":,\"fault\":false},\"temp\":2,\"state\":\"IDLE\"},\"state\":\"BOOT\"},\""
+    "temp\":3 ok uptime=,\"state\":\"RUN\"},\"rpm\":,\"temp\":{\"id\":,\"state\":\"";
+static const lzss::Dictionary MESSAGE_DICT = {(const uint8_t *)MESSAGE_DICT_TEXT,
+                                            sizeof(MESSAGE_DICT_TEXT) - 1, MESSAGE_DICT_ID};
@@ -0,0 +1,218 @@
+/*
+ * Asynchronous, rate-limited logging
+ * - LOG_E/LOG_W/LOG_I/LOG_D(fmt, args...) store a small binary record (timestamp,
+ *   format pointer, up to 4 integer args) in a ring; no formatting, no Serial
+ * - Formatting and output happen later in drain(), run from a low-priority task
+ *   (see AsyncLogTask.h) or whatever loop owns the output
+ * - Levels above LOG_LEVEL compile to nothing, so disabled calls cost no code at all
+ * - Never blocks: records are dropped (and counted) when the ring is full, when
+ *   another context is logging at the same moment, or when the rate limit is hit
+ *
+ * Format strings must be literals (only the pointer is stored) and args integers
+ * (%d %u %x %X %c); they are stored as 32-bit values.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#else
+#include <chrono>
+#endif
+
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// Records buffered between producers and the drain task (power of two, 28 B each)
+#ifndef LOG_RING_SIZE
+#define LOG_RING_SIZE 128
+#endif
+
+// Sustained records per second and burst size; 0 disables rate limiting
+#ifndef LOG_RATE_PER_SEC
+#define LOG_RATE_PER_SEC 200
+#endif
+#ifndef LOG_RATE_BURST
+#define LOG_RATE_BURST 64
+#endif
+
+namespace asynclog {
+
+static const uint8_t MAX_ARGS = 4;
+
+struct Record {
+  uint32_t    us;
+  const char *fmt;
+  uint32_t    args[MAX_ARGS];
+  uint8_t     level;
+};
+
+struct LogStats {
+  uint32_t written;     // records stored
+  uint32_t dropped;     // ring full or another context was logging
+  uint32_t rateLimited; // over LOG_RATE_PER_SEC
+};
+
+inline uint32_t nowUs() {
+#if defined(ARDUINO)
+  return micros();
+#else
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+inline const char *levelTag(uint8_t level) {
+  switch (level) {
+    case LOG_LEVEL_ERROR: return "E";
+    case LOG_LEVEL_WARN:  return "W";
+    case LOG_LEVEL_INFO:  return "I";
+    default:              return "D";
+  }
+}
+
+template <uint32_t CAPACITY>
+class Logger {
+  static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0, "Logger capacity must be a power of two");
+
+public:
+  Logger(uint32_t ratePerSec = LOG_RATE_PER_SEC, uint32_t burst = LOG_RATE_BURST)
+      : head(0), tail(0), busy(false), rate(ratePerSec), burst(burst),
+        tokensMilli(burst * 1000), lastRefillUs(0), writtenCount(0), droppedCount(0), limitedCount(0) {}
+
+  // Producer side, any context. Several producers are serialised by a try-lock:
+  // losing the race drops the record instead of waiting.
+  void write(uint8_t level, const char *fmt, uint32_t a0 = 0, uint32_t a1 = 0, uint32_t a2 = 0, uint32_t a3 = 0) {
+    if (busy.exchange(true, std::memory_order_acquire)) {
+      droppedCount.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    const uint32_t us = nowUs();
+    if (!takeToken(us)) {
+      busy.store(false, std::memory_order_release);
+      limitedCount.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    const uint32_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= CAPACITY) {
+      busy.store(false, std::memory_order_release);
+      droppedCount.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    Record &r = slots[h & (CAPACITY - 1)];
+    r.us = us;
+    r.fmt = fmt;
+    r.args[0] = a0; r.args[1] = a1; r.args[2] = a2; r.args[3] = a3;
+    r.level = level;
+    head.store(h + 1, std::memory_order_release);
+    busy.store(false, std::memory_order_release);
+    writtenCount.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Consumer side, one context only. Formats up to `max` records and hands each
+  // line (no trailing newline) to sink(const char *); returns how many were written.
+  template <typename Sink>
+  uint32_t drain(Sink &sink, uint32_t max = CAPACITY) {
+    uint32_t n = 0;
+    char line[160];
+    while (n < max) {
+      const uint32_t t = tail.load(std::memory_order_relaxed);
+      if (t == head.load(std::memory_order_acquire)) break;
+      const Record r = slots[t & (CAPACITY - 1)];
+      tail.store(t + 1, std::memory_order_release);
+      format(r, line, sizeof(line));
+      sink(line);
+      n++;
+    }
+    return n;
+  }
+
+  static void format(const Record &r, char *out, size_t cap) {
+    int used = snprintf(out, cap, "[%6lu.%06lu] %s ", (unsigned long)(r.us / 1000000UL),
+                        (unsigned long)(r.us % 1000000UL), levelTag(r.level));
+    if (used < 0 || (size_t)used >= cap) return;
+    // Unused trailing args are ignored by the format
+    snprintf(out + used, cap - used, r.fmt, r.args[0], r.args[1], r.args[2], r.args[3]);
+  }
+
+  LogStats stats() const {
+    LogStats s;
+    s.written = writtenCount.load(std::memory_order_relaxed);
+    s.dropped = droppedCount.load(std::memory_order_relaxed);
+    s.rateLimited = limitedCount.load(std::memory_order_relaxed);
+    return s;
+  }
+
+  static uint32_t capacity() { return CAPACITY; }
+
+private:
+  // Token bucket in thousandths of a record; only touched while holding `busy`
+  bool takeToken(uint32_t us) {
+    if (rate == 0) return true;
+    const uint32_t elapsed = us - lastRefillUs;
+    lastRefillUs = us;
+    const uint64_t refill = (uint64_t)elapsed * rate / 1000;
+    const uint64_t cap = (uint64_t)burst * 1000;
+    const uint64_t tokens = tokensMilli + refill;
+    tokensMilli = (uint32_t)(tokens > cap ? cap : tokens);
+    if (tokensMilli < 1000) return false;
+    tokensMilli -= 1000;
+    return true;
+  }
+
+  Record slots[CAPACITY];
+  std::atomic<uint32_t> head;
+  std::atomic<uint32_t> tail;
+  std::atomic<bool>     busy;
+  uint32_t rate;
+  uint32_t burst;
+  uint32_t tokensMilli;
+  uint32_t lastRefillUs;
+  std::atomic<uint32_t> writtenCount;
+  std::atomic<uint32_t> droppedCount;
+  std::atomic<uint32_t> limitedCount;
+};
+
+typedef Logger<LOG_RING_SIZE> DefaultLogger;
+
+// The one logger every LOG_* macro writes to
+inline DefaultLogger &logger() {
+  static DefaultLogger instance;
+  return instance;
+}
+
+} // namespace asynclog
+
+#define ASYNCLOG_WRITE(level, ...) asynclog::logger().write(level, __VA_ARGS__)
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_E(...) ASYNCLOG_WRITE(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_E(...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_W(...) ASYNCLOG_WRITE(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_W(...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_I(...) ASYNCLOG_WRITE(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_I(...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_D(...) ASYNCLOG_WRITE(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_D(...) do {} while (0)
+#endif
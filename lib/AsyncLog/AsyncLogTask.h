@@ -0,0 +1,47 @@
+/*
+ * ESP32 glue for AsyncLog: a low-priority FreeRTOS task that drains the logger to Serial
+ * - Runs on core 0 below every CAN task, so printing only uses otherwise idle time
+ * - Reports dropped / rate-limited record counts whenever they change
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <AsyncLog.h>
+
+#ifndef LOG_TASK_PRIORITY
+#define LOG_TASK_PRIORITY 1
+#endif
+#ifndef LOG_TASK_PERIOD_MS
+#define LOG_TASK_PERIOD_MS 10
+#endif
+
+namespace asynclog {
+
+struct SerialSink {
+  void operator()(const char *line) { Serial.println(line); }
+};
+
+inline void serialTask(void *) {
+  SerialSink sink;
+  LogStats reported = {0, 0, 0};
+  while (true) {
+    logger().drain(sink);
+    const LogStats s = logger().stats();
+    if (s.dropped != reported.dropped || s.rateLimited != reported.rateLimited) {
+      Serial.print("⚠ Log records dropped: "); Serial.print(s.dropped);
+      Serial.print(", rate-limited: "); Serial.print(s.rateLimited);
+      Serial.print(" (written: "); Serial.print(s.written); Serial.println(")");
+      reported = s;
+    }
+    vTaskDelay(pdMS_TO_TICKS(LOG_TASK_PERIOD_MS));
+  }
+}
+
+inline void startSerialTask() {
+  xTaskCreatePinnedToCore(serialTask, "log", 4096, nullptr, LOG_TASK_PRIORITY, nullptr, 0);
+}
+
+} // namespace asynclog
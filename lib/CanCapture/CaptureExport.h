@@ -0,0 +1,83 @@
+/*
+ * Export formats for CaptureRing records
+ * - candumpLine(): can-utils log format, "(sec.usec) can0 123#DEADBEEF", which
+ *   canplayer and log2asc read
+ * - PCAP with LINKTYPE_CAN_SOCKETCAN (227): pcapGlobalHeader() once, then
+ *   pcapRecord() per frame; Wireshark decodes it directly
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(ARDUINO)
+#include <can.h>
+#else
+#include <linux/can.h>
+#endif
+
+namespace capture {
+
+static const uint32_t LINKTYPE_CAN_SOCKETCAN = 227;
+static const uint8_t PCAP_GLOBAL_HEADER_LEN = 24;
+static const uint8_t PCAP_RECORD_LEN = 16 + 16; // record header + SocketCAN can_frame
+
+// Returns the line length (without a newline), truncated to cap - 1
+inline int candumpLine(char *buf, size_t cap, uint64_t tsUs, const struct can_frame &frm, const char *iface = "can0") {
+  int n;
+  if (frm.can_id & CAN_EFF_FLAG) {
+    n = snprintf(buf, cap, "(%lu.%06lu) %s %08lX#", (unsigned long)(tsUs / 1000000), (unsigned long)(tsUs % 1000000),
+                 iface, (unsigned long)(frm.can_id & CAN_EFF_MASK));
+  } else {
+    n = snprintf(buf, cap, "(%lu.%06lu) %s %03lX#", (unsigned long)(tsUs / 1000000), (unsigned long)(tsUs % 1000000),
+                 iface, (unsigned long)(frm.can_id & CAN_SFF_MASK));
+  }
+  if (frm.can_id & CAN_RTR_FLAG) {
+    n += snprintf(buf + n, n < (int)cap ? cap - n : 0, "R");
+  } else {
+    for (uint8_t i = 0; i < frm.can_dlc && i < 8; ++i) {
+      n += snprintf(buf + n, n < (int)cap ? cap - n : 0, "%02X", frm.data[i]);
+    }
+  }
+  return n < (int)cap ? n : (int)cap - 1;
+}
+
+inline void putLe32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+// Microsecond-resolution pcap, little-endian, snaplen 16
+inline void pcapGlobalHeader(uint8_t out[PCAP_GLOBAL_HEADER_LEN]) {
+  putLe32(out, 0xA1B2C3D4);
+  out[4] = 2; out[5] = 0;   // version 2.4
+  out[6] = 4; out[7] = 0;
+  putLe32(out + 8, 0);      // thiszone
+  putLe32(out + 12, 0);     // sigfigs
+  putLe32(out + 16, 16);    // snaplen
+  putLe32(out + 20, LINKTYPE_CAN_SOCKETCAN);
+}
+
+// SocketCAN frame layout; the CAN ID (with EFF/RTR flags) is big-endian on the wire
+inline void pcapRecord(uint8_t out[PCAP_RECORD_LEN], uint64_t tsUs, const struct can_frame &frm) {
+  putLe32(out, (uint32_t)(tsUs / 1000000));
+  putLe32(out + 4, (uint32_t)(tsUs % 1000000));
+  putLe32(out + 8, 16);
+  putLe32(out + 12, 16);
+  uint8_t *p = out + 16;
+  const uint32_t id = frm.can_id & (CAN_EFF_FLAG | CAN_RTR_FLAG | CAN_EFF_MASK);
+  p[0] = (uint8_t)(id >> 24);
+  p[1] = (uint8_t)(id >> 16);
+  p[2] = (uint8_t)(id >> 8);
+  p[3] = (uint8_t)id;
+  p[4] = frm.can_dlc > 8 ? 8 : frm.can_dlc;
+  p[5] = p[6] = p[7] = 0;
+  memset(p + 8, 0, 8);
+  if (!(frm.can_id & CAN_RTR_FLAG)) memcpy(p + 8, frm.data, p[4]);
+}
+
+} // namespace capture
@@ -0,0 +1,168 @@
+/*
+ * Timestamped capture of received CAN frames in a compact byte ring
+ * - Record: varint timestamp delta (µs since the previous record), a flags/DLC byte,
+ *   the ID (2 bytes standard, 4 extended) and the data bytes; 4..17 bytes per frame
+ * - When full, the oldest records are overwritten, so the ring always holds the most
+ *   recent history; overwritten deltas fold into the base timestamp
+ * - One writer (push()) and one reader. The reader freeze()s the ring, walks it with
+ *   forEach() and thaw()s it; frames pushed while frozen are counted as skipped
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+#if defined(ARDUINO)
+#include <can.h>
+#else
+#include <linux/can.h>
+#endif
+
+struct CaptureStats {
+  uint32_t captured;    // records written
+  uint32_t overwritten; // oldest records dropped to make room
+  uint32_t skipped;     // frames not captured because a reader had the ring frozen
+};
+
+template <uint32_t BYTES>
+class CaptureRing {
+  static_assert(BYTES >= 64 && (BYTES & (BYTES - 1)) == 0, "CaptureRing size must be a power of two >= 64");
+
+public:
+  static const uint8_t MAX_RECORD = 5 + 1 + 4 + 8;
+
+  CaptureRing() : head(0), tail(0), used(0), records(0), baseUs(0), lastUs(0), st(), frozen(false), writing(false) {}
+
+  // Writer side; tsUs is a free-running microsecond clock (wraps are fine)
+  void push(uint32_t tsUs, const struct can_frame &frm) {
+    writing.store(true);
+    if (frozen.load()) {
+      writing.store(false);
+      st.skipped++;
+      return;
+    }
+    uint8_t rec[MAX_RECORD];
+    const uint8_t n = encode(rec, records ? tsUs - lastUs : 0, frm);
+    if (records == 0) baseUs = tsUs;
+    lastUs = tsUs;
+    while (BYTES - used < n) dropOldest();
+    for (uint8_t i = 0; i < n; ++i) buf[(head + i) & (BYTES - 1)] = rec[i];
+    head = (head + n) & (BYTES - 1);
+    used += n;
+    records++;
+    st.captured++;
+    writing.store(false);
+  }
+
+  // Reader side: stop the writer (waits out a push() in progress) before forEach()
+  void freeze() {
+    frozen.store(true);
+    while (writing.load()) {
+    }
+  }
+  void thaw() { frozen.store(false); }
+
+  // fn(uint64_t tsUs, const can_frame &) for every record, oldest first; timestamps
+  // are the writer's clock, widened so they keep increasing across its wraps
+  template <typename Fn>
+  void forEach(Fn fn) const {
+    uint64_t t = baseUs;
+    uint32_t pos = tail;
+    for (uint32_t r = 0; r < records; ++r) {
+      struct can_frame frm;
+      uint32_t delta;
+      pos = decode(pos, delta, frm);
+      t += delta;
+      fn(t, frm);
+    }
+  }
+
+  void clear() {
+    head = tail = used = records = 0;
+  }
+
+  uint32_t count() const { return records; }
+  uint32_t bytesUsed() const { return used; }
+  static uint32_t capacity() { return BYTES; }
+  const CaptureStats &stats() const { return st; }
+
+private:
+  static uint8_t encode(uint8_t *rec, uint32_t delta, const struct can_frame &frm) {
+    uint8_t n = 0;
+    while (delta >= 0x80) {
+      rec[n++] = (uint8_t)(delta | 0x80);
+      delta >>= 7;
+    }
+    rec[n++] = (uint8_t)delta;
+    const bool ext = (frm.can_id & CAN_EFF_FLAG) != 0;
+    const bool rtr = (frm.can_id & CAN_RTR_FLAG) != 0;
+    const uint8_t dlc = frm.can_dlc > 8 ? 8 : frm.can_dlc;
+    rec[n++] = (uint8_t)((ext ? 0x80 : 0) | (rtr ? 0x40 : 0) | dlc);
+    const uint32_t id = frm.can_id & (ext ? CAN_EFF_MASK : CAN_SFF_MASK);
+    rec[n++] = (uint8_t)id;
+    rec[n++] = (uint8_t)(id >> 8);
+    if (ext) {
+      rec[n++] = (uint8_t)(id >> 16);
+      rec[n++] = (uint8_t)(id >> 24);
+    }
+    if (!rtr) {
+      memcpy(rec + n, frm.data, dlc);
+      n += dlc;
+    }
+    return n;
+  }
+
+  uint8_t at(uint32_t pos) const { return buf[pos & (BYTES - 1)]; }
+
+  // Returns the position after the record at pos
+  uint32_t decode(uint32_t pos, uint32_t &delta, struct can_frame &frm) const {
+    delta = 0;
+    uint8_t shift = 0;
+    uint8_t b;
+    do {
+      b = at(pos++);
+      delta |= (uint32_t)(b & 0x7F) << shift;
+      shift += 7;
+    } while (b & 0x80);
+    const uint8_t flags = at(pos++);
+    frm.can_id = at(pos) | (uint32_t)at(pos + 1) << 8;
+    pos += 2;
+    if (flags & 0x80) {
+      frm.can_id |= (uint32_t)at(pos) << 16 | (uint32_t)at(pos + 1) << 24;
+      frm.can_id |= CAN_EFF_FLAG;
+      pos += 2;
+    }
+    frm.can_dlc = flags & 0x0F;
+    memset(frm.data, 0, sizeof(frm.data));
+    if (flags & 0x40) {
+      frm.can_id |= CAN_RTR_FLAG;
+    } else {
+      for (uint8_t i = 0; i < frm.can_dlc; ++i) frm.data[i] = at(pos++);
+    }
+    return pos & (BYTES - 1);
+  }
+
+  void dropOldest() {
+    struct can_frame frm;
+    uint32_t delta;
+    const uint32_t next = decode(tail, delta, frm);
+    used -= (next - tail) & (BYTES - 1);
+    tail = next;
+    records--;
+    st.overwritten++;
+    baseUs += delta; // the new oldest record's delta was relative to the one just dropped
+  }
+
+  uint8_t buf[BYTES];
+  uint32_t head;
+  uint32_t tail;
+  uint32_t used;
+  uint32_t records;
+  uint64_t baseUs; // timestamp of the oldest record minus its delta
+  uint32_t lastUs; // writer clock of the newest record
+  CaptureStats st;
+  std::atomic<bool> frozen;
+  std::atomic<bool> writing;
+};
@@ -0,0 +1,467 @@
+/*
+ * Segmented-message wire formats shared by sender and receivers
+ *
+ * Legacy framing (protocol v1):
+ * - Start frame: [0]=0xAA, [1]=lenLow, [2]=lenHigh, [3]=flags (0 in v1), [4..]=payload (up to 4 bytes)
+ * - Cont frame:  [0]=0xCC, [1]=seq(1..255, wraps), [2..]=payload (up to 6 bytes)
+ * - Parity frame: [0]=0xEE, [1]=group (wraps), [2..]=parity (6 bytes)
+ *
+ * Compact framing (protocol v2): one PCI byte, type in the high nibble
+ * - Start frame: [0]=0x40 | flags, [1]=lenLow, [2]=lenHigh, [3..]=payload (up to 5 bytes);
+ *   0x70 | flags for a message with a CRC trailer (START_FLAG_CRC, no room in the nibble)
+ * - Cont frame:  [0]=0x50 | (seq & 0x0F), [1..]=payload (up to 7 bytes), seq starts at 1
+ * - Parity frame: [0]=0x80 | (group & 0x0F), [1..]=parity (7 bytes)
+ *
+ * Extended-ID framing (protocol v3): all metadata in the 29-bit identifier
+ *   [28:26] priority  [25:24] frame type  [23:18] destination  [17:13] source
+ *   [12:11] message id (rolling)  [10:0] sequence (rolling; flags in a start frame)
+ *   destination: 0x20 | receiver mask (bit n-1 = receiver n, 0x3F = broadcast),
+ *                values below 0x20 address a single node (e.g. the sender)
+ * - Start frame: [0]=lenLow, [1]=lenHigh, [2..]=payload (up to 6 bytes)
+ * - Data frame:  [0..]=payload (up to 8 bytes), seq starts at 1
+ * - Parity frame (frame type 2): [0..]=parity (8 bytes), sequence field = group
+ *
+ * Start-frame flags (compact: PCI low nibble, legacy: byte 3, extended: sequence field):
+ * - START_FLAG_NACK: the sender resumes on a NACK, so the receiver keeps a message with
+ *   a gap and asks for the rest instead of dropping it, and confirms completion
+ * - START_FLAG_RESUME: resume marker for a message in progress; the length field holds
+ *   the (unmasked) sequence the following continuation frames start from; no payload
+ * - START_FLAG_ACK: windowed message; the receiver ACKs with a bitmap and the sender
+ *   retransmits the gaps. Such messages never resume, so bit 0 is START_FLAG_PARITY
+ *   instead, toggled per message and receiver to tell a retransmitted start frame from
+ *   the next message
+ * - START_FLAG_COMPRESSED: the payload is an LZSS stream (lib/Lzss) starting with the
+ *   decompressed length; the start frame's length field counts the bytes on the wire
+ * - START_FLAG_CRC: the last CRC_LEN bytes of the message are the CRC-32 (lib/Crc32,
+ *   little endian) of the bytes before them, as sent (compressed or not); the length
+ *   field counts them. Receivers that predate it don't know compact's 0x70 and drop the
+ *   message; legacy and extended ones deliver the trailer as data
+ * - START_FLAG_FEC: forward error correction. Such messages never resume and aren't
+ *   windowed, so it is bit 0 without START_FLAG_NACK or START_FLAG_ACK. The message's
+ *   first byte (counted in its length) is the group size K (FEC_GROUP_MIN..MAX):
+ *   continuation frames 1..K form group 0, K+1..2K group 1 and so on, and a parity frame
+ *   follows each group with the XOR of its payloads (each zero-padded to a full frame),
+ *   from which the receiver rebuilds any one missing frame of the group
+ *
+ * Control frames (receiver -> sender): standard ID baseId - 0x80 + receiver id, below
+ * every normal and bulk data frame (and every extended one) so a NACK wins arbitration
+ * against the stream it interrupts. Urgent-class standard IDs (0x001..0x005, 0x020 |
+ * mask with base 0x200) are lower still and go ahead of control frames;
+ * [0]=0x60 | type, [1]=stream tag (extended: 0x80 | source << 2 | message id, else 0)
+ * - NACK: [2..3]=next expected sequence (unmasked, 0 = the start frame); resend from there
+ * - DONE: [2..3]=message length; the message is complete
+ * - ACK:  [2..3]=cumulative sequence (every frame before it arrived, the start frame
+ *   being 0), [4..7]=bitmap, bit i = frame cumulative + 1 + i arrived (left off, DLC 4,
+ *   when it is 0)
+ * - ACK_QUIET: an ACK sent because the stream went quiet, so every frame it doesn't
+ *   cover is lost (CAN delivers in order) and can be resent at once
+ * - type bit 3 (CTRL_PARITY) echoes START_FLAG_PARITY of a windowed message
+ *
+ * The PCI type nibbles (0x4..0x8) never collide with the legacy magics (0xA_, 0xC_)
+ * or ISO-TP PCI types (0x0..0x3), so receivers detect the framing per message;
+ * extended-ID frames are told apart by CAN_EFF_FLAG.
+ *
+ * Addressing with standard IDs:
+ * - 0x200 + n: receiver n (1..5)
+ * - 0x200: broadcast to every receiver
+ * - 0x220 | mask: group, bit n-1 of mask = receiver n
+ *
+ * Priority classes (PRIO_URGENT / PRIO_NORMAL / PRIO_BULK): standard IDs carry the
+ * class in bits 10..9 in place of the base ID's (0x0__ / 0x2__ / 0x4__ with base 0x200,
+ * so traffic from before classes is normal), extended IDs in the priority field (2 / 4
+ * / 6). A lower class wins arbitration, so an urgent frame goes ahead of bulk frames
+ * queued on other nodes. Control frames keep their ID; their stream tag names the class
+ * of a standard-ID message (0 for normal, 0x40 | class otherwise).
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#if defined(ARDUINO)
+#include <can.h>
+#else
+#include <linux/can.h>
+#endif
+
+namespace canframing {
+
+enum Framing : uint8_t {
+  FRAMING_LEGACY   = 0,
+  FRAMING_COMPACT  = 1,
+  FRAMING_EXTENDED = 2,
+};
+
+enum FrameKind : uint8_t {
+  KIND_UNKNOWN = 0,
+  KIND_START   = 1,
+  KIND_CONT    = 2,
+  KIND_PARITY  = 3,
+};
+
+static const uint8_t LEGACY_MAGIC_START = 0xAA;
+static const uint8_t LEGACY_MAGIC_CONT  = 0xCC;
+
+static const uint8_t PCI_TYPE_MASK = 0xF0;
+static const uint8_t PCI_LOW_MASK  = 0x0F;
+static const uint8_t PCI_START     = 0x40; // low nibble: START_FLAG_*
+static const uint8_t PCI_CONT      = 0x50; // low nibble: rolling sequence
+static const uint8_t PCI_CTRL      = 0x60; // low nibble: control type
+static const uint8_t PCI_START_CRC = 0x70; // start frame with START_FLAG_CRC
+static const uint8_t PCI_PARITY    = 0x80; // low nibble: FEC group (rolling)
+static const uint8_t LEGACY_MAGIC_PARITY = 0xEE;
+
+static const uint8_t START_FLAG_RESUME = 0x01;
+static const uint8_t START_FLAG_NACK   = 0x02;
+static const uint8_t START_FLAG_ACK    = 0x04;
+static const uint8_t START_FLAG_PARITY = 0x01; // with START_FLAG_ACK only
+static const uint8_t START_FLAG_COMPRESSED = 0x08;
+static const uint8_t START_FLAG_CRC    = 0x10;
+static const uint8_t CRC_LEN           = 4; // trailer bytes with START_FLAG_CRC
+static const uint8_t START_FLAG_FEC    = 0x01; // without START_FLAG_NACK/START_FLAG_ACK only
+static const uint8_t FEC_GROUP_MIN = 2, FEC_GROUP_MAX = 32; // data frames per parity frame
+
+static const uint16_t CTRL_ID_OFFSET = 0x80; // below baseId
+static const uint8_t  CTRL_NACK = 0x0;
+static const uint8_t  CTRL_DONE = 0x1;
+static const uint8_t  CTRL_ACK  = 0x2;
+static const uint8_t  CTRL_ACK_QUIET = 0x3;
+static const uint8_t  CTRL_TYPE_MASK = 0x07;
+static const uint8_t  CTRL_PARITY    = 0x08;
+static const uint8_t  CTRL_LEN  = 4;
+static const uint8_t  ACK_LEN   = 8;
+static const uint8_t  ACK_WINDOW_MAX = 32; // frames in flight, bounded by the ACK bitmap
+
+static const uint32_t MAX_MESSAGE_LEN = 65535;
+
+// Extended identifier fields
+static const uint8_t  EXT_TYPE_START = 0;
+static const uint8_t  EXT_TYPE_DATA  = 1;
+static const uint8_t  EXT_TYPE_PARITY = 2;
+static const uint8_t  EXT_PRIO_DEFAULT = 4;
+static const uint8_t  EXT_DEST_GROUP = 0x20;     // set: low 5 bits are a receiver mask
+static const uint8_t  EXT_DEST_BROADCAST = 0x3F; // group containing every receiver
+static const uint8_t  EXT_PRIO_SHIFT = 26, EXT_TYPE_SHIFT = 24, EXT_DEST_SHIFT = 18;
+static const uint8_t  EXT_SRC_SHIFT = 13, EXT_MSGID_SHIFT = 11;
+static const uint32_t EXT_PRIO_MASK = 0x07, EXT_TYPE_MASK = 0x03, EXT_DEST_MASK = 0x3F;
+static const uint32_t EXT_SRC_MASK = 0x1F, EXT_MSGID_MASK = 0x03, EXT_SEQ_MASK = 0x7FF;
+
+struct ExtId {
+  uint8_t  prio;
+  uint8_t  type;
+  uint8_t  dest;
+  uint8_t  src;
+  uint8_t  msgId;
+  uint16_t seq;
+};
+
+inline uint32_t packExtId(const ExtId &h) {
+  return ((uint32_t)(h.prio & EXT_PRIO_MASK) << EXT_PRIO_SHIFT) |
+         ((uint32_t)(h.type & EXT_TYPE_MASK) << EXT_TYPE_SHIFT) |
+         ((uint32_t)(h.dest & EXT_DEST_MASK) << EXT_DEST_SHIFT) |
+         ((uint32_t)(h.src & EXT_SRC_MASK) << EXT_SRC_SHIFT) |
+         ((uint32_t)(h.msgId & EXT_MSGID_MASK) << EXT_MSGID_SHIFT) |
+         ((uint32_t)h.seq & EXT_SEQ_MASK);
+}
+
+inline ExtId unpackExtId(uint32_t canId) {
+  ExtId h;
+  h.prio  = (uint8_t)((canId >> EXT_PRIO_SHIFT) & EXT_PRIO_MASK);
+  h.type  = (uint8_t)((canId >> EXT_TYPE_SHIFT) & EXT_TYPE_MASK);
+  h.dest  = (uint8_t)((canId >> EXT_DEST_SHIFT) & EXT_DEST_MASK);
+  h.src   = (uint8_t)((canId >> EXT_SRC_SHIFT) & EXT_SRC_MASK);
+  h.msgId = (uint8_t)((canId >> EXT_MSGID_SHIFT) & EXT_MSGID_MASK);
+  h.seq   = (uint16_t)(canId & EXT_SEQ_MASK);
+  return h;
+}
+
+inline bool isExtended(const struct can_frame &frm) { return (frm.can_id & CAN_EFF_FLAG) != 0; }
+
+// Priority classes, most urgent first
+enum PriorityClass : uint8_t {
+  PRIO_URGENT = 0,
+  PRIO_NORMAL = 1,
+  PRIO_BULK   = 2,
+};
+static const uint8_t  PRIO_CLASSES = 3;
+static const uint8_t  STD_PRIO_SHIFT = 9;
+static const uint16_t STD_PRIO_BITS = 0x600;
+static const uint8_t  STD_TAG_CLASS = 0x40; // stream tag of a non-normal standard-ID message
+
+// Standard ID `id` moved to priority class `cls`
+inline uint16_t stdClassId(uint32_t id, uint8_t cls) {
+  return (uint16_t)((id & CAN_SFF_MASK & ~(uint32_t)STD_PRIO_BITS) | ((uint32_t)cls << STD_PRIO_SHIFT));
+}
+
+// Extended-ID priority field for a class: 2 / 4 (EXT_PRIO_DEFAULT) / 6
+inline uint8_t extClassPrio(uint8_t cls) { return (uint8_t)(EXT_PRIO_DEFAULT + 2 * cls - 2 * PRIO_NORMAL); }
+
+// Priority class of a frame; the unused standard class 3 counts as bulk
+inline uint8_t frameClass(const struct can_frame &frm) {
+  if (isExtended(frm)) {
+    const uint8_t prio = (uint8_t)((frm.can_id >> EXT_PRIO_SHIFT) & EXT_PRIO_MASK);
+    return prio < EXT_PRIO_DEFAULT ? PRIO_URGENT : (prio > EXT_PRIO_DEFAULT ? PRIO_BULK : PRIO_NORMAL);
+  }
+  const uint8_t cls = (uint8_t)((frm.can_id & STD_PRIO_BITS) >> STD_PRIO_SHIFT);
+  return cls > PRIO_BULK ? (uint8_t)PRIO_BULK : cls;
+}
+
+// Receiver addressing: receivers 1..5 are bits 0..4 of a receiver mask
+static const uint8_t  RECEIVER_MASK_ALL = 0x1F;
+static const uint16_t STD_GROUP_OFFSET  = 0x20; // baseId + 0x20 | mask
+
+enum AddressKind : uint8_t {
+  ADDR_NONE      = 0, // not addressed to this receiver
+  ADDR_UNICAST   = 1,
+  ADDR_GROUP     = 2,
+  ADDR_BROADCAST = 3,
+};
+
+inline uint8_t receiverBit(uint8_t receiverId) { return (uint8_t)(1u << (receiverId - 1)); }
+
+inline uint8_t maskCount(uint8_t mask) {
+  uint8_t n = 0;
+  for (; mask; mask &= (uint8_t)(mask - 1)) n++;
+  return n;
+}
+
+// Lowest receiver id in a mask (1..5), 0 if empty
+inline uint8_t firstReceiver(uint8_t mask) {
+  for (uint8_t id = 1; id <= 5; ++id) {
+    if (mask & receiverBit(id)) return id;
+  }
+  return 0;
+}
+
+// Standard CAN ID reaching exactly the receivers in `mask`
+inline uint16_t stdTargetId(uint16_t baseId, uint8_t mask) {
+  mask &= RECEIVER_MASK_ALL;
+  if (mask == RECEIVER_MASK_ALL) return baseId;
+  if (maskCount(mask) == 1) return (uint16_t)(baseId + firstReceiver(mask));
+  return (uint16_t)(baseId + STD_GROUP_OFFSET + mask);
+}
+
+// Extended-ID destination field reaching exactly the receivers in `mask`
+inline uint8_t extTargetDest(uint8_t mask) { return (uint8_t)(EXT_DEST_GROUP | (mask & RECEIVER_MASK_ALL)); }
+
+// How (if at all) a frame is addressed to `receiverId`
+inline AddressKind addressFor(const struct can_frame &frm, uint16_t baseId, uint8_t receiverId) {
+  const uint8_t bit = receiverBit(receiverId);
+  uint8_t mask;
+  if (isExtended(frm)) {
+    const uint8_t dest = (uint8_t)((frm.can_id >> EXT_DEST_SHIFT) & EXT_DEST_MASK);
+    if (!(dest & EXT_DEST_GROUP)) return ADDR_NONE;
+    mask = dest & RECEIVER_MASK_ALL;
+  } else {
+    // Every priority class addresses the same receivers
+    const uint32_t id = stdClassId(frm.can_id, (uint8_t)((baseId & STD_PRIO_BITS) >> STD_PRIO_SHIFT));
+    if (id == baseId) return ADDR_BROADCAST;
+    if (id == (uint32_t)baseId + receiverId) return ADDR_UNICAST;
+    if ((id & ~(uint32_t)RECEIVER_MASK_ALL) != (uint32_t)baseId + STD_GROUP_OFFSET) return ADDR_NONE;
+    mask = (uint8_t)(id & RECEIVER_MASK_ALL);
+  }
+  if (!(mask & bit)) return ADDR_NONE;
+  if (mask == RECEIVER_MASK_ALL) return ADDR_BROADCAST;
+  return mask == bit ? ADDR_UNICAST : ADDR_GROUP;
+}
+
+inline uint8_t startHeaderLen(Framing f) { return f == FRAMING_LEGACY ? 4 : (f == FRAMING_COMPACT ? 3 : 2); }
+inline uint8_t contHeaderLen(Framing f)  { return f == FRAMING_LEGACY ? 2 : (f == FRAMING_COMPACT ? 1 : 0); }
+inline uint8_t startPayloadMax(Framing f) { return (uint8_t)(8 - startHeaderLen(f)); }
+inline uint8_t contPayloadMax(Framing f)  { return (uint8_t)(8 - contHeaderLen(f)); }
+
+// Bits of the sequence number that actually travel on the wire
+inline uint16_t seqMask(Framing f) {
+  return f == FRAMING_LEGACY ? 0xFF : (f == FRAMING_COMPACT ? PCI_LOW_MASK : EXT_SEQ_MASK);
+}
+
+// Largest ACK window the wire sequence can disambiguate: the receiver places a frame
+// by taking the unmasked sequence nearest to its cumulative position
+inline uint8_t maxWindow(Framing f) {
+  const uint16_t half = (uint16_t)((seqMask(f) + 1) / 2);
+  return half < ACK_WINDOW_MAX ? (uint8_t)half : ACK_WINDOW_MAX;
+}
+
+// Unmasked sequence for wire sequence `seq`: the one within half the sequence space of `near`
+inline uint16_t unwrapSeq(Framing f, uint16_t seq, uint16_t near) {
+  const uint16_t mask = seqMask(f);
+  const uint16_t ahead = (uint16_t)((seq - near) & mask);
+  if (ahead <= mask / 2) return (uint16_t)(near + ahead);
+  return (uint16_t)(near - ((near - seq) & mask));
+}
+
+// Extended-ID start frames carry the flags in the identifier, see extFrameId()
+inline void writeStartHeader(struct can_frame &frm, Framing f, uint16_t len, uint8_t flags = 0) {
+  if (f == FRAMING_LEGACY) {
+    frm.data[0] = LEGACY_MAGIC_START;
+    frm.data[1] = (uint8_t)(len & 0xFF);
+    frm.data[2] = (uint8_t)((len >> 8) & 0xFF);
+    frm.data[3] = flags;
+  } else if (f == FRAMING_COMPACT) {
+    frm.data[0] = (uint8_t)(((flags & START_FLAG_CRC) ? PCI_START_CRC : PCI_START) | (flags & PCI_LOW_MASK));
+    frm.data[1] = (uint8_t)(len & 0xFF);
+    frm.data[2] = (uint8_t)((len >> 8) & 0xFF);
+  } else {
+    frm.data[0] = (uint8_t)(len & 0xFF);
+    frm.data[1] = (uint8_t)((len >> 8) & 0xFF);
+  }
+}
+
+// Extended-ID frames carry the sequence in the identifier, see extFrameId()
+inline void writeContHeader(struct can_frame &frm, Framing f, uint16_t seq) {
+  if (f == FRAMING_LEGACY) {
+    frm.data[0] = LEGACY_MAGIC_CONT;
+    frm.data[1] = (uint8_t)seq;
+  } else if (f == FRAMING_COMPACT) {
+    frm.data[0] = (uint8_t)(PCI_CONT | (seq & PCI_LOW_MASK));
+  }
+}
+
+// Full can_id (with CAN_EFF_FLAG) for an extended-ID start or data frame
+inline uint32_t extFrameId(uint8_t type, uint8_t dest, uint8_t src, uint8_t msgId, uint16_t seq,
+                           uint8_t prio = EXT_PRIO_DEFAULT) {
+  ExtId h;
+  h.prio = prio;
+  h.type = type;
+  h.dest = dest;
+  h.src = src;
+  h.msgId = msgId;
+  h.seq = seq;
+  return packExtId(h) | CAN_EFF_FLAG;
+}
+
+// Identify a received frame and the framing it was sent with
+inline FrameKind classify(const struct can_frame &frm, Framing &f) {
+  if (isExtended(frm)) {
+    f = FRAMING_EXTENDED;
+    const uint8_t type = unpackExtId(frm.can_id & CAN_EFF_MASK).type;
+    if (type == EXT_TYPE_START) return frm.can_dlc >= 2 ? KIND_START : KIND_UNKNOWN;
+    if (type == EXT_TYPE_DATA) return KIND_CONT;
+    if (type == EXT_TYPE_PARITY) return KIND_PARITY;
+    return KIND_UNKNOWN;
+  }
+  if (frm.can_dlc < 1) return KIND_UNKNOWN;
+  const uint8_t b0 = frm.data[0];
+  if (b0 == LEGACY_MAGIC_START) { f = FRAMING_LEGACY; return KIND_START; }
+  if (b0 == LEGACY_MAGIC_CONT)  { f = FRAMING_LEGACY; return KIND_CONT; }
+  if (b0 == LEGACY_MAGIC_PARITY) { f = FRAMING_LEGACY; return KIND_PARITY; }
+  if ((b0 & PCI_TYPE_MASK) == PCI_START || (b0 & PCI_TYPE_MASK) == PCI_START_CRC) { f = FRAMING_COMPACT; return KIND_START; }
+  if ((b0 & PCI_TYPE_MASK) == PCI_CONT)  { f = FRAMING_COMPACT; return KIND_CONT; }
+  if ((b0 & PCI_TYPE_MASK) == PCI_PARITY) { f = FRAMING_COMPACT; return KIND_PARITY; }
+  return KIND_UNKNOWN;
+}
+
+// Identifies the message a frame belongs to, for keeping concurrent reassemblies apart:
+// extended IDs carry source + message id; standard IDs only have the CAN ID itself
+inline uint32_t streamKey(const struct can_frame &frm) {
+  if (isExtended(frm)) {
+    return 0x80000000UL | ((frm.can_id >> EXT_MSGID_SHIFT) & ((EXT_SRC_MASK << 2) | EXT_MSGID_MASK));
+  }
+  return frm.can_id & CAN_SFF_MASK;
+}
+
+inline uint16_t startLength(const struct can_frame &frm, Framing f) {
+  const uint8_t at = f == FRAMING_EXTENDED ? 0 : 1;
+  return (uint16_t)frm.data[at] | ((uint16_t)frm.data[at + 1] << 8);
+}
+
+// Call only on frames classify() called KIND_START
+inline uint8_t startFlags(const struct can_frame &frm, Framing f) {
+  if (f == FRAMING_LEGACY) return frm.can_dlc >= 4 ? frm.data[3] : 0;
+  if (f == FRAMING_COMPACT) {
+    return (uint8_t)((frm.data[0] & PCI_LOW_MASK) | ((frm.data[0] & PCI_TYPE_MASK) == PCI_START_CRC ? START_FLAG_CRC : 0));
+  }
+  return (uint8_t)(frm.can_id & EXT_SEQ_MASK);
+}
+
+// Byte offset of the payload in continuation frame `seq` (unmasked, >= 1)
+inline uint32_t contOffset(Framing f, uint16_t seq) {
+  return startPayloadMax(f) + (uint32_t)(seq - 1) * contPayloadMax(f);
+}
+
+// Control frames ------------------------------------------------------------
+
+inline uint16_t ctrlId(uint16_t baseId, uint8_t receiverId) { return (uint16_t)(baseId - CTRL_ID_OFFSET + receiverId); }
+
+// Names the message a control frame is about (see the header comment)
+inline uint8_t streamTag(const struct can_frame &frm) {
+  if (!isExtended(frm)) {
+    const uint8_t cls = frameClass(frm);
+    return cls == PRIO_NORMAL ? 0 : (uint8_t)(STD_TAG_CLASS | cls);
+  }
+  return (uint8_t)(0x80 | ((frm.can_id >> EXT_MSGID_SHIFT) & ((EXT_SRC_MASK << 2) | EXT_MSGID_MASK)));
+}
+
+inline uint8_t streamTag(Framing f, uint8_t src, uint8_t msgId, uint8_t cls = PRIO_NORMAL) {
+  if (f != FRAMING_EXTENDED) return cls == PRIO_NORMAL ? 0 : (uint8_t)(STD_TAG_CLASS | cls);
+  return (uint8_t)(0x80 | ((src & EXT_SRC_MASK) << 2) | (msgId & EXT_MSGID_MASK));
+}
+
+inline void writeCtrl(struct can_frame &frm, uint16_t baseId, uint8_t receiverId, uint8_t type, uint8_t tag,
+                      uint16_t value) {
+  frm.can_id = ctrlId(baseId, receiverId);
+  frm.can_dlc = CTRL_LEN;
+  frm.data[0] = (uint8_t)(PCI_CTRL | type);
+  frm.data[1] = tag;
+  frm.data[2] = (uint8_t)(value & 0xFF);
+  frm.data[3] = (uint8_t)(value >> 8);
+}
+
+// Without gaps the bitmap is left off (DLC 4), saving 32 bits on the wire
+inline void writeAck(struct can_frame &frm, uint16_t baseId, uint8_t receiverId, uint8_t type, uint8_t tag,
+                     uint16_t cumulative, uint32_t bits) {
+  writeCtrl(frm, baseId, receiverId, type, tag, cumulative);
+  if (!bits) return;
+  frm.can_dlc = ACK_LEN;
+  for (uint8_t i = 0; i < 4; ++i) frm.data[4 + i] = (uint8_t)(bits >> (8 * i));
+}
+
+inline uint32_t ackBits(const struct can_frame &frm) {
+  if (frm.can_dlc < ACK_LEN) return 0;
+  return (uint32_t)frm.data[4] | ((uint32_t)frm.data[5] << 8) | ((uint32_t)frm.data[6] << 16) |
+         ((uint32_t)frm.data[7] << 24);
+}
+
+// Is `frm` a control frame from `receiverId`? Fills type, tag and value if so.
+inline bool readCtrl(const struct can_frame &frm, uint16_t baseId, uint8_t receiverId, uint8_t &type, uint8_t &tag,
+                     uint16_t &value) {
+  if (isExtended(frm) || (frm.can_id & CAN_SFF_MASK) != ctrlId(baseId, receiverId)) return false;
+  if (frm.can_dlc < CTRL_LEN || (frm.data[0] & PCI_TYPE_MASK) != PCI_CTRL) return false;
+  type = frm.data[0] & PCI_LOW_MASK;
+  tag = frm.data[1];
+  value = (uint16_t)frm.data[2] | ((uint16_t)frm.data[3] << 8);
+  return true;
+}
+
+// Parity frames share the continuation header layout, the group in place of the sequence
+inline void writeParityHeader(struct can_frame &frm, Framing f, uint16_t group) {
+  if (f == FRAMING_LEGACY) {
+    frm.data[0] = LEGACY_MAGIC_PARITY;
+    frm.data[1] = (uint8_t)group;
+  } else if (f == FRAMING_COMPACT) {
+    frm.data[0] = (uint8_t)(PCI_PARITY | (group & PCI_LOW_MASK));
+  }
+}
+
+// Does a start frame with these flags announce an FEC message?
+inline bool fecFlags(uint8_t flags) {
+  return (flags & (START_FLAG_FEC | START_FLAG_NACK | START_FLAG_ACK)) == START_FLAG_FEC;
+}
+
+// Rolling group of a parity frame, and the same for a continuation frame: both travel in
+// the sequence field
+inline uint16_t contSeq(const struct can_frame &frm, Framing f) {
+  if (f == FRAMING_LEGACY) return frm.data[1];
+  if (f == FRAMING_COMPACT) return (uint16_t)(frm.data[0] & PCI_LOW_MASK);
+  return (uint16_t)(frm.can_id & EXT_SEQ_MASK);
+}
+
+// Frames needed to carry a message of `len` bytes (a zero-length message is one start frame)
+inline uint32_t framesForLength(Framing f, uint32_t len) {
+  const uint32_t first = startPayloadMax(f);
+  if (len <= first) return 1;
+  const uint32_t per = contPayloadMax(f);
+  return 1 + (len - first + per - 1) / per;
+}
+
+} // namespace canframing
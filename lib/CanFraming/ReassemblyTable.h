@@ -0,0 +1,194 @@
+/*
+ * Fixed-size table of concurrent reassembly sessions
+ * - Sessions are keyed by stream (source + message id, see canframing::streamKey())
+ *   so several senders, or interleaved messages, don't reset each other
+ * - Message buffers come from a separate pool; a session only holds one while open,
+ *   together with a bitmap of the frames that arrived, so frames can be placed by
+ *   sequence in any order
+ * - Idle sessions are evicted after a timeout; a new message that finds no free
+ *   session/buffer first evicts expired sessions, otherwise it is dropped
+ * - Counters for opened/completed/evicted/aborted/dropped sessions
+ *
+ * No heap and no Arduino dependencies, so it runs unchanged on the host.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+struct ReassemblyStats {
+  uint32_t opened;    // sessions started by a start frame
+  uint32_t completed; // sessions that delivered a full message
+  uint32_t evicted;   // sessions dropped after sitting idle past the timeout
+  uint32_t aborted;   // sessions dropped on a protocol error (bad seq, restart, ...)
+  uint32_t dropped;   // start frames refused: too long, or no free session/buffer
+};
+
+struct ReassemblySession {
+  bool     active;
+  uint32_t key;       // stream key
+  uint8_t  framing;   // canframing::Framing of the message
+  uint8_t  addr;      // canframing::AddressKind of the message
+  uint16_t expected;  // total message length (on the wire, when compressed)
+  uint16_t received;  // bytes placed so far
+  uint16_t nextSeq;   // lowest frame not yet arrived (unmasked; the start frame is 0)
+  uint16_t highSeq;   // highest frame arrived
+  uint8_t  sinceAck;  // windowed: frames since the last ACK
+  uint8_t  flags;     // canframing start-frame flags
+  uint8_t  tag;       // canframing::streamTag(), for control frames
+  bool     resuming;  // NACK sent; waiting for the sender's resume marker
+  uint8_t  nacks;     // NACKs sent for this message
+  uint32_t nackUs;    // time of the last NACK
+  uint32_t lastUs;    // time of the last frame, for eviction
+  uint8_t *data;      // pool buffer holding the message
+  uint8_t *seen;      // bit n = frame n arrived
+  uint16_t plainLen;  // compressed: decompressed length (0 = not compressed)
+  uint16_t plainPos;  // compressed: bytes decompressed so far
+  uint32_t codeBit;   // compressed: decoder position in the stream
+  uint32_t crc;       // START_FLAG_CRC: running CRC of the wire bytes before crcPos
+  uint16_t crcPos;
+  uint8_t  fecK;      // START_FLAG_FEC: frames per parity group (0 = no FEC)
+  uint16_t fecGroup[2];  // group whose XOR each slot holds (groups alternate slots)
+  uint8_t  fecAcc[2][8]; // XOR of that group's payloads received so far
+};
+
+inline bool frameSeen(const ReassemblySession &s, uint16_t n) { return (s.seen[n >> 3] >> (n & 7)) & 1; }
+inline void markFrame(ReassemblySession &s, uint16_t n) { s.seen[n >> 3] |= (uint8_t)(1u << (n & 7)); }
+
+template <uint8_t SESSIONS, uint8_t BUFFERS, uint16_t BUFFER_SIZE>
+class ReassemblyTable {
+  static_assert(SESSIONS > 0 && BUFFERS > 0, "ReassemblyTable needs at least one session and buffer");
+  static_assert(BUFFERS <= 32, "buffer pool is tracked in a 32-bit mask");
+
+public:
+  // Frame bitmap per buffer, sized for the smallest continuation payload (legacy, 6 bytes)
+  static const uint16_t SEEN_BYTES = (BUFFER_SIZE / 6 + 2 + 7) / 8;
+
+  explicit ReassemblyTable(uint32_t timeoutUs = 1000000) : timeout(timeoutUs), freeMask(0), st() {
+    for (uint8_t i = 0; i < SESSIONS; ++i) sessions[i].active = false;
+    for (uint8_t i = 0; i < BUFFERS; ++i) freeMask |= (1u << i);
+  }
+
+  static uint16_t bufferSize() { return BUFFER_SIZE; }
+  void setTimeoutUs(uint32_t us) { timeout = us; }
+  const ReassemblyStats &stats() const { return st; }
+
+  ReassemblySession *find(uint32_t key) {
+    for (uint8_t i = 0; i < SESSIONS; ++i) {
+      if (sessions[i].active && sessions[i].key == key) return &sessions[i];
+    }
+    return nullptr;
+  }
+
+  // Start a session for `key`. A session already open for the same key is aborted
+  // (the sender restarted). Returns nullptr when the message is refused.
+  ReassemblySession *open(uint32_t key, uint16_t expectedLen, uint32_t nowUs) {
+    ReassemblySession *old = find(key);
+    if (old) close(old, ABORTED);
+    if (expectedLen > BUFFER_SIZE) {
+      st.dropped++;
+      return nullptr;
+    }
+
+    ReassemblySession *s = freeSession();
+    if (!s || freeMask == 0) {
+      expire(nowUs);
+      s = freeSession();
+    }
+    if (!s || freeMask == 0) {
+      st.dropped++;
+      return nullptr;
+    }
+
+    uint8_t buf = 0;
+    while (!(freeMask & (1u << buf))) buf++;
+    freeMask &= ~(1u << buf);
+
+    s->active = true;
+    s->key = key;
+    s->framing = 0;
+    s->addr = 0;
+    s->expected = expectedLen;
+    s->received = 0;
+    s->nextSeq = 1;
+    s->highSeq = 0;
+    s->sinceAck = 0;
+    s->flags = 0;
+    s->tag = 0;
+    s->resuming = false;
+    s->nacks = 0;
+    s->nackUs = 0;
+    s->lastUs = nowUs;
+    s->data = pool[buf];
+    s->seen = seenPool[buf];
+    memset(s->seen, 0, (expectedLen / 6 + 2 + 7) / 8);
+    s->plainLen = 0;
+    s->plainPos = 0;
+    s->codeBit = 0;
+    s->crc = 0;
+    s->crcPos = 0;
+    s->fecK = 0;
+    s->fecGroup[0] = s->fecGroup[1] = 0xFFFF;
+    st.opened++;
+    return s;
+  }
+
+  enum CloseReason { COMPLETED, ABORTED, EVICTED };
+
+  void close(ReassemblySession *s, CloseReason why) {
+    if (!s || !s->active) return;
+    freeMask |= (1u << bufferIndex(s->data));
+    s->active = false;
+    s->data = nullptr;
+    s->seen = nullptr;
+    switch (why) {
+      case COMPLETED: st.completed++; break;
+      case ABORTED:   st.aborted++; break;
+      case EVICTED:   st.evicted++; break;
+    }
+  }
+
+  // Evict sessions that have been idle for longer than the timeout; returns how many
+  uint8_t expire(uint32_t nowUs) {
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < SESSIONS; ++i) {
+      if (sessions[i].active && (uint32_t)(nowUs - sessions[i].lastUs) > timeout) {
+        close(&sessions[i], EVICTED);
+        n++;
+      }
+    }
+    return n;
+  }
+
+  // fn(ReassemblySession &) for every open session; fn may close it
+  template <typename Fn>
+  void forEachActive(Fn fn) {
+    for (uint8_t i = 0; i < SESSIONS; ++i) {
+      if (sessions[i].active) fn(sessions[i]);
+    }
+  }
+
+  uint8_t activeCount() const {
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < SESSIONS; ++i) n += sessions[i].active ? 1 : 0;
+    return n;
+  }
+
+private:
+  ReassemblySession *freeSession() {
+    for (uint8_t i = 0; i < SESSIONS; ++i) {
+      if (!sessions[i].active) return &sessions[i];
+    }
+    return nullptr;
+  }
+
+  uint8_t bufferIndex(const uint8_t *p) const { return (uint8_t)((p - pool[0]) / BUFFER_SIZE); }
+
+  ReassemblySession sessions[SESSIONS];
+  uint8_t  pool[BUFFERS][BUFFER_SIZE];
+  uint8_t  seenPool[BUFFERS][SEEN_BYTES];
+  uint32_t timeout;
+  uint32_t freeMask;
+  ReassemblyStats st;
+};
@@ -0,0 +1,113 @@
+/*
+ * TX-buffer-aware frame pacing for the MCP2515
+ * - Loads frames straight into the three TX buffers instead of sleeping a fixed delay per frame
+ * - Only waits when no TX buffer can be loaded without breaking frame order
+ * - Optional minimum inter-frame gap (measured between buffer loads) for slow receivers
+ *
+ * Ordering: with equal TXP priority the MCP2515 transmits pending buffers highest
+ * number first (TXB2, TXB1, TXB0). A frame is therefore only ever loaded into a
+ * buffer numbered *below* every buffer that is still pending, so frames fill
+ * TXB2 -> TXB1 -> TXB0 and the chain is refilled from TXB2 once it has drained.
+ *
+ * Driver interface (duck-typed, so a fake MCP2515 can stand in on the host):
+ *   uint8_t  txPendingMask();                              // bit n set = TXBn TXREQ pending
+ *   bool     loadTxBuffer(uint8_t n, const can_frame &frm); // write TXBn and request transmission
+ *   uint32_t micros();                                     // free-running microsecond clock
+ *   void     idle();                                       // called while waiting for a buffer
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#if defined(ARDUINO)
+#include <can.h>
+#else
+#include <linux/can.h>
+#endif
+
+struct CanPacerStats {
+  uint32_t frames;     // frames loaded into a TX buffer
+  uint32_t waits;      // frames that had to wait for a usable buffer
+  uint32_t busyPolls;  // buffer polls that found nothing usable (idle() calls while waiting)
+  uint32_t timeouts;   // frames dropped because no buffer freed up in time
+  uint32_t loadErrors; // driver refused to load a buffer
+};
+
+template <typename Driver>
+class CanPacer {
+public:
+  static const uint8_t TX_BUFFERS = 3;
+
+  explicit CanPacer(Driver &driver, uint32_t minGapUs = 0, uint32_t timeoutUs = 50000)
+      : drv(driver), minGap(minGapUs), timeout(timeoutUs), lastLoadUs(0), loadedOnce(false), st() {}
+
+  void setMinGapUs(uint32_t us) { minGap = us; }
+  uint32_t minGapUs() const { return minGap; }
+  const CanPacerStats &stats() const { return st; }
+  void resetStats() { st = CanPacerStats(); }
+
+  // Queue one frame for transmission. Returns false on timeout or driver error.
+  bool send(const struct can_frame &frm) {
+    const uint32_t start = drv.micros();
+    bool waited = false;
+    while (true) {
+      const uint32_t now = drv.micros();
+      const bool gapOk = !loadedOnce || minGap == 0 || (uint32_t)(now - lastLoadUs) >= minGap;
+      const int8_t buf = gapOk ? pickBuffer(drv.txPendingMask()) : -1;
+      if (buf >= 0) {
+        if (!drv.loadTxBuffer((uint8_t)buf, frm)) {
+          st.loadErrors++;
+          return false;
+        }
+        lastLoadUs = now;
+        loadedOnce = true;
+        st.frames++;
+        return true;
+      }
+      if (!waited) {
+        waited = true;
+        st.waits++;
+      }
+      if ((uint32_t)(now - start) >= timeout) {
+        st.timeouts++;
+        return false;
+      }
+      st.busyPolls++;
+      drv.idle();
+    }
+  }
+
+  // Wait until every TX buffer has been transmitted.
+  bool flush() {
+    const uint32_t start = drv.micros();
+    while (drv.txPendingMask() & 0x07) {
+      if ((uint32_t)(drv.micros() - start) >= timeout) {
+        st.timeouts++;
+        return false;
+      }
+      drv.idle();
+    }
+    return true;
+  }
+
+  // Highest free buffer below the lowest pending one, or -1 if loading now could reorder frames.
+  static int8_t pickBuffer(uint8_t pending) {
+    int8_t limit = TX_BUFFERS;
+    for (int8_t n = 0; n < TX_BUFFERS; ++n) {
+      if (pending & (1u << n)) {
+        limit = n;
+        break;
+      }
+    }
+    return (int8_t)(limit - 1);
+  }
+
+private:
+  Driver  &drv;
+  uint32_t minGap;
+  uint32_t timeout;
+  uint32_t lastLoadUs;
+  bool     loadedOnce;
+  CanPacerStats st;
+};
@@ -0,0 +1,228 @@
+/*
+ * Discrete-event CAN bus simulator (host only)
+ * - Bit-accurate frame length (FrameBits.h)
+ * - Arbitration by identifier (standard beats extended with the same base ID,
+ *   SRR/IDE are recessive); every node offers its next frame whenever the bus goes idle
+ * - ACK slot: a frame is acknowledged if any other node is attached in normal mode,
+ *   otherwise it costs an error frame and is retried
+ * - Each node has an MCP2515-like controller: three TX buffers (highest-numbered
+ *   pending buffer goes first, as with equal TXP priority) and a bounded RX queue;
+ *   setRxLoss() makes it miss received frames at random (seeded, so runs repeat)
+ * - Virtual clock in nanoseconds; the simulation jumps from event to event, so
+ *   idle time costs nothing
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <deque>
+#include <vector>
+#include <FrameBits.h>
+
+#if defined(ARDUINO)
+#include <can.h>
+#else
+#include <linux/can.h>
+#endif
+
+namespace cansim {
+
+static const uint64_t NEVER = ~(uint64_t)0;
+
+// Arbitration field as one comparable number: lower wins
+inline uint32_t arbitrationKey(const struct can_frame &frm) {
+  if (isExtended(frm)) {
+    const uint32_t id = frm.can_id & CAN_EFF_MASK;
+    return ((id >> 18) << 20) | (1u << 19) | (1u << 18) | (id & 0x3FFFF);
+  }
+  return (frm.can_id & CAN_SFF_MASK) << 20;
+}
+
+// MCP2515-like controller: 3 TX buffers and a bounded receive queue
+class Controller {
+public:
+  static const uint8_t TX_BUFFERS = 3;
+
+  explicit Controller(uint32_t rxCapacity = 2)
+      : pending(0), rxCap(rxCapacity), rxOverflows(0), lossPpm(0), lossState(1), rxLost(0) {}
+
+  uint8_t txPendingMask() const { return pending; }
+  bool loadTxBuffer(uint8_t n, const struct can_frame &frm) {
+    if (n >= TX_BUFFERS || (pending & (1u << n))) return false;
+    tx[n] = frm;
+    pending |= (uint8_t)(1u << n);
+    return true;
+  }
+  // Buffer that transmits next: the highest-numbered pending one (equal TXP priority)
+  int8_t nextTxBuffer() const {
+    for (int8_t n = TX_BUFFERS - 1; n >= 0; --n) {
+      if (pending & (1u << n)) return n;
+    }
+    return -1;
+  }
+
+  bool receive(struct can_frame &frm) {
+    if (rx.empty()) return false;
+    frm = rx.front();
+    rx.pop_front();
+    return true;
+  }
+  uint32_t rxQueued() const { return (uint32_t)rx.size(); }
+  uint32_t overflows() const { return rxOverflows; }
+  void setRxCapacity(uint32_t cap) { rxCap = cap; }
+
+  // Drop each received frame with probability ppm / 1e6
+  void setRxLoss(uint32_t ppm, uint32_t seed = 1) {
+    lossPpm = ppm;
+    lossState = seed ? seed : 1;
+  }
+  uint32_t lost() const { return rxLost; }
+
+private:
+  bool missNext() {
+    if (!lossPpm) return false;
+    lossState ^= lossState << 13; // xorshift32
+    lossState ^= lossState >> 17;
+    lossState ^= lossState << 5;
+    if (lossState % 1000000 >= lossPpm) return false;
+    rxLost++;
+    return true;
+  }
+
+  friend class Bus;
+  struct can_frame tx[TX_BUFFERS];
+  uint8_t pending;
+  std::deque<struct can_frame> rx;
+  uint32_t rxCap;
+  uint32_t rxOverflows;
+  uint32_t lossPpm;
+  uint32_t lossState;
+  uint32_t rxLost;
+};
+
+// A simulated node: owns a controller, gets poll()ed after every bus event
+class Node {
+public:
+  Node() : listenOnly(false) {}
+  virtual ~Node() {}
+  // Called at every event (frame delivered, bus idle, own wake-up time); may load TX buffers
+  virtual void poll(uint64_t nowNs) = 0;
+  // Next time this node wants to be polled without a bus event
+  virtual uint64_t wakeNs() const { return NEVER; }
+
+  Controller can;
+  bool listenOnly; // receives, never ACKs or transmits
+};
+
+struct BusStats {
+  uint64_t frames;
+  uint64_t bits;          // including stuffing and interframe space
+  uint64_t stuffBits;
+  uint64_t busyNs;
+  uint64_t ackErrors;
+  uint64_t arbitrationLosses; // frames that were ready but lost arbitration
+  uint64_t collisions;        // two nodes with the same arbitration field
+};
+
+class Bus {
+public:
+  explicit Bus(uint32_t bitrate = BITRATE_DEFAULT) : bitNs(1000000000ULL / bitrate), now(0), st() {}
+
+  void attach(Node &node) { nodes.push_back(&node); }
+  uint64_t nowNs() const { return now; }
+  uint64_t bitTimeNs() const { return bitNs; }
+  const BusStats &stats() const { return st; }
+
+  // Advance the simulation until `untilNs`, or until nothing is left to do
+  // (no frame pending, no node waiting for a time). Returns false in the latter case.
+  bool run(uint64_t untilNs) {
+    while (now < untilNs) {
+      pollAll();
+      if (transmitOne()) continue;
+      uint64_t wake = NEVER;
+      for (size_t i = 0; i < nodes.size(); ++i) {
+        const uint64_t w = nodes[i]->wakeNs();
+        if (w < wake) wake = w;
+      }
+      if (wake == NEVER) return false;
+      // A node that asks for "now" but had nothing to do must not stall the clock
+      now = wake > now ? (wake < untilNs ? wake : untilNs) : now + bitNs;
+    }
+    return true;
+  }
+
+private:
+  void pollAll() {
+    for (size_t i = 0; i < nodes.size(); ++i) nodes[i]->poll(now);
+  }
+
+  bool transmitOne() {
+    Node *winner = nullptr;
+    int8_t winnerBuf = -1;
+    uint32_t best = 0;
+    uint32_t contenders = 0;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      Node *n = nodes[i];
+      if (n->listenOnly) continue;
+      const int8_t b = n->can.nextTxBuffer();
+      if (b < 0) continue;
+      contenders++;
+      const uint32_t key = arbitrationKey(n->can.tx[b]);
+      if (!winner || key < best) {
+        winner = n;
+        winnerBuf = b;
+        best = key;
+      } else if (key == best) {
+        st.collisions++;
+      }
+    }
+    if (!winner) return false;
+    st.arbitrationLosses += contenders - 1;
+
+    const struct can_frame &frm = winner->can.tx[winnerBuf];
+    const FrameBits fb = frameBits(frm);
+
+    bool acked = false;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      if (nodes[i] != winner && !nodes[i]->listenOnly) acked = true;
+    }
+    if (!acked) {
+      // No ACK: error frame, the controller keeps TXREQ and tries again
+      const uint64_t bits = fb.toAck + ERROR_FRAME_BITS + IFS_BITS;
+      st.ackErrors++;
+      st.bits += bits;
+      st.busyNs += bits * bitNs;
+      now += bits * bitNs;
+      return true;
+    }
+
+    // Receivers take the frame at the end of EOF; the bus frees up after IFS
+    now += (uint64_t)fb.toEof * bitNs;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      Node *n = nodes[i];
+      if (n == winner) continue;
+      if (n->can.rx.size() >= n->can.rxCap) {
+        n->can.rxOverflows++;
+      } else if (!n->can.missNext()) {
+        n->can.rx.push_back(frm);
+      }
+    }
+    winner->can.pending &= (uint8_t)~(1u << winnerBuf);
+    pollAll();
+    now += (uint64_t)IFS_BITS * bitNs;
+
+    st.frames++;
+    st.bits += fb.total;
+    st.stuffBits += fb.stuff;
+    st.busyNs += (uint64_t)fb.total * bitNs;
+    return true;
+  }
+
+  std::vector<Node *> nodes;
+  uint64_t bitNs;
+  uint64_t now;
+  BusStats st;
+};
+
+} // namespace cansim
@@ -0,0 +1,106 @@
+/*
+ * Bit-accurate CAN 2.0 frame length, shared by the simulator and the sniffer
+ * - SOF..CRC are built bit by bit (real CRC-15) and stuffed, then CRC delimiter,
+ *   ACK slot + delimiter, EOF and the 3-bit interframe space
+ * - Portable (no heap, no STL), cheap enough to run per received frame on the ESP32
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#if defined(ARDUINO)
+#include <can.h>
+#else
+#include <linux/can.h>
+#endif
+
+namespace cansim {
+
+static const uint32_t BITRATE_DEFAULT = 500000;
+
+// Bits after the CRC field: CRC delimiter, ACK slot, ACK delimiter, 7 EOF
+static const uint8_t TRAILER_BITS = 10;
+static const uint8_t IFS_BITS = 3;
+// Error frame after a missing ACK: 6-bit flag, up to 6 echoed, 8-bit delimiter
+static const uint8_t ERROR_FRAME_BITS = 20;
+
+struct FrameBits {
+  uint16_t total;   // on the wire, including stuff bits, trailer and interframe space
+  uint16_t stuff;   // stuff bits inserted
+  uint16_t toEof;   // up to the end of EOF (when receivers accept the frame)
+  uint16_t toAck;   // up to and including the ACK slot
+};
+
+class BitWriter {
+public:
+  BitWriter() : n(0) {}
+  void put(uint32_t value, uint8_t bits) {
+    for (int8_t i = bits - 1; i >= 0; --i) b[n++] = (uint8_t)((value >> i) & 1);
+  }
+  uint8_t b[160];
+  uint16_t n;
+};
+
+inline uint16_t crc15(const uint8_t *bits, uint16_t n) {
+  uint16_t crc = 0;
+  for (uint16_t i = 0; i < n; ++i) {
+    const bool doInvert = (bits[i] ^ ((crc >> 14) & 1)) != 0;
+    crc = (uint16_t)((crc << 1) & 0x7FFF);
+    if (doInvert) crc ^= 0x4599;
+  }
+  return crc;
+}
+
+inline bool isExtended(const struct can_frame &frm) { return (frm.can_id & CAN_EFF_FLAG) != 0; }
+
+inline FrameBits frameBits(const struct can_frame &frm) {
+  BitWriter w;
+  const uint8_t dlc = frm.can_dlc > 8 ? 8 : frm.can_dlc;
+  const uint8_t rtr = (frm.can_id & CAN_RTR_FLAG) ? 1 : 0;
+  w.put(0, 1); // SOF
+  if (isExtended(frm)) {
+    const uint32_t id = frm.can_id & CAN_EFF_MASK;
+    w.put(id >> 18, 11);
+    w.put(1, 1); // SRR
+    w.put(1, 1); // IDE
+    w.put(id & 0x3FFFF, 18);
+    w.put(rtr, 1);
+    w.put(0, 2); // r1, r0
+  } else {
+    w.put(frm.can_id & CAN_SFF_MASK, 11);
+    w.put(rtr, 1);
+    w.put(0, 1); // IDE
+    w.put(0, 1); // r0
+  }
+  w.put(dlc, 4);
+  for (uint8_t i = 0; !rtr && i < dlc; ++i) w.put(frm.data[i], 8); // remote frames carry no data
+  w.put(crc15(w.b, w.n), 15);
+
+  // Stuff bit after every 5 equal bits (the stuff bit itself starts the next run)
+  uint16_t stuff = 0;
+  uint8_t run = 0;
+  uint8_t last = 2;
+  for (uint16_t i = 0; i < w.n; ++i) {
+    if (w.b[i] == last) {
+      run++;
+    } else {
+      last = w.b[i];
+      run = 1;
+    }
+    if (run == 5) {
+      stuff++;
+      last ^= 1;
+      run = 1;
+    }
+  }
+
+  FrameBits fb;
+  fb.stuff = stuff;
+  fb.toAck = (uint16_t)(w.n + stuff + 2);
+  fb.toEof = (uint16_t)(w.n + stuff + TRAILER_BITS);
+  fb.total = (uint16_t)(fb.toEof + IFS_BITS);
+  return fb;
+}
+
+} // namespace cansim
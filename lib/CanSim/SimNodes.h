@@ -0,0 +1,252 @@
+/*
+ * Simulated sender / receiver nodes running the real transport code (host only)
+ * - SenderNode: CanSegmenter feeding the controller's TX buffers in CanPacer order
+ *   (TXB2 -> TXB1 -> TXB0, never reordering), optional minimum gap like TX_MIN_GAP_US
+ * - SenderNode with a resume window: NACKs from the receiver rewind the message, and
+ *   the next message waits for the receiver's DONE (or the window running out)
+ * - SenderNode with an ACK window: frames go out as ACKs open the window; the next
+ *   message waits for DONE (or the segmenter giving up)
+ * - SenderNode messages go through CanScheduler: one message in flight per priority
+ *   class, frames of a more urgent class first
+ * - ReceiverNode: CanReassembler on the controller's RX queue, optional per-frame
+ *   service time to model a slow receive loop (frames queue up, then overflow);
+ *   expire() runs whenever it is polled, and every millisecond while a session is open
+ * - Latency = completion at the receiver minus submission at the sender
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <deque>
+#include <vector>
+#include <CanSim.h>
+#include <CanPacer.h>
+#include <CanScheduler.h>
+#include <CanReassembler.h>
+
+namespace cansim {
+
+// HAL over a simulated controller, clocked by the bus
+struct SimHal {
+  Controller &can;
+  const uint64_t &now;
+
+  SimHal(Controller &c, const uint64_t &clock) : can(c), now(clock) {}
+
+  bool sendFrame(const struct can_frame &frm) {
+    const int8_t buf = CanPacer<Controller>::pickBuffer(can.txPendingMask());
+    return buf >= 0 && can.loadTxBuffer((uint8_t)buf, frm);
+  }
+  bool receiveFrame(struct can_frame &frm) { return can.receive(frm); }
+  uint32_t micros() { return (uint32_t)(now / 1000); }
+};
+
+class SenderNode : public Node {
+public:
+  struct Message {
+    uint8_t  targetMask;
+    canframing::Framing framing;
+    const uint8_t *data;
+    uint16_t len;
+    uint8_t  flags;       // payload start flags, see CanSegmenter::start()
+    uint8_t  fec;         // FEC group size, 0 = none
+    uint8_t  prio;        // priority class
+    uint64_t submitNs;
+    uint64_t firstFrameNs;
+    uint64_t lastFrameNs; // last frame loaded
+  };
+
+  SenderNode(uint16_t baseId, uint8_t sourceId, uint32_t minGapUs = 0)
+      : clock(0), hal(can, clock), scheduler(hal, baseId, sourceId), minGapNs((uint64_t)minGapUs * 1000),
+        lastLoadNs(0), loadedOnce(false), framesLoaded(0) {
+    for (uint8_t c = 0; c < canframing::PRIO_CLASSES; ++c) {
+      head[c] = 0;
+      current[c] = 0;
+    }
+  }
+
+  // See CanSegmenter::setResumeWindowUs(); 0 = no NACK support
+  void setResumeWindowUs(uint32_t us) { scheduler.setResumeWindowUs(us); }
+  // See CanSegmenter::setWindow(); 0 = no ACKs
+  void setWindow(uint8_t frames, uint32_t rtoUs) {
+    scheduler.setWindow(frames);
+    scheduler.setRtoUs(rtoUs);
+  }
+  // See CanSegmenter::setChecksum()
+  void setChecksum(bool on) { scheduler.setChecksum(on); }
+
+  // Queue a message for transmission at `atNs` (the data must stay valid). Messages of
+  // one priority class go in submission order, one at a time.
+  void submit(uint8_t targetMask, canframing::Framing f, const uint8_t *data, uint16_t len, uint64_t atNs,
+              uint8_t flags = 0, uint8_t fec = 0, uint8_t prio = canframing::PRIO_NORMAL) {
+    Message m = {targetMask, f, data, len, flags, fec, prio, atNs, NEVER, 0};
+    queued[prio].push_back(messages.size());
+    messages.push_back(m);
+  }
+
+  void poll(uint64_t nowNs) override {
+    clock = nowNs;
+    while (true) {
+      startDue(nowNs);
+      if (loadedOnce && minGapNs && nowNs - lastLoadNs < minGapNs) {
+        scheduler.pollControl();
+        return;
+      }
+      const CanScheduler<SimHal>::PollResult r = scheduler.poll();
+      if (r == CanScheduler<SimHal>::SENT) {
+        Message &m = messages[current[scheduler.lastClass()]];
+        if (m.firstFrameNs == NEVER) m.firstFrameNs = nowNs;
+        m.lastFrameNs = nowNs;
+        lastLoadNs = nowNs;
+        loadedOnce = true;
+        framesLoaded++;
+        continue;
+      }
+      // BLOCKED: wait for a buffer; the next frame end polls us again. Otherwise a
+      // message that just ended may have made room for the next one of its class.
+      if (r == CanScheduler<SimHal>::BLOCKED || !startDue(nowNs)) return;
+    }
+  }
+
+  uint64_t wakeNs() const override {
+    uint64_t at = NEVER;
+    uint32_t us;
+    if (scheduler.timeoutInUs(us)) at = clock + (uint64_t)(us ? us : 1) * 1000;
+    if (!scheduler.idle() && minGapNs && loadedOnce && lastLoadNs + minGapNs > clock) {
+      at = std::min(at, lastLoadNs + minGapNs);
+    }
+    for (uint8_t c = 0; c < canframing::PRIO_CLASSES; ++c) {
+      const size_t i = pending(c);
+      if (i < messages.size() && !scheduler.busy(c)) at = std::min(at, messages[i].submitNs);
+    }
+    return at;
+  }
+
+  bool idle() const {
+    for (uint8_t c = 0; c < canframing::PRIO_CLASSES; ++c) {
+      if (pending(c) < messages.size()) return false;
+    }
+    return scheduler.idle() && can.txPendingMask() == 0;
+  }
+  const std::vector<Message> &sent() const { return messages; }
+  uint64_t frames() const { return framesLoaded; }
+  CanSegmenter<SimHal>::Stats resumeStats() const { return scheduler.stats(); }
+
+private:
+  // Next message of class `c` not started yet (messages.size() if none)
+  size_t pending(uint8_t c) const { return head[c] < queued[c].size() ? queued[c][head[c]] : messages.size(); }
+
+  // Start every class's next message that is due and whose class is free
+  bool startDue(uint64_t nowNs) {
+    bool started = false;
+    for (uint8_t c = 0; c < canframing::PRIO_CLASSES; ++c) {
+      if (scheduler.busy(c)) continue;
+      const size_t i = pending(c);
+      if (i >= messages.size() || messages[i].submitNs > nowNs) continue;
+      const Message &m = messages[i];
+      scheduler.submit(c, m.targetMask, m.framing, m.data, m.len, m.flags, m.fec);
+      current[c] = i;
+      head[c]++;
+      started = true;
+    }
+    return started;
+  }
+
+  uint64_t clock;
+  SimHal hal;
+  CanScheduler<SimHal> scheduler;
+  uint64_t minGapNs;
+  uint64_t lastLoadNs;
+  bool loadedOnce;
+  std::vector<size_t> queued[canframing::PRIO_CLASSES]; // message indices per class
+  size_t head[canframing::PRIO_CLASSES];                // next of queued[] to start
+  size_t current[canframing::PRIO_CLASSES];             // message in flight per class
+  std::vector<Message> messages;
+  uint64_t framesLoaded;
+};
+
+template <uint8_t SESSIONS = 4, uint8_t BUFFERS = 4, uint16_t MAX_LEN = 65535>
+class ReceiverNode : public Node {
+public:
+  struct Completion {
+    uint64_t atNs;
+    uint16_t len;
+    uint8_t  prio;
+  };
+
+  ReceiverNode(uint16_t baseId, uint8_t receiverId, uint32_t serviceNsPerFrame = 0, uint32_t rxCapacity = 2 + 256)
+      : clock(0), hal(can, clock), rx(hal, baseId, receiverId), serviceNs(serviceNsPerFrame), busyUntil(0),
+        errors(0), bytes(0) {
+    can.setRxCapacity(rxCapacity);
+  }
+
+  void poll(uint64_t nowNs) override {
+    clock = nowNs;
+    rx.expire();
+    while (busyUntil <= clock) {
+      RxEvent ev;
+      if (!rx.poll(ev)) break;
+      if (ev.type == RxEvent::COMPLETE) {
+        Completion c = {clock, ev.received, ev.prio};
+        done.push_back(c);
+        bytes += ev.received;
+      } else if (ev.type == RxEvent::ERROR) {
+        errors++;
+      }
+      if (serviceNs) {
+        busyUntil = clock + serviceNs;
+      }
+    }
+  }
+
+  uint64_t wakeNs() const override {
+    if (can.rxQueued() && busyUntil > clock) return busyUntil;
+    return rx.activeSessions() ? clock + 1000000 : NEVER; // session timers
+  }
+
+  void setAckEvery(uint8_t frames) { rx.setAckEvery(frames); }
+
+  const std::vector<Completion> &completions() const { return done; }
+  uint64_t bytesDelivered() const { return bytes; }
+  uint32_t protocolErrors() const { return errors; }
+  const ReassemblyStats &sessions() const { return rx.stats(); }
+  const ResumeStats &resumeStats() const { return rx.resumeStats(); }
+
+private:
+  uint64_t clock;
+  SimHal hal;
+  CanReassembler<SimHal, SESSIONS, BUFFERS, MAX_LEN> rx;
+  uint32_t serviceNs;
+  uint64_t busyUntil;
+  uint32_t errors;
+  uint64_t bytes;
+  std::vector<Completion> done;
+};
+
+// Latencies (ns) of the messages `sender` addressed to receiver `receiverId`, matched
+// in order against that receiver's completions. Measured from submission, or with
+// fromFirstFrame from loading the first frame (transfer time, no queueing).
+// Messages lost on the way end the match. Classes overtake each other, so with
+// several in use pass `prio` to match one class at a time.
+static const uint8_t ANY_CLASS = 0xFF;
+
+template <typename Receiver>
+inline void latencies(const SenderNode &sender, const Receiver &receiver, uint8_t receiverId, std::vector<uint64_t> &out,
+                      bool fromFirstFrame = false, uint8_t prio = ANY_CLASS) {
+  const uint8_t bit = canframing::receiverBit(receiverId);
+  const std::vector<typename Receiver::Completion> &completions = receiver.completions();
+  size_t c = 0;
+  const std::vector<SenderNode::Message> &msgs = sender.sent();
+  for (size_t i = 0; i < msgs.size(); ++i) {
+    if (!(msgs[i].targetMask & bit) || (prio != ANY_CLASS && msgs[i].prio != prio)) continue;
+    while (c < completions.size() && prio != ANY_CLASS && completions[c].prio != prio) c++;
+    if (c >= completions.size()) break;
+    const typename Receiver::Completion &done = completions[c++];
+    const bool compressed = msgs[i].flags & canframing::START_FLAG_COMPRESSED;
+    if (done.len != (compressed ? lzss::plainLength(msgs[i].data) : msgs[i].len)) break;
+    out.push_back(done.atNs - (fromFirstFrame ? msgs[i].firstFrameNs : msgs[i].submitNs));
+  }
+}
+
+} // namespace cansim
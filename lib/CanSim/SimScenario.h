@@ -0,0 +1,172 @@
+/*
+ * One simulated run: a sender streaming messages to 1..5 receivers (host only)
+ * - Messages of `len` bytes are submitted every `intervalUs` (0 = back to back)
+ * - Reports bus utilisation, goodput, frames/s, latency percentiles and how much
+ *   faster than real time the simulation ran
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <SimNodes.h>
+
+namespace cansim {
+
+struct ScenarioConfig {
+  canframing::Framing framing;
+  uint16_t len;
+  uint32_t messages;
+  uint32_t intervalUs;     // between submissions; 0 = all submitted at t=0
+  uint8_t  targetMask;     // receivers addressed by each message
+  uint8_t  receivers;      // receivers on the bus (ids 1..receivers)
+  uint32_t minGapUs;       // sender TX_MIN_GAP_US
+  uint32_t serviceNs;      // receiver time per frame
+  uint32_t bitrate;
+  uint32_t rxLossPpm;      // frames each receiver misses, per million
+  uint32_t resumeWindowUs; // sender resume window (NACK/resume); 0 = off
+  uint8_t  window;         // sender ACK window in frames; 0 = off
+  uint32_t rtoUs;          // sender retransmission timeout for the ACK window
+  uint8_t  ackEvery;       // receivers ACK every this many frames
+  uint8_t  payloadFlags;   // START_FLAG_COMPRESSED: the payload is an lzss stream
+  bool     crc;            // CRC-32 trailer on every message
+  uint8_t  fecGroup;       // FEC: data frames per parity frame, 0 = off
+};
+
+inline ScenarioConfig defaultScenario() {
+  ScenarioConfig c;
+  c.framing = canframing::FRAMING_COMPACT;
+  c.len = 100;
+  c.messages = 100;
+  c.intervalUs = 0;
+  c.targetMask = 0x01;
+  c.receivers = 1;
+  c.minGapUs = 0;
+  c.serviceNs = 0;
+  c.bitrate = BITRATE_DEFAULT;
+  c.rxLossPpm = 0;
+  c.resumeWindowUs = 0;
+  c.window = 0;
+  c.rtoUs = 20000;
+  c.ackEvery = 4;
+  c.payloadFlags = 0;
+  c.crc = false;
+  c.fecGroup = 0;
+  return c;
+}
+
+struct ScenarioResult {
+  uint64_t simNs;          // until the last message completed (or the run stopped)
+  uint64_t frames;
+  uint64_t stuffBits;
+  double   utilization;    // busy / simulated time
+  double   framesPerSec;
+  double   goodputBps;     // payload bytes/s delivered to the first target (decompressed)
+  uint64_t p50Ns, p99Ns, maxNs;       // submission -> complete
+  uint64_t xferP50Ns, xferP99Ns;     // first frame loaded -> complete
+  uint32_t delivered;      // messages completed at the first target
+  uint32_t lost;           // messages the first target never completed
+  uint32_t rxOverflows;    // summed over receivers
+  uint32_t protocolErrors; // summed over receivers
+  uint32_t framesMissed;   // frames dropped by rxLossPpm, summed over receivers
+  uint32_t rebuilt;        // FEC frames rebuilt from parity, summed over receivers
+  uint32_t nacks;          // NACKs sent, summed over receivers
+  uint32_t resumes;        // NACKs the sender acted on
+  uint32_t unconfirmed;    // resumable/windowed messages that ended without DONE
+  uint32_t acks;           // ACKs sent, summed over receivers
+  uint32_t retransmits;    // frames the sender sent again (ACK window)
+  uint32_t timeouts;       // sender RTO expiries
+  double   rttAvgUs;       // frame loaded -> ACKed, frames sent once only
+  uint32_t rttMaxUs;
+  double   wallSec;
+  double   speedup;        // simulated seconds per wall-clock second
+};
+
+inline uint64_t percentile(std::vector<uint64_t> v, double p) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  size_t idx = (size_t)(p * (v.size() - 1) + 0.5);
+  return v[idx];
+}
+
+inline ScenarioResult runScenario(const ScenarioConfig &cfg, const uint8_t *payload) {
+  const uint16_t baseId = 0x200;
+  Bus bus(cfg.bitrate);
+  SenderNode sender(baseId, 16, cfg.minGapUs);
+  sender.setResumeWindowUs(cfg.resumeWindowUs);
+  sender.setWindow(cfg.window, cfg.rtoUs);
+  sender.setChecksum(cfg.crc);
+  std::vector<ReceiverNode<> *> rx;
+  bus.attach(sender);
+  for (uint8_t id = 1; id <= cfg.receivers; ++id) {
+    rx.push_back(new ReceiverNode<>(baseId, id, cfg.serviceNs));
+    rx.back()->can.setRxLoss(cfg.rxLossPpm, 0x9E3779B9u * id);
+    rx.back()->setAckEvery(cfg.ackEvery);
+    bus.attach(*rx.back());
+  }
+  for (uint32_t i = 0; i < cfg.messages; ++i) {
+    sender.submit(cfg.targetMask, cfg.framing, payload, cfg.len, (uint64_t)i * cfg.intervalUs * 1000,
+                  cfg.payloadFlags, cfg.fecGroup);
+  }
+
+  const auto t0 = std::chrono::steady_clock::now();
+  const uint8_t first = canframing::firstReceiver(cfg.targetMask);
+  ReceiverNode<> &target = *rx[first - 1];
+  // Step in 100 ms slices until everything is through or the bus went quiet
+  uint64_t horizon = 0;
+  while (true) {
+    horizon += 100000000ULL;
+    const bool busy = bus.run(horizon);
+    if (target.completions().size() >= cfg.messages || !busy) break;
+    if (horizon > 3600ULL * 1000000000ULL) break; // an hour of bus time is plenty
+  }
+  const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  ScenarioResult r;
+  std::vector<uint64_t> lat;
+  latencies(sender, target, first, lat);
+  r.delivered = (uint32_t)target.completions().size();
+  r.lost = cfg.messages - r.delivered;
+  r.simNs = r.delivered ? target.completions().back().atNs : bus.nowNs();
+  if (r.simNs == 0) r.simNs = 1;
+  r.frames = bus.stats().frames;
+  r.stuffBits = bus.stats().stuffBits;
+  r.utilization = std::min(1.0, (double)bus.stats().busyNs / r.simNs);
+  r.framesPerSec = r.frames * 1e9 / r.simNs;
+  r.goodputBps = target.bytesDelivered() * 1e9 / r.simNs;
+  r.p50Ns = percentile(lat, 0.50);
+  r.p99Ns = percentile(lat, 0.99);
+  r.maxNs = lat.empty() ? 0 : *std::max_element(lat.begin(), lat.end());
+  lat.clear();
+  latencies(sender, target, first, lat, true);
+  r.xferP50Ns = percentile(lat, 0.50);
+  r.xferP99Ns = percentile(lat, 0.99);
+  r.rxOverflows = 0;
+  r.protocolErrors = 0;
+  r.framesMissed = 0;
+  r.rebuilt = 0;
+  r.nacks = 0;
+  r.resumes = sender.resumeStats().resumes;
+  r.unconfirmed = sender.resumeStats().unconfirmed;
+  r.acks = 0;
+  r.retransmits = sender.resumeStats().retransmits;
+  r.timeouts = sender.resumeStats().timeouts;
+  r.rttAvgUs = sender.resumeStats().rttSamples ? (double)sender.resumeStats().rttTotalUs / sender.resumeStats().rttSamples : 0;
+  r.rttMaxUs = sender.resumeStats().rttMaxUs;
+  for (size_t i = 0; i < rx.size(); ++i) {
+    r.rxOverflows += rx[i]->can.overflows();
+    r.protocolErrors += rx[i]->protocolErrors();
+    r.framesMissed += rx[i]->can.lost();
+    r.rebuilt += rx[i]->resumeStats().rebuilt;
+    r.nacks += rx[i]->resumeStats().nacks;
+    r.acks += rx[i]->resumeStats().acks;
+    delete rx[i];
+  }
+  r.wallSec = wall;
+  r.speedup = wall > 0 ? (r.simNs / 1e9) / wall : 0;
+  return r;
+}
+
+} // namespace cansim
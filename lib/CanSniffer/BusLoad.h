@@ -0,0 +1,86 @@
+/*
+ * Bus load over sliding windows
+ * - add() takes each frame's bit count on the wire (cansim::frameBits(frm).total,
+ *   including stuffing and interframe space) and its arrival time
+ * - Time is split into buckets of bucketUs; load(n) is the share of the last n
+ *   complete buckets the bus spent busy, e.g. 1 s / 10 s / 60 s windows with 1 s
+ *   buckets. One bucket is always being filled, so BUCKETS - 1 complete ones are kept
+ * - Frames seen while the controller dropped them aren't counted, so overflowing
+ *   receive buffers make the figure read low
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+template <uint16_t BUCKETS>
+class BusLoad {
+public:
+  BusLoad(uint32_t bitrate, uint32_t bucketUs) : bitrate(bitrate), bucketUs(bucketUs) { clear(); }
+
+  void add(uint32_t nowUs, uint16_t bits) {
+    advance(nowUs);
+    bucket[cur] += bits;
+    totalBits += bits;
+  }
+
+  // Move the window up to nowUs without a frame (call periodically so idle time counts)
+  void advance(uint32_t nowUs) {
+    if (!started) {
+      started = true;
+      bucketStartUs = nowUs;
+      return;
+    }
+    uint32_t steps = 0;
+    while (nowUs - bucketStartUs >= bucketUs && steps <= BUCKETS) {
+      bucketStartUs += bucketUs;
+      cur = (cur + 1) % BUCKETS;
+      bucket[cur] = 0;
+      if (complete < BUCKETS - 1) complete++;
+      steps++;
+    }
+    if (nowUs - bucketStartUs >= bucketUs) bucketStartUs = nowUs; // long gap: everything was idle
+  }
+
+  // Busy share of the last n complete buckets (fewer if not that many yet), 0..1
+  float load(uint16_t n) const {
+    if (n > complete) n = complete;
+    if (n == 0) return 0.0f;
+    uint64_t bits = 0;
+    for (uint16_t i = 1; i <= n; ++i) bits += bucket[(cur + BUCKETS - i) % BUCKETS];
+    return (float)((double)bits / ((double)bitrate * bucketUs / 1e6 * n));
+  }
+
+  // Highest single-bucket load among the last n complete buckets
+  float peak(uint16_t n) const {
+    if (n > complete) n = complete;
+    uint32_t most = 0;
+    for (uint16_t i = 1; i <= n; ++i) {
+      const uint32_t b = bucket[(cur + BUCKETS - i) % BUCKETS];
+      if (b > most) most = b;
+    }
+    return (float)((double)most / ((double)bitrate * bucketUs / 1e6));
+  }
+
+  void clear() {
+    memset(bucket, 0, sizeof(bucket));
+    cur = 0;
+    complete = 0;
+    started = false;
+    bucketStartUs = 0;
+    totalBits = 0;
+  }
+
+  uint64_t bits() const { return totalBits; }
+
+private:
+  const uint32_t bitrate;
+  const uint32_t bucketUs;
+  uint32_t bucket[BUCKETS];
+  uint16_t cur;      // bucket being filled
+  uint16_t complete; // complete buckets behind cur
+  bool started;
+  uint32_t bucketStartUs;
+  uint64_t totalBits;
+};
@@ -0,0 +1,113 @@
+/*
+ * Per-CAN-ID traffic statistics for the listen-only sniffer
+ * - Fixed open-addressing hash table (linear probing, power-of-two slots), no heap;
+ *   IDs seen once the table is 3/4 full are only counted as untracked
+ * - Standard and extended IDs are kept apart (the key includes CAN_EFF_FLAG); extended
+ *   IDs can be masked first (extMask), e.g. to drop per-frame sequence bits so a
+ *   stream is one entry instead of one per frame
+ * - Per ID: frames, bytes, inter-arrival gap min/avg/max and jitter, where jitter is
+ *   the RFC 3550 estimator on successive gaps: J += (|gap - previous gap| - J) / 16
+ * - Timestamps are a free-running microsecond clock; wraps are fine
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(ARDUINO)
+#include <can.h>
+#else
+#include <linux/can.h>
+#endif
+
+struct IdStats {
+  uint32_t key;      // CAN ID including CAN_EFF_FLAG
+  uint32_t frames;   // 0 = empty slot
+  uint32_t bytes;
+  uint32_t firstUs;
+  uint32_t lastUs;
+  uint32_t lastGapUs;
+  uint32_t minGapUs;
+  uint32_t maxGapUs;
+  uint32_t avgGapUs16; // exponential average of the gap (1/16 weight), x16
+  uint32_t jitterUs16; // RFC 3550 jitter, x16
+
+  uint32_t avgGapUs() const { return avgGapUs16 / 16; }
+  uint32_t jitterUs() const { return jitterUs16 / 16; }
+};
+
+template <uint16_t SLOTS>
+class IdStatsTable {
+  static_assert(SLOTS >= 4 && (SLOTS & (SLOTS - 1)) == 0, "IdStatsTable slots must be a power of two");
+
+public:
+  explicit IdStatsTable(uint32_t extMask = CAN_EFF_MASK) : extMask(extMask) { clear(); }
+
+  // Returns false if the ID had no slot (table full)
+  bool record(const struct can_frame &frm, uint32_t nowUs) {
+    const uint32_t key = (frm.can_id & CAN_EFF_FLAG) ? CAN_EFF_FLAG | (frm.can_id & extMask) : frm.can_id & CAN_SFF_MASK;
+    IdStats *s = slotFor(key);
+    if (!s) {
+      untrackedFrames++;
+      return false;
+    }
+    const uint8_t bytes = (frm.can_id & CAN_RTR_FLAG) ? 0 : (frm.can_dlc > 8 ? 8 : frm.can_dlc);
+    if (s->frames == 0) {
+      s->key = key;
+      s->firstUs = nowUs;
+      s->minGapUs = 0xFFFFFFFF;
+      used++;
+    } else {
+      const uint32_t gap = nowUs - s->lastUs;
+      if (gap < s->minGapUs) s->minGapUs = gap;
+      if (gap > s->maxGapUs) s->maxGapUs = gap;
+      if (s->frames == 1) {
+        s->avgGapUs16 = gap * 16;
+      } else {
+        s->avgGapUs16 += (int32_t)(gap * 16 - s->avgGapUs16) / 16;
+        const uint32_t d = gap > s->lastGapUs ? gap - s->lastGapUs : s->lastGapUs - gap;
+        s->jitterUs16 += (int32_t)(d * 16 - s->jitterUs16) / 16;
+      }
+      s->lastGapUs = gap;
+    }
+    s->frames++;
+    s->bytes += bytes;
+    s->lastUs = nowUs;
+    return true;
+  }
+
+  // fn(const IdStats &) for every tracked ID, in table order
+  template <typename Fn>
+  void forEach(Fn fn) const {
+    for (uint16_t i = 0; i < SLOTS; ++i) {
+      if (slots[i].frames) fn(slots[i]);
+    }
+  }
+
+  void clear() {
+    memset(slots, 0, sizeof(slots));
+    used = 0;
+    untrackedFrames = 0;
+  }
+
+  uint16_t ids() const { return used; }
+  uint32_t untracked() const { return untrackedFrames; }
+  static uint16_t capacity() { return SLOTS * 3 / 4; }
+
+private:
+  IdStats *slotFor(uint32_t key) {
+    uint16_t i = (uint16_t)((key * 2654435761u) >> 16) & (SLOTS - 1);
+    while (true) {
+      IdStats &s = slots[i];
+      if (s.frames == 0) return used < capacity() ? &s : nullptr;
+      if (s.key == key) return &s;
+      i = (i + 1) & (SLOTS - 1);
+    }
+  }
+
+  uint32_t extMask;
+  IdStats slots[SLOTS];
+  uint16_t used;
+  uint32_t untrackedFrames;
+};
@@ -0,0 +1,96 @@
+/*
+ * Runtime counters shared by the sender and receiver firmwares
+ * - Every counter is a std::atomic<uint32_t> updated with relaxed fetch_add, which is
+ *   lock-free on the ESP32 (S32C1I) and on the host: the RX task, loop() and the
+ *   "stats" command never wait on each other
+ * - JsonLine formats them (plus any firmware-specific extras) as one JSON object
+ *   per line for the "stats" serial command
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+
+struct CanCounters {
+  std::atomic<uint32_t> framesTx;          // frames handed to a TX buffer
+  std::atomic<uint32_t> framesRx;          // frames read from the controller
+  std::atomic<uint32_t> txBusyRetries;     // polls that found no usable TX buffer
+  std::atomic<uint32_t> txTimeouts;        // frames given up after TX_TIMEOUT_US
+  std::atomic<uint32_t> seqMismatches;     // continuation frames out of sequence
+  std::atomic<uint32_t> oversizeDrops;     // messages longer than the receive buffer
+  std::atomic<uint32_t> rxOverflows;       // controller RX buffer overflow events
+  std::atomic<uint32_t> busErrors;         // error interrupts other than RX overflow
+  std::atomic<uint32_t> messagesCompleted; // sent (sender) / reassembled (receiver)
+  std::atomic<uint32_t> bytesDelivered;    // payload bytes of those messages
+
+  CanCounters()
+      : framesTx(0), framesRx(0), txBusyRetries(0), txTimeouts(0), seqMismatches(0), oversizeDrops(0),
+        rxOverflows(0), busErrors(0), messagesCompleted(0), bytesDelivered(0) {}
+};
+
+inline void countAdd(std::atomic<uint32_t> &c, uint32_t n = 1) { c.fetch_add(n, std::memory_order_relaxed); }
+inline uint32_t countGet(const std::atomic<uint32_t> &c) { return c.load(std::memory_order_relaxed); }
+
+// Builds {"key": value, ...} into a caller-provided buffer, never overrunning it. A
+// field that doesn't fit is left out whole, as is everything after it, and the line
+// ends in "truncated": 1 instead; room for that tail is held back from the start.
+class JsonLine {
+public:
+  JsonLine(char *buffer, size_t capacity) : buf(buffer), cap(capacity), len(0), truncated(false) {
+    if (cap) buf[0] = '\0';
+    put("{");
+  }
+
+  JsonLine &add(const char *key, uint32_t value) {
+    put(len > 1 ? ", \"%s\": %lu" : "\"%s\": %lu", key, (unsigned long)value);
+    return *this;
+  }
+  JsonLine &add(const char *key, const char *value) {
+    put(len > 1 ? ", \"%s\": \"%s\"" : "\"%s\": \"%s\"", key, value);
+    return *this;
+  }
+
+  const char *finish() {
+    if (cap > len) {
+      snprintf(buf + len, cap - len, "%s", !truncated ? "}" : len > 1 ? ", \"truncated\": 1}" : "\"truncated\": 1}");
+    }
+    return buf;
+  }
+
+private:
+  static constexpr size_t TAIL_RESERVE = sizeof(", \"truncated\": 1}"); // includes the NUL
+
+  template <typename... Args>
+  void put(const char *fmt, Args... args) {
+    if (truncated) return;
+    // Measure first: a field cut off mid-key or mid-number would read as a wrong value
+    const size_t room = cap > TAIL_RESERVE + len ? cap - TAIL_RESERVE - len : 0;
+    const int n = snprintf(nullptr, 0, fmt, args...);
+    if (n < 0 || (size_t)n > room) {
+      truncated = true;
+      return;
+    }
+    snprintf(buf + len, cap - len, fmt, args...);
+    len += (size_t)n;
+  }
+
+  char  *buf;
+  size_t cap;
+  size_t len;
+  bool   truncated;
+};
+
+inline void addCounters(JsonLine &j, const CanCounters &c) {
+  j.add("frames_tx", countGet(c.framesTx))
+   .add("frames_rx", countGet(c.framesRx))
+   .add("tx_busy_retries", countGet(c.txBusyRetries))
+   .add("tx_timeouts", countGet(c.txTimeouts))
+   .add("seq_mismatches", countGet(c.seqMismatches))
+   .add("oversize_drops", countGet(c.oversizeDrops))
+   .add("rx_overflows", countGet(c.rxOverflows))
+   .add("bus_errors", countGet(c.busErrors))
+   .add("messages_completed", countGet(c.messagesCompleted))
+   .add("bytes_delivered", countGet(c.bytesDelivered));
+}
@@ -0,0 +1,33 @@
+/*
+ * Hardware abstraction for the CAN transport (CanSegmenter / CanReassembler)
+ * A HAL is any type with:
+ *   bool     sendFrame(const struct can_frame &frm); // queue one frame, false on failure
+ *   bool     receiveFrame(struct can_frame &frm);    // next received frame, false if none
+ *   uint32_t micros();                               // free-running microsecond clock
+ *
+ * The firmwares wrap the MCP2515 (sender: CanPacer, receiver: the RX ring).
+ * LoopbackHal below lets the same code run on the host: every sent frame is
+ * received again, in order, with a clock the caller advances.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <FrameRing.h>
+
+template <uint32_t CAPACITY>
+struct LoopbackHal {
+  FrameRing<CAPACITY> frames;
+  uint32_t now;
+  uint32_t sent;
+
+  LoopbackHal() : now(0), sent(0) {}
+
+  bool sendFrame(const struct can_frame &frm) {
+    if (!frames.push(frm)) return false;
+    sent++;
+    return true;
+  }
+  bool receiveFrame(struct can_frame &frm) { return frames.pop(frm); }
+  uint32_t micros() { return now; }
+};
@@ -0,0 +1,652 @@
+/*
+ * Rebuilds messages from start + continuation frames (see lib/CanFraming)
+ * - onFrame() takes one received frame and reports what happened as an RxEvent;
+ *   poll() does the same for the next frame the HAL has
+ * - Drops frames not addressed to receiverId (canframing::addressFor)
+ * - Concurrent messages are kept apart by stream in a ReassemblyTable; idle ones
+ *   are evicted after the table's timeout (expire())
+ * - A completed message's data stays valid until the next onFrame()/poll() call
+ * - Continuation frames are placed at the offset their sequence gives and marked in the
+ *   session's frame bitmap; a message completes once every byte has arrived, whatever
+ *   the order. Frames we already have are dropped as duplicates. A plain message is
+ *   only dropped when a frame lands further past the first missing one than the wire
+ *   sequence can tell apart (ERR_SEQ_MISMATCH). The start frame must come first.
+ * - Compressed messages (START_FLAG_COMPRESSED) are stored at the end of the message
+ *   buffer as they arrive and decompressed in place as the in-order prefix grows, so
+ *   the buffer needs lzss::fitsInPlace() room but nothing else; COMPLETE reports the
+ *   decompressed message and `wire` the bytes that crossed the bus. Dictionary-coded
+ *   messages need the same dictionary as the sender (setDictionary())
+ * - Messages with START_FLAG_CRC end in a CRC-32 trailer. The CRC is folded in as the
+ *   in-order prefix grows (before decompression can overwrite it), so checking it at the
+ *   end costs no extra pass; a mismatch drops the message (ERR_CRC) and NACKs a
+ *   resumable one from the start. COMPLETE reports the message without the trailer
+ * - Messages whose start frame has START_FLAG_NACK (unicast only) survive a gap: once a
+ *   frame lands REORDER_MAX past it the receiver NACKs the next sequence it needs,
+ *   ignores frames until the sender's resume marker and carries on from there; a message that stalls is NACKed from expire()
+ *   after the NACK timeout. Completion is confirmed with a DONE control frame.
+ *   Continuation frames of a unicast stream we have no session for (its start frame
+ *   was missed) get a NACK for sequence 0, at most once per NACK timeout
+ * - Windowed messages (START_FLAG_ACK, unicast only): an ACK (cumulative sequence +
+ *   bitmap of the frames after it) goes out every ACK-every frames, at once when a gap
+ *   opens, and from expire() once the stream has been quiet for the ACK delay
+ *   (ACK_QUIET); completion is DONE. A retransmitted
+ *   frame or start frame we already have is re-ACKed; one of the last completed
+ *   message gets its DONE again.
+ * - FEC messages (START_FLAG_FEC): payloads are XORed into their group's parity slot as
+ *   they arrive; a parity frame rebuilds the one frame its group lacks and places it
+ *   like any other. Frames are placed relative to the newest one, since a gap only lasts
+ *   until its group's parity frame. Two missing in a group, or a gap left behind a
+ *   parity frame, drops the message (ERR_FEC); COMPLETE leaves out the group-size byte.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <CanFraming.h>
+#include <ReassemblyTable.h>
+#include <Lzss.h>
+#include <Crc32.h>
+#include <CanHal.h>
+#include <Profiler.h>
+
+struct ResumeStats {
+  uint32_t nacks;      // NACKs sent (gaps, stalls and retries)
+  uint32_t resumes;    // resume markers accepted
+  uint32_t stale;      // frames ignored while waiting for a resume marker
+  uint32_t confirmed;  // DONE frames sent
+  uint32_t acks;       // ACKs sent for windowed messages
+  uint32_t duplicates; // frames we already had (retransmissions)
+  uint32_t rebuilt;    // FEC: frames rebuilt from a parity frame
+};
+
+struct RxEvent {
+  enum Type {
+    FOREIGN,  // not addressed to us
+    STARTED,  // start frame opened a message (expected, received = first chunk)
+    PROGRESS, // continuation frame placed (seq, chunk, received/expected), in any order
+    COMPLETE, // message done: data/received
+    ERROR,    // see error; the message in progress (if any) was dropped
+    NACKED,   // gap (seq vs expectedSeq) in a resumable message: NACK sent, message kept
+    RESUMED,  // resume marker accepted: continuing from seq (received/expected)
+    STALE,    // frame ignored: message waiting for its resume marker, a duplicate, or
+              // a parity frame with nothing to rebuild
+  };
+  enum Error {
+    ERR_NONE,
+    ERR_START_TOO_SHORT,  // chunk = dlc
+    ERR_TOO_LONG,         // expected = announced (decompressed) length
+    ERR_NO_SESSION,       // no free session/buffer, expected = announced length
+    ERR_NO_ASSEMBLY,      // continuation without a start frame
+    ERR_FRAMING_MISMATCH, // continuation framing differs from its start frame
+    ERR_CONT_TOO_SHORT,   // chunk = dlc
+    ERR_SEQ_MISMATCH,     // seq too far past the first missing frame (expectedSeq)
+    ERR_UNKNOWN_FRAME,    // first byte (legacy/compact) not a known PCI
+    ERR_DECOMPRESS,       // compressed stream malformed
+    ERR_DICTIONARY,       // dictionary-coded with a dictionary we don't have (seq = its id)
+    ERR_CRC,              // CRC trailer doesn't match: corrupt, or frames of another transfer
+    ERR_FEC,              // FEC group lost more than one frame (seq = group), or bad group size
+  };
+
+  Type  type;
+  Error error;
+  canframing::AddressKind addr;
+  canframing::Framing framing;
+  uint8_t  prio;        // priority class of the frame (canframing::frameClass)
+  uint16_t seq;
+  uint16_t expectedSeq;
+  uint8_t  chunk;
+  uint16_t received;
+  uint16_t expected;
+  uint16_t wire;        // COMPLETE: bytes on the bus (fewer than received when compressed)
+  const uint8_t *data;
+  uint8_t  firstByte;
+};
+
+template <typename Hal, uint8_t SESSIONS, uint8_t BUFFERS, uint16_t MAX_LEN>
+class CanReassembler {
+public:
+  CanReassembler(Hal &hal, uint16_t baseId, uint8_t receiverId, uint32_t sessionTimeoutUs = 1000000)
+      : hal(hal), baseId(baseId), receiverId(receiverId), table(sessionTimeoutUs), nackTimeoutUs(20000), rs(),
+        orphanKey(0xFFFFFFFF), orphanUs(0), ackEvery(4), ackDelayUs(1000), sessionTimeout(sessionTimeoutUs),
+        recent(), dict(nullptr) {}
+
+  static const uint8_t MAX_NACKS = 16;  // per message, then it is dropped
+  static const uint8_t REORDER_MAX = 3; // resumable messages: frames past a gap before it is NACKed
+
+  // How long a resumable message may stall (or wait for a resume marker) before it is
+  // NACKed again; 0 turns the timer off
+  void setNackTimeoutUs(uint32_t us) { nackTimeoutUs = us; }
+
+  // Windowed messages: ACK after this many frames (keep it at most half the sender's
+  // window so the window never runs dry), or once the stream is quiet for the delay
+  void setAckEvery(uint8_t frames) { ackEvery = frames ? frames : 1; }
+  void setAckDelayUs(uint32_t us) { ackDelayUs = us; }
+
+  // Pre-shared dictionary for dictionary-coded messages (must outlive us); none by default
+  void setDictionary(const lzss::Dictionary *d) { dict = d; }
+
+  // Receive and process one frame from the HAL; false when none was waiting
+  bool poll(RxEvent &ev) {
+    struct can_frame frm;
+    if (!hal.receiveFrame(frm)) return false;
+    onFrame(frm, ev);
+    return true;
+  }
+
+  void onFrame(const struct can_frame &frm, RxEvent &ev) {
+    ev.error = RxEvent::ERR_NONE;
+    ev.data = nullptr;
+    ev.wire = 0;
+    ev.prio = canframing::frameClass(frm);
+    ev.addr = canframing::addressFor(frm, baseId, receiverId);
+    if (ev.addr == canframing::ADDR_NONE) {
+      ev.type = RxEvent::FOREIGN;
+      return;
+    }
+    canframing::Framing f = canframing::FRAMING_LEGACY;
+    switch (canframing::classify(frm, f)) {
+      case canframing::KIND_START:
+        onStart(frm, f, ev);
+        break;
+      case canframing::KIND_CONT:
+        onCont(frm, f, ev);
+        break;
+      case canframing::KIND_PARITY:
+        onParity(frm, f, ev);
+        break;
+      default:
+        ev.firstByte = frm.can_dlc ? frm.data[0] : 0;
+        fail(ev, RxEvent::ERR_UNKNOWN_FRAME);
+        break;
+    }
+  }
+
+  // ACK quiet windowed messages, NACK stalled resumable ones and evict sessions idle past
+  // the timeout; call regularly
+  uint8_t expire() {
+    const uint32_t now = hal.micros();
+    table.forEachActive([&](ReassemblySession &s) {
+      if (windowed(s) && s.sinceAck && now - s.lastUs >= ackDelayUs) sendAck(s, canframing::CTRL_ACK_QUIET);
+    });
+    if (nackTimeoutUs) {
+      table.forEachActive([&](ReassemblySession &s) {
+        if (!resumable(s) || now - (s.resuming ? s.nackUs : s.lastUs) < nackTimeoutUs) return;
+        if (s.nacks >= MAX_NACKS) {
+          table.close(&s, Table::ABORTED);
+          return;
+        }
+        s.resuming = true;
+        sendCtrl(s, canframing::CTRL_NACK, s.nextSeq);
+      });
+    }
+    return table.expire(now);
+  }
+
+  const ReassemblyStats &stats() const { return table.stats(); }
+  const ResumeStats &resumeStats() const { return rs; }
+  uint8_t activeSessions() const { return table.activeCount(); }
+
+private:
+  typedef ReassemblyTable<SESSIONS, BUFFERS, MAX_LEN> Table;
+
+  static void fail(RxEvent &ev, RxEvent::Error e) {
+    ev.type = RxEvent::ERROR;
+    ev.error = e;
+  }
+
+  static bool resumable(const ReassemblySession &s) {
+    return (s.flags & canframing::START_FLAG_NACK) && !(s.flags & canframing::START_FLAG_ACK) &&
+           s.addr == canframing::ADDR_UNICAST;
+  }
+
+  static bool windowed(const ReassemblySession &s) {
+    return (s.flags & canframing::START_FLAG_ACK) && s.addr == canframing::ADDR_UNICAST;
+  }
+
+  static bool windowedStart(uint8_t flags, canframing::AddressKind addr) {
+    return (flags & canframing::START_FLAG_ACK) && addr == canframing::ADDR_UNICAST;
+  }
+
+  // Control frames of a windowed message echo its parity
+  static uint8_t ctrlParity(uint8_t flags) {
+    return (flags & canframing::START_FLAG_ACK) && (flags & canframing::START_FLAG_PARITY) ? canframing::CTRL_PARITY : 0;
+  }
+
+  void sendAck(ReassemblySession &s, uint8_t type = canframing::CTRL_ACK) {
+    const canframing::Framing f = (canframing::Framing)s.framing;
+    uint32_t bits = 0;
+    for (uint8_t i = 0; i < canframing::ACK_WINDOW_MAX - 1; i++) {
+      const uint16_t seq = (uint16_t)(s.nextSeq + 1 + i);
+      if (seq > s.highSeq || canframing::contOffset(f, seq) >= s.expected) break;
+      if (frameSeen(s, seq)) bits |= 1u << i;
+    }
+    struct can_frame frm;
+    canframing::writeAck(frm, baseId, receiverId, type | ctrlParity(s.flags), s.tag, s.nextSeq, bits);
+    hal.sendFrame(frm);
+    s.sinceAck = 0;
+    rs.acks++;
+  }
+
+  // The last windowed message we completed, so a retransmission after a lost DONE gets
+  // the DONE again instead of starting the message over
+  struct Completed {
+    bool     valid;
+    uint32_t key;
+    uint16_t len;
+    uint8_t  flags;
+    uint8_t  tag;
+    uint32_t us;
+  };
+
+  bool recentlyCompleted(uint32_t key, uint32_t now) const {
+    return recent.valid && recent.key == key && now - recent.us < sessionTimeout;
+  }
+
+  void resendDone() {
+    struct can_frame frm;
+    canframing::writeCtrl(frm, baseId, receiverId, canframing::CTRL_DONE | ctrlParity(recent.flags), recent.tag,
+                          recent.len);
+    hal.sendFrame(frm);
+    rs.confirmed++;
+  }
+
+  void sendCtrl(ReassemblySession &s, uint8_t type, uint16_t value) {
+    struct can_frame frm;
+    canframing::writeCtrl(frm, baseId, receiverId, type | ctrlParity(s.flags), s.tag, value);
+    hal.sendFrame(frm);
+    if (type == canframing::CTRL_NACK) {
+      s.nackUs = hal.micros();
+      s.nacks++;
+      rs.nacks++;
+    } else {
+      rs.confirmed++;
+    }
+  }
+
+  // Senders that don't resume ignore it, so this doesn't depend on START_FLAG_NACK
+  void nackOrphan(const struct can_frame &frm) {
+    const uint32_t key = canframing::streamKey(frm);
+    const uint32_t now = hal.micros();
+    if (!nackTimeoutUs || (key == orphanKey && now - orphanUs < nackTimeoutUs)) return;
+    orphanKey = key;
+    orphanUs = now;
+    struct can_frame nack;
+    canframing::writeCtrl(nack, baseId, receiverId, canframing::CTRL_NACK, canframing::streamTag(frm), 0);
+    hal.sendFrame(nack);
+    rs.nacks++;
+  }
+
+  // Compressed streams sit at the end of the buffer, behind the output
+  static uint32_t streamAt(const ReassemblySession &s) { return s.plainLen ? MAX_LEN - s.expected : 0; }
+
+  static uint8_t trailerLen(const ReassemblySession &s) {
+    return (s.flags & canframing::START_FLAG_CRC) ? canframing::CRC_LEN : 0;
+  }
+
+  // FEC messages start with the group size
+  static uint8_t prefixLen(const ReassemblySession &s) { return s.fecK ? 1 : 0; }
+
+  // Fold the wire bytes that joined the in-order prefix into the CRC, crc32::BATCH at a
+  // time; a compressed stream at once, since inflate() may overwrite it next
+  static void foldCrc(ReassemblySession &s) {
+    PROFILE_SCOPE("rx.crc");
+    const uint32_t last = s.expected - canframing::CRC_LEN;
+    uint32_t end = canframing::contOffset((canframing::Framing)s.framing, s.nextSeq);
+    if (end > last) end = last;
+    if (end <= s.crcPos || (end - s.crcPos < crc32::BATCH && end < last && !s.plainLen)) return;
+    s.crc = crc32::update(s.crc, s.data + streamAt(s) + s.crcPos, end - s.crcPos);
+    s.crcPos = (uint16_t)end;
+  }
+
+  static bool crcMatches(const ReassemblySession &s) {
+    const uint8_t *t = s.data + streamAt(s) + s.expected - canframing::CRC_LEN;
+    const uint32_t sent = (uint32_t)t[0] | ((uint32_t)t[1] << 8) | ((uint32_t)t[2] << 16) | ((uint32_t)t[3] << 24);
+    return s.crcPos == s.expected - canframing::CRC_LEN && s.crc == sent;
+  }
+
+  // Copy the frame's payload to byte `at` of the message; complete once every byte is in
+  void append(ReassemblySession *s, const struct can_frame &frm, uint8_t header, RxEvent &ev, uint32_t at) {
+    const uint8_t chunk = frm.can_dlc - header;
+    uint8_t n = chunk;
+    if (at > s->expected) at = s->expected;
+    if (n > s->expected - at) n = (uint8_t)(s->expected - at);
+    memcpy(s->data + streamAt(*s) + at, &frm.data[header], n);
+    s->received += n;
+    s->lastUs = hal.micros();
+    ev.chunk = chunk;
+    ev.received = s->received;
+    ev.expected = s->expected;
+    if (trailerLen(*s)) foldCrc(*s);
+    if (s->plainLen && !inflate(*s)) {
+      table.close(s, Table::ABORTED);
+      fail(ev, RxEvent::ERR_DECOMPRESS);
+      return;
+    }
+    if (s->received >= s->expected) {
+      if (trailerLen(*s) && !crcMatches(*s)) {
+        if (resumable(*s)) sendCtrl(*s, canframing::CTRL_NACK, 0);
+        table.close(s, Table::ABORTED);
+        fail(ev, RxEvent::ERR_CRC);
+        return;
+      }
+      ev.type = RxEvent::COMPLETE;
+      ev.data = s->data + (s->plainLen ? 0 : prefixLen(*s)); // the pool buffer isn't reused before the next frame
+      ev.addr = (canframing::AddressKind)s->addr;
+      ev.wire = s->expected;
+      ev.received = ev.expected =
+          s->plainLen ? s->plainLen : (uint16_t)(s->expected - trailerLen(*s) - prefixLen(*s));
+      if (resumable(*s) || windowed(*s)) sendCtrl(*s, canframing::CTRL_DONE, s->expected);
+      if (windowed(*s)) {
+        recent.valid = true;
+        recent.key = s->key;
+        recent.len = s->expected;
+        recent.flags = s->flags;
+        recent.tag = s->tag;
+        recent.us = s->lastUs;
+      }
+      table.close(s, Table::COMPLETED);
+    }
+  }
+
+  // Decompress what the in-order prefix of the stream allows; false on a bad stream, or
+  // one that ends short of its length
+  bool inflate(ReassemblySession &s) {
+    PROFILE_SCOPE("rx.inflate");
+    uint32_t avail = canframing::contOffset((canframing::Framing)s.framing, s.nextSeq);
+    if (avail > (uint32_t)(s.expected - trailerLen(s))) avail = s.expected - trailerLen(s);
+    const uint32_t at = streamAt(s) + prefixLen(s);
+    const lzss::DecodeResult r = lzss::decode(s.data + at, avail - prefixLen(s), s.codeBit, s.data, s.plainPos, s.plainLen, at,
+                                              lzss::isDictionaryStream(s.data + at) ? dict : nullptr);
+    if (r == lzss::DECODE_ERROR) return false;
+    return r == lzss::DECODE_DONE || s.received < s.expected;
+  }
+
+  void onStart(const struct can_frame &frm, canframing::Framing f, RxEvent &ev) {
+    PROFILE_SCOPE("rx.startFrame");
+    const uint8_t header = canframing::startHeaderLen(f);
+    ev.framing = f;
+    if (frm.can_dlc < header) {
+      ev.chunk = frm.can_dlc;
+      fail(ev, RxEvent::ERR_START_TOO_SHORT);
+      return;
+    }
+    const uint8_t flags = canframing::startFlags(frm, f);
+    if ((flags & canframing::START_FLAG_RESUME) && (flags & canframing::START_FLAG_NACK) &&
+        !(flags & canframing::START_FLAG_ACK)) {
+      onResume(frm, f, ev);
+      return;
+    }
+    ev.expected = canframing::startLength(frm, f);
+    const uint8_t trailer = (flags & canframing::START_FLAG_CRC) ? canframing::CRC_LEN : 0;
+    if (ev.expected < trailer) {
+      fail(ev, RxEvent::ERR_CRC);
+      return;
+    }
+    uint8_t fecK = 0;
+    if (canframing::fecFlags(flags)) {
+      fecK = ev.expected > trailer && frm.can_dlc > header ? frm.data[header] : 0;
+      if (fecK < canframing::FEC_GROUP_MIN || fecK > canframing::FEC_GROUP_MAX) {
+        fail(ev, RxEvent::ERR_FEC);
+        return;
+      }
+    }
+    const uint8_t prefix = fecK ? 1 : 0;
+    uint16_t plainLen = 0;
+    if (flags & canframing::START_FLAG_COMPRESSED) {
+      const uint8_t *stream = &frm.data[header + prefix];
+      if (ev.expected < lzss::HEADER_LEN + trailer + prefix || frm.can_dlc < header + prefix + lzss::HEADER_LEN) {
+        fail(ev, RxEvent::ERR_DECOMPRESS);
+        return;
+      }
+      plainLen = lzss::plainLength(stream);
+      if (lzss::isDictionaryStream(stream) && (!dict || dict->id != lzss::dictionaryId(stream))) {
+        ev.seq = lzss::dictionaryId(stream);
+        fail(ev, RxEvent::ERR_DICTIONARY);
+        return;
+      }
+      if (plainLen == 0) {
+        fail(ev, RxEvent::ERR_DECOMPRESS);
+        return;
+      }
+      // The trailer sits after the stream, out of the decoder's way
+      if (!lzss::fitsInPlace(plainLen, ev.expected - trailer - prefix, MAX_LEN - trailer)) {
+        ev.expected = plainLen;
+        fail(ev, RxEvent::ERR_TOO_LONG);
+        return;
+      }
+    }
+    const uint32_t key = canframing::streamKey(frm);
+    if (windowedStart(flags, ev.addr) && duplicateStart(key, flags, ev.expected)) {
+      rs.duplicates++;
+      ev.type = RxEvent::STALE;
+      return;
+    }
+    ReassemblySession *s = table.open(key, ev.expected, hal.micros());
+    if (!s) {
+      fail(ev, ev.expected > MAX_LEN ? RxEvent::ERR_TOO_LONG : RxEvent::ERR_NO_SESSION);
+      return;
+    }
+    s->framing = f;
+    s->addr = ev.addr;
+    s->flags = flags;
+    s->tag = canframing::streamTag(frm);
+    s->plainLen = plainLen;
+    s->codeBit = lzss::HEADER_LEN * 8;
+    s->fecK = fecK;
+    ev.type = RxEvent::STARTED;
+    markFrame(*s, 0);
+    if (windowed(*s)) s->sinceAck = 1;
+    append(s, frm, header, ev, 0);
+  }
+
+  // A windowed start frame we already have: re-ACK it, or re-send the DONE
+  bool duplicateStart(uint32_t key, uint8_t flags, uint16_t len) {
+    ReassemblySession *s = table.find(key);
+    if (s) {
+      if (!windowed(*s) || s->flags != flags || s->expected != len) return false;
+      s->lastUs = hal.micros();
+      sendAck(*s);
+      return true;
+    }
+    if (!recentlyCompleted(key, hal.micros()) || recent.flags != flags || recent.len != len) return false;
+    resendDone();
+    return true;
+  }
+
+  void onCont(const struct can_frame &frm, canframing::Framing f, RxEvent &ev) {
+    PROFILE_SCOPE("rx.contFrame");
+    ev.framing = f;
+    ReassemblySession *s = table.find(canframing::streamKey(frm));
+    if (!s) {
+      const uint32_t now = hal.micros();
+      if (ev.addr == canframing::ADDR_UNICAST && recentlyCompleted(canframing::streamKey(frm), now)) {
+        // Retransmission of a message we finished: its DONE was lost
+        if (now - orphanUs >= ackDelayUs || orphanKey != recent.key) {
+          orphanKey = recent.key;
+          orphanUs = now;
+          resendDone();
+        }
+        rs.duplicates++;
+        ev.type = RxEvent::STALE;
+        return;
+      }
+      if (ev.addr == canframing::ADDR_UNICAST) nackOrphan(frm);
+      fail(ev, RxEvent::ERR_NO_ASSEMBLY);
+      return;
+    }
+    if (f != s->framing) {
+      table.close(s, Table::ABORTED);
+      fail(ev, RxEvent::ERR_FRAMING_MISMATCH);
+      return;
+    }
+    const uint8_t header = canframing::contHeaderLen(f);
+    if (frm.can_dlc < header) {
+      table.close(s, Table::ABORTED);
+      ev.chunk = frm.can_dlc;
+      fail(ev, RxEvent::ERR_CONT_TOO_SHORT);
+      return;
+    }
+    ev.seq = canframing::contSeq(frm, f);
+    ev.expectedSeq = s->nextSeq & canframing::seqMask(f);
+    if (s->resuming) {
+      rs.stale++;
+      ev.type = RxEvent::STALE;
+      return;
+    }
+    const uint16_t seq = canframing::unwrapSeq(f, ev.seq, s->fecK ? (uint16_t)(s->highSeq + 1) : s->nextSeq);
+    const uint32_t at = canframing::contOffset(f, seq);
+    if (seq < s->nextSeq || at >= s->expected || frameSeen(*s, seq)) {
+      s->lastUs = hal.micros();
+      rs.duplicates++;
+      if (windowed(*s) && ++s->sinceAck >= ackEvery) sendAck(*s);
+      ev.type = RxEvent::STALE;
+      return;
+    }
+    const uint16_t rel = (uint16_t)(seq - s->nextSeq);
+    if (!windowed(*s) && rel >= reorderLimit(*s)) {
+      if (resumable(*s)) {
+        s->resuming = true;
+        sendCtrl(*s, canframing::CTRL_NACK, s->nextSeq);
+        ev.type = RxEvent::NACKED;
+        return;
+      }
+      table.close(s, Table::ABORTED);
+      fail(ev, RxEvent::ERR_SEQ_MISMATCH);
+      return;
+    }
+    const bool newGap = rel > 0 && s->highSeq < s->nextSeq;
+    if (s->fecK) fecAccumulate(*s, seq, &frm.data[header], (uint8_t)(frm.can_dlc - header));
+    place(s, frm, header, seq, ev);
+    if (ev.type == RxEvent::COMPLETE || !windowed(*s)) return;
+    if (newGap || s->sinceAck >= ackEvery) sendAck(*s);
+  }
+
+  // Mark continuation frame `seq` as arrived and copy its payload in
+  void place(ReassemblySession *s, const struct can_frame &frm, uint8_t header, uint16_t seq, RxEvent &ev) {
+    markFrame(*s, seq);
+    if (seq > s->highSeq) s->highSeq = seq;
+    while (s->nextSeq <= s->highSeq && frameSeen(*s, s->nextSeq)) s->nextSeq++;
+    if (windowed(*s)) s->sinceAck++;
+    ev.type = RxEvent::PROGRESS;
+    append(s, frm, header, ev, canframing::contOffset((canframing::Framing)s->framing, seq));
+  }
+
+  static void fecAccumulate(ReassemblySession &s, uint16_t seq, const uint8_t *payload, uint8_t n) {
+    const uint16_t group = (uint16_t)((seq - 1) / s.fecK);
+    uint8_t *acc = s.fecAcc[group & 1];
+    if (s.fecGroup[group & 1] != group) {
+      s.fecGroup[group & 1] = group;
+      memset(acc, 0, sizeof(s.fecAcc[0]));
+    }
+    for (uint8_t i = 0; i < n && i < sizeof(s.fecAcc[0]); ++i) acc[i] ^= payload[i];
+  }
+
+  // Parity frame of an FEC message: rebuild the group's one missing frame from it. It
+  // arrives after the group's last frame, so a gap still open up to there is a loss.
+  void onParity(const struct can_frame &frm, canframing::Framing f, RxEvent &ev) {
+    PROFILE_SCOPE("rx.parityFrame");
+    ev.framing = f;
+    ev.seq = canframing::contSeq(frm, f);
+    ReassemblySession *s = table.find(canframing::streamKey(frm));
+    if (!s || !s->fecK) {
+      // The last group's parity follows a message that completed without it
+      ev.type = RxEvent::STALE;
+      return;
+    }
+    const uint8_t header = canframing::contHeaderLen(f);
+    if (f != s->framing || frm.can_dlc < 8) {
+      table.close(s, Table::ABORTED);
+      ev.chunk = frm.can_dlc;
+      fail(ev, f != s->framing ? RxEvent::ERR_FRAMING_MISMATCH : RxEvent::ERR_CONT_TOO_SHORT);
+      return;
+    }
+    s->lastUs = hal.micros();
+    const uint16_t lastSeq = (uint16_t)(canframing::framesForLength(f, s->expected) - 1);
+    const uint16_t newest = (uint16_t)(s->highSeq ? (s->highSeq - 1) / s->fecK : 0);
+    const uint16_t group = canframing::unwrapSeq(f, ev.seq, newest);
+    const uint32_t first = 1 + (uint32_t)group * s->fecK;
+    const uint32_t last = first + s->fecK - 1 < lastSeq ? first + s->fecK - 1 : lastSeq;
+    ev.seq = group;
+    ev.expectedSeq = s->nextSeq;
+    if (first > lastSeq) {
+      table.close(s, Table::ABORTED);
+      fail(ev, RxEvent::ERR_FEC);
+      return;
+    }
+    uint8_t missing = 0;
+    uint16_t lost = 0;
+    for (uint32_t n = first; n <= last; ++n) {
+      if (frameSeen(*s, (uint16_t)n)) continue;
+      missing++;
+      lost = (uint16_t)n;
+    }
+    if (missing == 1) {
+      const uint8_t max = canframing::contPayloadMax(f);
+      const uint32_t at = canframing::contOffset(f, lost);
+      const uint8_t *acc = s->fecGroup[group & 1] == group ? s->fecAcc[group & 1] : nullptr;
+      struct can_frame rebuilt;
+      rebuilt.can_id = frm.can_id;
+      rebuilt.can_dlc = (uint8_t)(header + (s->expected - at < max ? s->expected - at : max));
+      for (uint8_t i = 0; i < max; ++i) rebuilt.data[header + i] = (uint8_t)(frm.data[header + i] ^ (acc ? acc[i] : 0));
+      rs.rebuilt++;
+      place(s, rebuilt, header, lost, ev);
+      if (ev.type != RxEvent::PROGRESS) return;
+    } else if (missing == 0 && s->nextSeq > last) {
+      ev.type = RxEvent::STALE;
+      return;
+    }
+    if (s->nextSeq <= last) {
+      table.close(s, Table::ABORTED);
+      fail(ev, RxEvent::ERR_FEC);
+    }
+  }
+
+  // How far past the first missing frame a frame may land before the gap counts as a
+  // loss. Resumable messages NACK once the sender is clearly past it (the MCP2515 can
+  // reorder across its three TX buffers); plain ones accept anything the wire sequence
+  // can place, and FEC ones anything at all (their parity frames find the losses).
+  static uint16_t reorderLimit(const ReassemblySession &s) {
+    if (s.fecK) return 0xFFFF;
+    if (resumable(s)) return REORDER_MAX;
+    return (uint16_t)(canframing::seqMask((canframing::Framing)s.framing) / 2);
+  }
+
+  // Resume marker: seq = where the sender restarts (unmasked). Frames we already have
+  // are dropped as duplicates; a marker past our first gap means more went missing.
+  void onResume(const struct can_frame &frm, canframing::Framing f, RxEvent &ev) {
+    ReassemblySession *s = table.find(canframing::streamKey(frm));
+    if (!s || f != s->framing) {
+      fail(ev, RxEvent::ERR_NO_ASSEMBLY);
+      return;
+    }
+    const uint16_t from = canframing::startLength(frm, f);
+    ev.seq = from;
+    ev.expectedSeq = s->nextSeq;
+    if (from == 0 || from > s->nextSeq) {
+      sendCtrl(*s, canframing::CTRL_NACK, s->nextSeq);
+      ev.type = RxEvent::NACKED;
+      return;
+    }
+    s->resuming = false;
+    s->lastUs = hal.micros();
+    rs.resumes++;
+    ev.type = RxEvent::RESUMED;
+    ev.received = s->received;
+    ev.expected = s->expected;
+  }
+
+  Hal &hal;
+  const uint16_t baseId;
+  const uint8_t receiverId;
+  Table table;
+  uint32_t nackTimeoutUs;
+  ResumeStats rs;
+  uint32_t orphanKey; // last stream NACKed for a missed start frame (or re-sent a DONE)
+  uint32_t orphanUs;
+  uint8_t  ackEvery;
+  uint32_t ackDelayUs;
+  uint32_t sessionTimeout;
+  Completed recent;
+  const lzss::Dictionary *dict;
+};
@@ -0,0 +1,194 @@
+/*
+ * Interleaves the frames of messages in different priority classes (see lib/CanFraming)
+ * - One CanSegmenter per class, so each class has at most one message in flight
+ * - poll() loads one frame, always from the most urgent class that has one ready: an
+ *   urgent message submitted during a bulk transfer goes out between two of its frames
+ *   instead of after the last one. Frames already in the controller's TX buffers still
+ *   go first (the MCP2515 sends them in load order, see lib/CanPacer).
+ * - Control frames go to every message in flight; the stream tag tells them apart
+ * - A message ends as with CanSegmenter::send(): once its last frame is loaded, or, if
+ *   resumable, on DONE or after the resume window; windowed, on DONE or when it gives up
+ * - Extended-ID messages in flight get different rolling message ids
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <CanFraming.h>
+#include <CanSegmenter.h>
+
+template <typename Hal>
+class CanScheduler {
+public:
+  enum PollResult {
+    IDLE,    // nothing in flight
+    WAITING, // messages in flight, but no frame to load now (window full, waiting for DONE)
+    SENT,    // one frame loaded, from lastClass()
+    BLOCKED, // the HAL refused a frame; it is kept and offered again
+  };
+
+  typedef typename CanSegmenter<Hal>::Stats Stats;
+
+  CanScheduler(Hal &hal, uint16_t baseId, uint8_t sourceId)
+      : hal(hal), segs{{hal, baseId, sourceId}, {hal, baseId, sourceId}, {hal, baseId, sourceId}}, last(0) {
+    for (uint8_t c = 0; c < canframing::PRIO_CLASSES; ++c) {
+      segs[c].setPriorityClass(c);
+      cls[c] = ClassState();
+    }
+  }
+
+  // Apply to every class, see CanSegmenter
+  void setResumeWindowUs(uint32_t us) { for (auto &s : segs) s.setResumeWindowUs(us); }
+  void setWindow(uint8_t frames) { for (auto &s : segs) s.setWindow(frames); }
+  void setRtoUs(uint32_t us) { for (auto &s : segs) s.setRtoUs(us); }
+  void setChecksum(bool on) { for (auto &s : segs) s.setChecksum(on); }
+
+  // Start a message in class `prio`. False if that class already has one in flight, or
+  // for an invalid class or target mask.
+  bool submit(uint8_t prio, uint8_t targetMask, canframing::Framing f, const uint8_t *msg, uint16_t msgLen,
+              uint8_t payloadFlags = 0, uint8_t fecGroup = 0) {
+    if (prio >= canframing::PRIO_CLASSES || cls[prio].active) return false;
+    uint8_t busy = 0;
+    for (uint8_t c = 0; c < canframing::PRIO_CLASSES; ++c) {
+      if (cls[c].active) busy |= (uint8_t)(1u << segs[c].messageId());
+    }
+    segs[prio].skipMessageIds(busy);
+    if (!segs[prio].start(targetMask, f, msg, msgLen, payloadFlags, fecGroup)) return false;
+    cls[prio] = ClassState();
+    cls[prio].active = true;
+    return true;
+  }
+
+  bool busy(uint8_t prio) const { return cls[prio].active; }
+  bool idle() const {
+    for (uint8_t c = 0; c < canframing::PRIO_CLASSES; ++c) {
+      if (cls[c].active) return false;
+    }
+    return true;
+  }
+
+  // Give up on the message in class `prio` (e.g. after BLOCKED turned out to be fatal)
+  void cancel(uint8_t prio) {
+    if (!cls[prio].active) return;
+    segs[prio].abandon();
+    cls[prio].active = false;
+  }
+
+  // Feed every control frame waiting in the HAL to the messages in flight
+  void pollControl() {
+    struct can_frame rx;
+    while (hal.receiveFrame(rx)) {
+      for (uint8_t c = 0; c < canframing::PRIO_CLASSES; ++c) {
+        if (cls[c].active && segs[c].onControl(rx)) break;
+      }
+    }
+  }
+
+  // Handle control frames, then load at most one frame
+  PollResult poll() {
+    pollControl();
+    bool inFlight = false;
+    for (uint8_t c = 0; c < canframing::PRIO_CLASSES; ++c) {
+      ClassState &s = cls[c];
+      if (!s.active) continue;
+      CanSegmenter<Hal> &seg = segs[c];
+      if (!s.haveFrame) {
+        if (seg.windowed()) seg.expire();
+        if (!seg.next(s.frame)) {
+          if (ended(c)) {
+            s.active = false;
+          } else {
+            inFlight = true;
+          }
+          continue;
+        }
+        s.lingering = false; // a NACK reopened the message, or an ACK opened the window
+        s.haveFrame = true;
+      }
+      if (!hal.sendFrame(s.frame)) return BLOCKED;
+      s.haveFrame = false;
+      last = c;
+      return SENT;
+    }
+    return inFlight ? WAITING : IDLE;
+  }
+
+  // Class of the frame the last SENT loaded
+  uint8_t lastClass() const { return last; }
+
+  // Microseconds until a message WAITING has a timer to run (RTO or resume window), if
+  // one does; frames arriving or TX buffers freeing up can make work sooner
+  bool timeoutInUs(uint32_t &us) const {
+    bool any = false;
+    us = 0;
+    for (uint8_t c = 0; c < canframing::PRIO_CLASSES; ++c) {
+      const ClassState &s = cls[c];
+      if (!s.active || s.haveFrame) continue;
+      uint32_t t;
+      if (segs[c].windowed()) {
+        t = segs[c].timeoutInUs();
+      } else if (s.lingering) {
+        const uint32_t waited = hal.micros() - s.lingerSinceUs;
+        t = waited >= segs[c].resumeWindow() ? 0 : segs[c].resumeWindow() - waited;
+      } else {
+        continue;
+      }
+      if (!any || t < us) us = t;
+      any = true;
+    }
+    return any;
+  }
+
+  CanSegmenter<Hal> &segmenter(uint8_t prio) { return segs[prio]; }
+  const CanSegmenter<Hal> &segmenter(uint8_t prio) const { return segs[prio]; }
+
+  // Summed over the classes (rttMaxUs: the largest)
+  Stats stats() const {
+    Stats t = Stats();
+    for (uint8_t c = 0; c < canframing::PRIO_CLASSES; ++c) {
+      const Stats &s = segs[c].stats();
+      t.resumes += s.resumes;
+      t.confirmed += s.confirmed;
+      t.unconfirmed += s.unconfirmed;
+      t.acks += s.acks;
+      t.retransmits += s.retransmits;
+      t.timeouts += s.timeouts;
+      t.rttSamples += s.rttSamples;
+      t.rttTotalUs += s.rttTotalUs;
+      if (s.rttMaxUs > t.rttMaxUs) t.rttMaxUs = s.rttMaxUs;
+      t.parity += s.parity;
+    }
+    return t;
+  }
+
+private:
+  struct ClassState {
+    bool     active;
+    bool     haveFrame;     // `frame` is produced but not loaded yet
+    bool     lingering;     // resumable: every frame loaded, waiting for DONE
+    uint32_t lingerSinceUs;
+    struct can_frame frame;
+  };
+
+  // Class `c` produced no frame: true once its message needs nothing more
+  bool ended(uint8_t c) {
+    CanSegmenter<Hal> &seg = segs[c];
+    ClassState &s = cls[c];
+    if (seg.finished()) return true;
+    if (seg.windowed()) return false; // expire() resends or gives up
+    if (!seg.resumable()) return true;
+    const uint32_t now = hal.micros();
+    if (!s.lingering) {
+      s.lingering = true;
+      s.lingerSinceUs = now;
+    }
+    if (now - s.lingerSinceUs < seg.resumeWindow()) return false;
+    seg.abandon();
+    return true;
+  }
+
+  Hal &hal;
+  CanSegmenter<Hal> segs[canframing::PRIO_CLASSES];
+  ClassState cls[canframing::PRIO_CLASSES];
+  uint8_t last;
+};
@@ -0,0 +1,486 @@
+/*
+ * Splits a message into start + continuation frames (see lib/CanFraming)
+ * - Works as a generator: start() a message, then next() yields one frame at a time,
+ *   so a caller can pace frames or interleave other traffic between them
+ * - send() is the simple path: every frame straight to the HAL
+ * - Addressing: targetMask bit n-1 = receiver n; standard IDs use
+ *   canframing::stdTargetId(), extended IDs carry dest/source/message id
+ * - Resume (setResumeWindowUs() > 0, unicast only): the start frame carries
+ *   START_FLAG_NACK; onControl() takes the receiver's NACK and rewinds to the sequence
+ *   it names (the next frame is then a resume marker; 0 restarts the message), or its
+ *   DONE. send() keeps listening for up to the window after the last frame until DONE
+ *   arrives
+ * - Window (setWindow() > 0, unicast only, takes precedence over resume): the start
+ *   frame carries START_FLAG_ACK and at most `window` frames are unacknowledged at a
+ *   time, so next() returns false while the window is full. onControl() slides it on
+ *   the receiver's ACKs and queues frames the ACK bitmap skipped for one selective
+ *   retransmission (an ACK_QUIET: every frame it lacks); expire() resends everything
+ *   unacknowledged after the RTO. The
+ *   message is finished() on DONE, or after MAX_RTOS timeouts in a row (unconfirmed).
+ * - CRC trailer (setChecksum(true)): the message goes out with START_FLAG_CRC and the
+ *   CRC-32 of its bytes appended (lib/Crc32). The CRC is folded in as bytes are first
+ *   copied into frames, so it costs no pass of its own; retransmissions reuse it.
+ *   Messages within CRC_LEN of 65535 bytes go without.
+ * - FEC (fecGroup = K > 0 per message): the message goes out with START_FLAG_FEC and K
+ *   as its first byte, and after every K continuation frames (and the last) a parity
+ *   frame with the XOR of their payloads, accumulated as they are written. It takes
+ *   precedence over the window and resume for that message: nothing is retransmitted.
+ * - Priority class (setPriorityClass(), PRIO_NORMAL by default): the class bits of the
+ *   standard ID or the extended priority field, see lib/CanFraming. Segmenters of one
+ *   source in flight at once (CanScheduler) keep their extended message ids apart with
+ *   skipMessageIds().
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <CanFraming.h>
+#include <CanHal.h>
+#include <Crc32.h>
+
+template <typename Hal>
+class CanSegmenter {
+public:
+  CanSegmenter(Hal &hal, uint16_t baseId, uint8_t sourceId)
+      : hal(hal), baseId(baseId), sourceId(sourceId), nextMsgId(0), prioClass(canframing::PRIO_NORMAL),
+        data(nullptr), len(0), dataLen(0), extraFlags(0), crc(0), crcPos(0), checksum(false), fecK(0), prefix(0),
+        parityPending(false), parityGroup(0), offset(0), seq(0), started(false), framesOut(0),
+        resumeWindowUs(0), resumeTarget(0), resumePending(false), resumeCount(0), confirmed(false),
+        windowSize(0), rtoUs(20000), parityBits(0), win(0), total(0), base(0), nextNew(0), ackedBits(0),
+        resendBits(0), retxBits(0), progressUs(0), rtoCount(0), gaveUp(false), st() {}
+
+  static const uint8_t MAX_RESUMES = 16; // per message, then send() gives up
+  static const uint8_t MAX_RTOS = 8;     // timeouts without progress, then the message is abandoned
+
+  struct Stats {
+    uint32_t resumes;     // NACKs acted on
+    uint32_t confirmed;   // messages the receiver confirmed with DONE
+    uint32_t unconfirmed; // resumable/windowed messages whose DONE never came
+    uint32_t acks;        // ACKs acted on
+    uint32_t retransmits; // frames sent again (selective and after a timeout)
+    uint32_t timeouts;    // RTO expiries
+    uint32_t rttSamples;  // Karn: only frames that were sent once
+    uint32_t rttTotalUs;
+    uint32_t rttMaxUs;
+    uint32_t parity;      // FEC parity frames sent
+  };
+
+  // 0 (default) sends without NACK support and doesn't wait for DONE
+  void setResumeWindowUs(uint32_t us) { resumeWindowUs = us; }
+  uint32_t resumeWindow() const { return resumeWindowUs; }
+
+  // Frames in flight for windowed messages, 0 = off; capped per framing by
+  // canframing::maxWindow() (8 compact, 32 legacy/extended)
+  void setWindow(uint8_t frames) { windowSize = frames; }
+  void setRtoUs(uint32_t us) { rtoUs = us; }
+  uint8_t window() const { return windowSize; }
+
+  // Append a CRC-32 trailer to every message (off by default)
+  void setChecksum(bool on) { checksum = on; }
+
+  // Priority class of the messages started from now on (canframing::PriorityClass)
+  void setPriorityClass(uint8_t cls) { prioClass = cls; }
+  uint8_t priorityClass() const { return prioClass; }
+
+  // Extended IDs: the next message takes the first rolling id not in `busy` (bit n =
+  // id n), so it can't be mistaken for another message of ours still in flight
+  void skipMessageIds(uint8_t busy) {
+    for (uint8_t i = 0; i <= canframing::EXT_MSGID_MASK; ++i, ++nextMsgId) {
+      if (!(busy & (1u << (nextMsgId & canframing::EXT_MSGID_MASK)))) return;
+    }
+  }
+  // Rolling id of the current message
+  uint8_t messageId() const { return (uint8_t)(msgId & canframing::EXT_MSGID_MASK); }
+
+  // Begin a message. Returns false for an invalid target mask. payloadFlags are start
+  // flags describing the payload (START_FLAG_COMPRESSED), sent along with our own.
+  // fecGroup: continuation frames per parity frame (capped at FEC_GROUP_MAX), 0 = no FEC.
+  bool start(uint8_t targetMask, canframing::Framing f, const uint8_t *msg, uint16_t msgLen, uint8_t payloadFlags = 0,
+             uint8_t fecGroup = 0) {
+    if (targetMask == 0 || (targetMask & ~canframing::RECEIVER_MASK_ALL)) return false;
+    framing = f;
+    fecK = fecGroup > canframing::FEC_GROUP_MAX ? canframing::FEC_GROUP_MAX : fecGroup;
+    if (fecK < canframing::FEC_GROUP_MIN || msgLen >= canframing::MAX_MESSAGE_LEN) fecK = 0;
+    prefix = fecK ? 1 : 0;
+    const bool trailer = checksum && msgLen + prefix <= canframing::MAX_MESSAGE_LEN - canframing::CRC_LEN;
+    extraFlags = payloadFlags | (trailer ? canframing::START_FLAG_CRC : 0) | (fecK ? canframing::START_FLAG_FEC : 0);
+    data = msg;
+    dataLen = msgLen;
+    len = (uint16_t)(msgLen + prefix + (trailer ? canframing::CRC_LEN : 0));
+    crc = trailer && fecK ? crc32::update(0, &fecK, 1) : 0;
+    crcPos = 0;
+    parityPending = false;
+    memset(parityAcc, 0, sizeof(parityAcc));
+    offset = 0;
+    seq = 0;
+    started = false;
+    stdId = canframing::stdClassId(canframing::stdTargetId(baseId, targetMask), prioClass);
+    dest = canframing::extTargetDest(targetMask);
+    extPrio = canframing::extClassPrio(prioClass);
+    msgId = nextMsgId++;
+    const bool unicast = canframing::maskCount(targetMask) == 1 && !fecK;
+    const uint8_t target = unicast ? canframing::firstReceiver(targetMask) : 0;
+    win = 0;
+    if (windowSize && unicast) {
+      const uint8_t max = canframing::maxWindow(f);
+      win = windowSize < max ? windowSize : max;
+      parityBits ^= canframing::receiverBit(target);
+    }
+    resumeTarget = (win || resumeWindowUs) ? target : 0;
+    resumePending = false;
+    resumeCount = 0;
+    confirmed = false;
+    total = (uint16_t)canframing::framesForLength(f, len);
+    base = 0;
+    nextNew = 0;
+    ackedBits = resendBits = retxBits = 0;
+    progressUs = hal.micros();
+    rtoCount = 0;
+    gaveUp = false;
+    return true;
+  }
+
+  // Every frame has been produced (a windowed message may still retransmit, see finished())
+  bool done() const {
+    if (win) return nextNew >= total;
+    return started && offset >= len && !resumePending && !parityPending;
+  }
+
+  // Nothing left to do for the current message: confirmed, given up, or not waiting for DONE
+  bool finished() const {
+    if (win) return confirmed || gaveUp;
+    return done() && (!resumeTarget || confirmed);
+  }
+
+  // Stop waiting for DONE (the resume window ran out); counted as unconfirmed
+  void abandon() {
+    if (resumeTarget && !confirmed) st.unconfirmed++;
+    resumeTarget = 0;
+    gaveUp = true;
+  }
+
+  // Does the current message take NACKs (and get confirmed with DONE)?
+  bool resumable() const { return resumeTarget != 0 && !win; }
+  bool windowed() const { return win != 0; }
+  bool confirmedDone() const { return confirmed; }
+  uint8_t resumes() const { return resumeCount; }
+
+  // Windowed message: retransmit after the RTO; call while it isn't finished()
+  void expire() {
+    if (!win || confirmed || gaveUp || base >= nextNew) return;
+    const uint32_t now = hal.micros();
+    if (now - progressUs < rtoUs) return;
+    if (++rtoCount > MAX_RTOS) {
+      abandon();
+      return;
+    }
+    st.timeouts++;
+    progressUs = now;
+    resendBits = inFlightBits() & ~ackedBits;
+  }
+
+  // Windowed message: microseconds until expire() has something to do
+  uint32_t timeoutInUs() const {
+    const uint32_t waited = hal.micros() - progressUs;
+    return waited >= rtoUs ? 0 : rtoUs - waited;
+  }
+
+  // Feed a frame received while sending. Returns true if it was a NACK, ACK or DONE for
+  // the current message; a NACK rewinds and an ACK may open the window, so next()
+  // produces frames again.
+  bool onControl(const struct can_frame &frm) {
+    uint8_t type, tag;
+    uint16_t value;
+    if (!resumeTarget || !canframing::readCtrl(frm, baseId, resumeTarget, type, tag, value)) return false;
+    if (tag != canframing::streamTag(framing, sourceId, msgId, prioClass)) return false;
+    if ((type & canframing::CTRL_PARITY) != (win ? parity() * canframing::CTRL_PARITY : 0)) return false;
+    type &= canframing::CTRL_TYPE_MASK;
+    if (type == canframing::CTRL_DONE) {
+      if (value != len || confirmed) return false;
+      confirmed = true;
+      st.confirmed++;
+      return true;
+    }
+    if (win) {
+      if (type != canframing::CTRL_ACK && type != canframing::CTRL_ACK_QUIET) return false;
+      return onAck(value, canframing::ackBits(frm), type == canframing::CTRL_ACK_QUIET);
+    }
+    // A NACK names a continuation we already sent (0: the start frame); anything else
+    // is stale or bogus
+    if (type != canframing::CTRL_NACK || confirmed || !started || value > seq + 1) return false;
+    const uint32_t at = value ? canframing::contOffset(framing, value) : 0;
+    if (resumeCount >= MAX_RESUMES || at >= len) return false;
+    resumeCount++;
+    st.resumes++;
+    if (value == 0) {
+      started = false;
+      offset = 0;
+      seq = 0;
+      resumePending = false;
+      return true;
+    }
+    seq = (uint16_t)(value - 1);
+    offset = (uint16_t)at;
+    resumePending = true;
+    return true;
+  }
+
+  // Fill `tx` with the next frame of the current message; false once it has all been
+  // produced, or while a windowed message's window is full
+  bool next(struct can_frame &tx) {
+    if (win) return nextWindowed(tx);
+    const uint8_t flags = (resumeTarget ? canframing::START_FLAG_NACK : 0) | extraFlags;
+    if (parityPending) {
+      writeParity(tx);
+      return true;
+    }
+    if (resumePending) {
+      // Resume marker: a payload-less start frame naming the sequence that follows
+      const uint8_t rflags = flags | canframing::START_FLAG_RESUME;
+      tx.can_id = framing == canframing::FRAMING_EXTENDED
+                      ? canframing::extFrameId(canframing::EXT_TYPE_START, dest, sourceId, msgId, rflags, extPrio)
+                      : stdId;
+      canframing::writeStartHeader(tx, framing, (uint16_t)(seq + 1), rflags);
+      tx.can_dlc = canframing::startHeaderLen(framing);
+      resumePending = false;
+      framesOut++;
+      return true;
+    }
+    if (!started) {
+      writeFrame(tx, 0, flags);
+      started = true;
+      return true;
+    }
+    if (offset >= len) return false;
+    writeFrame(tx, ++seq, flags);
+    return true;
+  }
+
+  // Segment and hand every frame to the HAL; false on an invalid target or a failed send.
+  // A resumable message also handles NACKs, then waits up to the resume window for DONE;
+  // a windowed one runs until DONE or MAX_RTOS timeouts. Either is false (and counted as
+  // unconfirmed) when it was given up on without DONE.
+  bool send(uint8_t targetMask, canframing::Framing f, const uint8_t *msg, uint16_t msgLen, uint8_t payloadFlags = 0,
+            uint8_t fecGroup = 0) {
+    if (!start(targetMask, f, msg, msgLen, payloadFlags, fecGroup)) return false;
+    struct can_frame tx;
+    if (win) {
+      while (!finished()) {
+        while (next(tx)) {
+          if (!hal.sendFrame(tx)) return false;
+          pollControl();
+        }
+        pollControl();
+        expire();
+      }
+      return confirmed;
+    }
+    while (true) {
+      while (next(tx)) {
+        if (!hal.sendFrame(tx)) return false;
+        if (resumeTarget) pollControl();
+      }
+      if (!resumeTarget) return true;
+      const uint32_t since = hal.micros();
+      while (!confirmed && !produces() && hal.micros() - since < resumeWindowUs) pollControl();
+      if (confirmed) return true;
+      if (produces()) continue; // NACKed: send the rest again
+      abandon();
+      return false;
+    }
+  }
+
+  uint32_t framesProduced() const { return framesOut; }
+  const Stats &stats() const { return st; }
+
+private:
+  Hal &hal;
+  const uint16_t baseId;
+  const uint8_t sourceId;
+  uint8_t nextMsgId; // extended ID: rolling message id
+  uint8_t prioClass;
+
+  canframing::Framing framing;
+  const uint8_t *data;
+  uint16_t len;        // on the wire, with the FEC group byte and the CRC trailer
+  uint16_t dataLen;
+  uint8_t  extraFlags; // payload flags of the current message (and START_FLAG_CRC/FEC)
+  uint32_t crc;        // of the group byte and data[0..crcPos)
+  uint16_t crcPos;
+  bool     checksum;
+  uint8_t  fecK;       // continuation frames per parity frame, 0 = no FEC
+  uint8_t  prefix;     // bytes before the data on the wire: 1 (K) with FEC
+  bool     parityPending;
+  uint16_t parityGroup;
+  uint8_t  parityAcc[8]; // XOR of the group's payloads so far
+  uint16_t offset;
+  uint16_t seq;
+  bool     started;
+  uint16_t stdId;
+  uint8_t  dest;
+  uint8_t  extPrio;
+  uint8_t  msgId;
+  uint32_t framesOut;
+
+  // Would next() produce a frame?
+  bool produces() const { return resumePending || parityPending || !started || offset < len; }
+
+  void pollControl() {
+    struct can_frame rx;
+    while (hal.receiveFrame(rx)) onControl(rx);
+  }
+
+  // Frame `n` of the message (0 = start frame); leaves offset just past its payload
+  void writeFrame(struct can_frame &tx, uint16_t n, uint8_t flags) {
+    const bool extended = framing == canframing::FRAMING_EXTENDED;
+    uint8_t header, max;
+    if (n == 0) {
+      header = canframing::startHeaderLen(framing);
+      max = canframing::startPayloadMax(framing);
+      offset = 0;
+      tx.can_id = extended ? canframing::extFrameId(canframing::EXT_TYPE_START, dest, sourceId, msgId, flags, extPrio) : stdId;
+      canframing::writeStartHeader(tx, framing, len, flags);
+    } else {
+      header = canframing::contHeaderLen(framing);
+      max = canframing::contPayloadMax(framing);
+      offset = (uint16_t)canframing::contOffset(framing, n);
+      tx.can_id = extended ? canframing::extFrameId(canframing::EXT_TYPE_DATA, dest, sourceId, msgId, n, extPrio) : stdId;
+      canframing::writeContHeader(tx, framing, n);
+    }
+    const uint8_t chunk = len - offset >= max ? max : (uint8_t)(len - offset);
+    copyOut(&tx.data[header], offset, chunk);
+    tx.can_dlc = header + chunk;
+    offset += chunk;
+    framesOut++;
+    if (!fecK || n == 0) return;
+    // FEC messages never resend a frame, so each one is folded into its group's parity once
+    for (uint8_t i = 0; i < chunk; ++i) parityAcc[i] ^= tx.data[header + i];
+    if (n % fecK == 0 || n == total - 1) {
+      parityPending = true;
+      parityGroup = (uint16_t)((n - 1) / fecK);
+    }
+  }
+
+  // Parity frame of the group that just ended: the continuation layout, payload zero-padded
+  void writeParity(struct can_frame &tx) {
+    const uint8_t header = canframing::contHeaderLen(framing);
+    tx.can_id = framing == canframing::FRAMING_EXTENDED
+                    ? canframing::extFrameId(canframing::EXT_TYPE_PARITY, dest, sourceId, msgId, parityGroup, extPrio)
+                    : stdId;
+    canframing::writeParityHeader(tx, framing, parityGroup);
+    memcpy(&tx.data[header], parityAcc, canframing::contPayloadMax(framing));
+    tx.can_dlc = 8;
+    memset(parityAcc, 0, sizeof(parityAcc));
+    parityPending = false;
+    framesOut++;
+    st.parity++;
+  }
+
+  // Message bytes [at, at + n): the FEC group byte, data, then the trailer. Data is folded
+  // into the CRC (crc32::BATCH bytes at a time) as it first goes out, which is in order,
+  // so the CRC is final by the time the trailer is copied.
+  void copyOut(uint8_t *dst, uint16_t at, uint8_t n) {
+    const uint16_t end = (uint16_t)(at + n);
+    if (at < prefix && at < end) {
+      *dst++ = fecK;
+      at++;
+    }
+    const uint16_t dataEnd = end < prefix + dataLen ? end : (uint16_t)(prefix + dataLen);
+    if (at < dataEnd) memcpy(dst, data + at - prefix, dataEnd - at);
+    if (!(extraFlags & canframing::START_FLAG_CRC)) return;
+    const uint16_t folded = (uint16_t)(dataEnd - prefix);
+    if (folded > crcPos && (folded - crcPos >= crc32::BATCH || folded == dataLen)) {
+      crc = crc32::update(crc, data + crcPos, folded - crcPos);
+      crcPos = folded;
+    }
+    const uint16_t trailerAt = (uint16_t)(prefix + dataLen);
+    for (uint16_t i = at > trailerAt ? at : trailerAt; i < end; ++i) dst[i - at] = (uint8_t)(crc >> (8 * (i - trailerAt)));
+  }
+
+  // Window bookkeeping: bit i of ackedBits/resendBits/retxBits = frame base + i
+
+  uint8_t parity() const { return (parityBits & canframing::receiverBit(resumeTarget)) ? 1 : 0; }
+
+  uint32_t inFlightBits() const {
+    const uint16_t n = nextNew - base;
+    return n >= 32 ? 0xFFFFFFFFu : ((1u << n) - 1);
+  }
+
+  bool nextWindowed(struct can_frame &tx) {
+    if (confirmed || gaveUp) return false;
+    const uint8_t flags = canframing::START_FLAG_ACK | (parity() ? canframing::START_FLAG_PARITY : 0) | extraFlags;
+    if (resendBits) {
+      uint8_t i = 0;
+      while (!(resendBits & (1u << i))) i++;
+      resendBits &= ~(1u << i);
+      retxBits |= 1u << i;
+      st.retransmits++;
+      writeFrame(tx, (uint16_t)(base + i), flags);
+      return true;
+    }
+    if (nextNew >= total || nextNew - base >= win) return false;
+    sentUs[nextNew % canframing::ACK_WINDOW_MAX] = hal.micros();
+    writeFrame(tx, nextNew++, flags);
+    return true;
+  }
+
+  bool onAck(uint16_t cumulative, uint32_t bits, bool quiet) {
+    if (confirmed || gaveUp || cumulative < base || cumulative > nextNew) return false;
+    st.acks++;
+    const uint32_t now = hal.micros();
+    if (cumulative > base) {
+      const uint16_t last = (uint16_t)(cumulative - 1 - base);
+      if (!(retxBits & (1u << last))) {
+        const uint32_t rtt = now - sentUs[(cumulative - 1) % canframing::ACK_WINDOW_MAX];
+        st.rttSamples++;
+        st.rttTotalUs += rtt;
+        if (rtt > st.rttMaxUs) st.rttMaxUs = rtt;
+      }
+      const uint16_t shift = cumulative - base;
+      ackedBits = shift >= 32 ? 0 : ackedBits >> shift;
+      resendBits = shift >= 32 ? 0 : resendBits >> shift;
+      retxBits = shift >= 32 ? 0 : retxBits >> shift;
+      base = cumulative;
+      progressUs = now;
+      rtoCount = 0;
+    }
+    // bits: frames past the first missing one; everything they skip was lost (or is
+    // still in flight behind them, which CAN doesn't reorder), so send it once more
+    uint8_t highest = 0;
+    for (uint8_t i = 0; i < 31 && base + 1 + i < nextNew; ++i) {
+      if (!(bits & (1u << i))) continue;
+      ackedBits |= 1u << (i + 1);
+      highest = (uint8_t)(i + 1);
+    }
+    if (highest) {
+      const uint32_t gaps = ((1u << highest) - 1) & ~ackedBits & ~retxBits;
+      resendBits |= gaps;
+    }
+    // The receiver heard nothing more for a while: whatever it lacks is lost
+    if (quiet) resendBits |= inFlightBits() & ~ackedBits;
+    return true;
+  }
+
+  uint32_t resumeWindowUs;
+  uint8_t  resumeTarget;  // receiver id of a resumable/windowed message, 0 otherwise
+  bool     resumePending; // next frame is a resume marker
+  uint8_t  resumeCount;
+  bool     confirmed;
+
+  uint8_t  windowSize;
+  uint32_t rtoUs;
+  uint8_t  parityBits; // START_FLAG_PARITY per receiver, bit n-1 = receiver n
+  uint8_t  win;        // window of the current message, 0 = not windowed
+  uint16_t total;      // frames in the current message
+  uint16_t base;       // oldest unacknowledged frame
+  uint16_t nextNew;    // next frame never sent
+  uint32_t ackedBits;
+  uint32_t resendBits;
+  uint32_t retxBits;
+  uint32_t sentUs[canframing::ACK_WINDOW_MAX];
+  uint32_t progressUs; // last time the window slid (or the message started)
+  uint8_t  rtoCount;
+  bool     gaveUp;
+  Stats    st;
+};
@@ -0,0 +1,82 @@
+/*
+ * CRC-32 for the end-to-end message trailer (IEEE 802.3 / zlib: reflected polynomial
+ * 0xEDB88320, initial value and final XOR 0xFFFFFFFF; "123456789" -> 0xCBF43926)
+ * - update(crc, data, n) continues a running CRC in zlib's convention: start from 0, and
+ *   update(update(0, a), b) is the CRC of a followed by b, so bytes can be folded in
+ *   piecewise as frames are built or arrive
+ * - On the ESP32 update() is the ROM's crc32_le() (its table lives in mask ROM, no RAM);
+ *   elsewhere it is slice-by-8 (8 KB of tables, built on first use, 8 bytes per step)
+ * - updateBytewise() is the classic one-table loop (1 KB), the reference the others are
+ *   checked against and the portable fallback
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(ESP_PLATFORM)
+#if __has_include(<esp32/rom/crc.h>)
+#include <esp32/rom/crc.h>
+#else
+#include <rom/crc.h>
+#endif
+#endif
+
+namespace crc32 {
+
+static const uint32_t POLY  = 0xEDB88320u;
+static const uint32_t CHECK = 0xCBF43926u; // CRC of "123456789"
+// Fold frame payloads this many bytes at a time where the data allows: one frame's 6-8
+// bytes never reach slice-by-8's inner loop, and the call overhead dominates
+static const uint8_t  BATCH = 64;
+
+// tables[k][b]: CRC of byte b followed by k zero bytes; tables[0] is the bytewise table
+inline const uint32_t (*tables())[256] {
+  static uint32_t t[8][256];
+  static bool ready = false;
+  if (!ready) {
+    for (uint32_t b = 0; b < 256; ++b) {
+      uint32_t c = b;
+      for (uint8_t k = 0; k < 8; ++k) c = (c >> 1) ^ (POLY & (0u - (c & 1)));
+      t[0][b] = c;
+    }
+    for (uint32_t b = 0; b < 256; ++b) {
+      for (uint8_t k = 1; k < 8; ++k) t[k][b] = (t[k - 1][b] >> 8) ^ t[0][t[k - 1][b] & 0xFF];
+    }
+    ready = true;
+  }
+  return t;
+}
+
+inline uint32_t updateBytewise(uint32_t crc, const uint8_t *p, size_t n) {
+  const uint32_t *t = tables()[0];
+  crc = ~crc;
+  while (n--) crc = (crc >> 8) ^ t[(crc ^ *p++) & 0xFF];
+  return ~crc;
+}
+
+inline uint32_t updateSlice8(uint32_t crc, const uint8_t *p, size_t n) {
+  const uint32_t (*t)[256] = tables();
+  crc = ~crc;
+  while (n >= 8) {
+    // Byte by byte, so it doesn't depend on alignment or endianness
+    const uint32_t lo = crc ^ ((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+    crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^ t[3][p[4]] ^
+          t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+    p += 8;
+    n -= 8;
+  }
+  while (n--) crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+  return ~crc;
+}
+
+inline uint32_t update(uint32_t crc, const uint8_t *p, size_t n) {
+#if defined(ESP_PLATFORM)
+  return crc32_le(crc, p, (uint32_t)n);
+#else
+  return updateSlice8(crc, p, n);
+#endif
+}
+
+} // namespace crc32
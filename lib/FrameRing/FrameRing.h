@@ -0,0 +1,75 @@
+/*
+ * Lock-free single-producer/single-consumer ring of CAN frames
+ * - Fixed, power-of-two capacity; no heap, no locks
+ * - Producer (CAN RX task/ISR context) only ever writes head, consumer only writes tail
+ * - push() copies id, dlc and the 8 data bytes; a full ring drops the frame and counts it
+ * - High-water mark shows how close the consumer came to falling behind
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+#if defined(ARDUINO)
+#include <can.h>
+#else
+#include <linux/can.h>
+#endif
+
+template <uint32_t CAPACITY>
+class FrameRing {
+  static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0, "FrameRing capacity must be a power of two");
+
+public:
+  FrameRing() : head(0), tail(0), hwm(0), overflowCount(0) {}
+
+  static uint32_t capacity() { return CAPACITY; }
+
+  // Producer side. Returns false (and counts an overflow) when the ring is full.
+  bool push(const struct can_frame &frm) {
+    const uint32_t h = head.load(std::memory_order_relaxed);
+    const uint32_t used = h - tail.load(std::memory_order_acquire);
+    if (used >= CAPACITY) {
+      overflowCount.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    struct can_frame &slot = slots[h & (CAPACITY - 1)];
+    slot.can_id = frm.can_id;
+    slot.can_dlc = frm.can_dlc;
+    memcpy(slot.data, frm.data, sizeof(slot.data));
+    head.store(h + 1, std::memory_order_release);
+    if (used + 1 > hwm.load(std::memory_order_relaxed)) {
+      hwm.store(used + 1, std::memory_order_relaxed);
+    }
+    return true;
+  }
+
+  // Consumer side. Returns false when the ring is empty.
+  bool pop(struct can_frame &frm) {
+    const uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) {
+      return false;
+    }
+    const struct can_frame &slot = slots[t & (CAPACITY - 1)];
+    frm.can_id = slot.can_id;
+    frm.can_dlc = slot.can_dlc;
+    memcpy(frm.data, slot.data, sizeof(frm.data));
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  uint32_t size() const {
+    return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+  }
+  uint32_t highWater() const { return hwm.load(std::memory_order_relaxed); }
+  uint32_t overflows() const { return overflowCount.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint32_t> head;          // next slot to write (producer)
+  std::atomic<uint32_t> tail;          // next slot to read (consumer)
+  std::atomic<uint32_t> hwm;           // written by producer only
+  std::atomic<uint32_t> overflowCount; // written by producer only
+  struct can_frame slots[CAPACITY];
+};
@@ -0,0 +1,314 @@
+/*
+ * ISO 15765-2 (ISO-TP) transport, classic CAN, normal addressing
+ * - Single frame (SF), first frame (FF), consecutive frames (CF) and flow control (FC)
+ * - Receiver advertises BlockSize and STmin in FC; the sender obeys them, so the
+ *   receiver sets the pace instead of the sender guessing
+ * - Messages up to 4095 bytes (12-bit FF_DL); frames are padded to 8 bytes
+ *
+ * Both sides are non-blocking state machines so they can be driven from the
+ * firmware loops or from a host-side loopback:
+ *   IsoTpSender: start() then call poll() until it returns DONE/FAILED, feeding
+ *                received FC frames to onFlowControl()
+ *   IsoTpReceiver: feed every frame for our ID to onFrame(); send `fc` when it asks
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(ARDUINO)
+#include <can.h>
+#else
+#include <linux/can.h>
+#endif
+
+namespace isotp {
+
+static const uint16_t MAX_LEN = 4095;
+static const uint8_t  PAD_BYTE = 0xCC;
+
+// Protocol control information, high nibble of data[0]
+static const uint8_t PCI_SF = 0x0;
+static const uint8_t PCI_FF = 0x1;
+static const uint8_t PCI_CF = 0x2;
+static const uint8_t PCI_FC = 0x3;
+
+// Flow status, low nibble of an FC frame's data[0]
+static const uint8_t FS_CTS   = 0x0;
+static const uint8_t FS_WAIT  = 0x1;
+static const uint8_t FS_OVFLW = 0x2;
+
+// Timeouts (N_Bs: sender waiting for FC, N_Cr: receiver waiting for CF)
+static const uint32_t N_BS_US = 1000000;
+static const uint32_t N_CR_US = 1000000;
+static const uint8_t  MAX_WFT = 10; // FC.WAIT frames tolerated in a row
+
+// STmin byte -> microseconds (reserved values are treated as the 127 ms maximum)
+inline uint32_t stminToUs(uint8_t st) {
+  if (st <= 0x7F) return (uint32_t)st * 1000;
+  if (st >= 0xF1 && st <= 0xF9) return (uint32_t)(st - 0xF0) * 100;
+  return 127000;
+}
+
+// Microseconds -> smallest STmin byte that is at least that long
+inline uint8_t usToStmin(uint32_t us) {
+  if (us == 0) return 0;
+  if (us <= 900) return (uint8_t)(0xF0 + (us + 99) / 100);
+  const uint32_t ms = (us + 999) / 1000;
+  return ms > 0x7F ? 0x7F : (uint8_t)ms;
+}
+
+inline void padFrame(struct can_frame &frm, uint8_t used) {
+  for (uint8_t i = used; i < 8; ++i) frm.data[i] = PAD_BYTE;
+  frm.can_dlc = 8;
+}
+
+} // namespace isotp
+
+class IsoTpSender {
+public:
+  enum Result { FRAME, WAIT, DONE, FAILED };
+
+  IsoTpSender() { reset(); }
+
+  void reset() {
+    st = IDLE;
+    data = nullptr;
+    len = offset = 0;
+    sn = 0;
+    blockSize = blockLeft = 0;
+    stminUs = 0;
+    wftCount = 0;
+    deadlineUs = 0;
+  }
+
+  // Begin a transfer; `payload` must stay valid until DONE/FAILED.
+  bool start(const uint8_t *payload, uint16_t length, uint32_t nowUs) {
+    reset();
+    if (length == 0 || length > isotp::MAX_LEN) return false;
+    data = payload;
+    len = length;
+    deadlineUs = nowUs;
+    st = FIRST;
+    return true;
+  }
+
+  // Produce the next frame to transmit (FRAME), or report why there is none.
+  Result poll(uint32_t nowUs, struct can_frame &out) {
+    switch (st) {
+      case FIRST:
+        if (len <= 7) {
+          out.data[0] = (uint8_t)((isotp::PCI_SF << 4) | len);
+          memcpy(&out.data[1], data, len);
+          isotp::padFrame(out, (uint8_t)(1 + len));
+          st = COMPLETE;
+          return FRAME;
+        }
+        out.data[0] = (uint8_t)((isotp::PCI_FF << 4) | ((len >> 8) & 0x0F));
+        out.data[1] = (uint8_t)(len & 0xFF);
+        memcpy(&out.data[2], data, 6);
+        out.can_dlc = 8;
+        offset = 6;
+        sn = 1;
+        st = WAIT_FC;
+        deadlineUs = nowUs + isotp::N_BS_US;
+        return FRAME;
+
+      case WAIT_FC:
+        if ((int32_t)(nowUs - deadlineUs) >= 0) {
+          st = ERROR;
+          return FAILED;
+        }
+        return WAIT;
+
+      case SENDING: {
+        if ((int32_t)(nowUs - deadlineUs) < 0) return WAIT; // STmin not elapsed yet
+        const uint16_t chunk = (len - offset >= 7) ? 7 : (uint16_t)(len - offset);
+        out.data[0] = (uint8_t)((isotp::PCI_CF << 4) | (sn & 0x0F));
+        memcpy(&out.data[1], data + offset, chunk);
+        isotp::padFrame(out, (uint8_t)(1 + chunk));
+        offset += chunk;
+        sn = (uint8_t)((sn + 1) & 0x0F);
+        if (offset >= len) {
+          st = COMPLETE;
+        } else if (blockSize != 0 && --blockLeft == 0) {
+          st = WAIT_FC;
+          deadlineUs = nowUs + isotp::N_BS_US;
+        } else {
+          deadlineUs = nowUs + stminUs;
+        }
+        return FRAME;
+      }
+
+      case COMPLETE:
+        st = IDLE;
+        return DONE;
+
+      case ERROR:
+        return FAILED;
+
+      case IDLE:
+      default:
+        return DONE;
+    }
+  }
+
+  // Feed a frame received on the response ID. Non-FC frames are ignored.
+  void onFlowControl(const struct can_frame &fc, uint32_t nowUs) {
+    if (st != WAIT_FC || fc.can_dlc < 3 || (fc.data[0] >> 4) != isotp::PCI_FC) return;
+    switch (fc.data[0] & 0x0F) {
+      case isotp::FS_CTS:
+        blockSize = fc.data[1];
+        blockLeft = blockSize;
+        stminUs = isotp::stminToUs(fc.data[2]);
+        wftCount = 0;
+        st = SENDING;
+        deadlineUs = nowUs; // first CF of a block may go immediately
+        break;
+      case isotp::FS_WAIT:
+        if (++wftCount > isotp::MAX_WFT) {
+          st = ERROR;
+        } else {
+          deadlineUs = nowUs + isotp::N_BS_US;
+        }
+        break;
+      default: // FS_OVFLW or reserved: receiver can't take this message
+        st = ERROR;
+        break;
+    }
+  }
+
+  bool busy() const { return st != IDLE && st != ERROR; }
+  uint32_t stminMicros() const { return stminUs; }
+  uint8_t blockSizeInUse() const { return blockSize; }
+
+private:
+  enum State { IDLE, FIRST, WAIT_FC, SENDING, COMPLETE, ERROR };
+
+  State          st;
+  const uint8_t *data;
+  uint16_t       len;
+  uint16_t       offset;
+  uint8_t        sn;
+  uint8_t        blockSize;
+  uint8_t        blockLeft;
+  uint8_t        wftCount;
+  uint32_t       stminUs;
+  uint32_t       deadlineUs;
+};
+
+class IsoTpReceiver {
+public:
+  enum Result { NONE, IN_PROGRESS, COMPLETE, ERROR };
+
+  // `blockSize` CFs per FC (0 = no further FC), `stmin` raw STmin byte to advertise.
+  IsoTpReceiver(uint8_t *buffer, uint16_t capacity, uint8_t blockSize, uint8_t stmin)
+      : buf(buffer), cap(capacity), bs(blockSize), stminByte(stmin) {
+    reset();
+  }
+
+  void reset() {
+    active = false;
+    expected = received = 0;
+    sn = 0;
+    blockLeft = 0;
+    lastUs = 0;
+  }
+
+  void setFlowParams(uint8_t blockSize, uint8_t stmin) {
+    bs = blockSize;
+    stminByte = stmin;
+  }
+
+  // Feed one frame. When `sendFc` comes back true, transmit `fc` on the response ID.
+  Result onFrame(const struct can_frame &in, uint32_t nowUs, struct can_frame &fc, bool &sendFc) {
+    sendFc = false;
+    if (in.can_dlc < 1) return NONE;
+    const uint8_t pci = in.data[0] >> 4;
+
+    if (pci == isotp::PCI_SF) {
+      const uint8_t n = in.data[0] & 0x0F;
+      reset();
+      if (n == 0 || n > 7 || n + 1 > in.can_dlc || n > cap) return ERROR;
+      memcpy(buf, &in.data[1], n);
+      expected = received = n;
+      return COMPLETE;
+    }
+
+    if (pci == isotp::PCI_FF) {
+      reset();
+      if (in.can_dlc < 8) return ERROR;
+      expected = (uint16_t)(((in.data[0] & 0x0F) << 8) | in.data[1]);
+      if (expected <= 7) return ERROR;
+      if (expected > cap) {
+        makeFc(fc, isotp::FS_OVFLW);
+        sendFc = true;
+        return ERROR;
+      }
+      memcpy(buf, &in.data[2], 6);
+      received = 6;
+      sn = 1;
+      active = true;
+      lastUs = nowUs;
+      blockLeft = bs;
+      makeFc(fc, isotp::FS_CTS);
+      sendFc = true;
+      return IN_PROGRESS;
+    }
+
+    if (pci == isotp::PCI_CF) {
+      if (!active) return NONE;
+      if ((uint32_t)(nowUs - lastUs) > isotp::N_CR_US || (in.data[0] & 0x0F) != sn) {
+        reset();
+        return ERROR;
+      }
+      uint16_t chunk = (uint16_t)(expected - received);
+      if (chunk > 7) chunk = 7;
+      if (chunk + 1 > in.can_dlc) {
+        reset();
+        return ERROR;
+      }
+      memcpy(buf + received, &in.data[1], chunk);
+      received += chunk;
+      sn = (uint8_t)((sn + 1) & 0x0F);
+      lastUs = nowUs;
+      if (received >= expected) {
+        active = false;
+        return COMPLETE;
+      }
+      if (bs != 0 && --blockLeft == 0) {
+        blockLeft = bs;
+        makeFc(fc, isotp::FS_CTS);
+        sendFc = true;
+      }
+      return IN_PROGRESS;
+    }
+
+    return NONE; // FC frames and reserved PCI types aren't for the receiver
+  }
+
+  const uint8_t *data() const { return buf; }
+  uint16_t length() const { return received; }
+  uint16_t expectedLength() const { return expected; }
+  bool inProgress() const { return active; }
+
+private:
+  void makeFc(struct can_frame &fc, uint8_t flowStatus) const {
+    fc.data[0] = (uint8_t)((isotp::PCI_FC << 4) | flowStatus);
+    fc.data[1] = bs;
+    fc.data[2] = stminByte;
+    isotp::padFrame(fc, 3);
+  }
+
+  uint8_t *buf;
+  uint16_t cap;
+  uint8_t  bs;
+  uint8_t  stminByte;
+  bool     active;
+  uint16_t expected;
+  uint16_t received;
+  uint8_t  sn;
+  uint8_t  blockLeft;
+  uint32_t lastUs;
+};
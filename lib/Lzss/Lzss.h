@@ -0,0 +1,237 @@
+/*
+ * LZSS payload compression (heatshrink-style bit stream, no allocation)
+ * - Stream: HEADER_LEN bytes, then tokens, most significant bit first. The header holds
+ *   the original length (little endian, below 0x8000), or for a dictionary stream the
+ *   length (1..255) and DICT_MARK | the dictionary's id. Tokens:
+ *     1, 8 bits                           literal byte
+ *     0, WINDOW_BITS, LENGTH_BITS         copy MIN_MATCH.. bytes from distance 1..WINDOW
+ *   padded with zero bits to a whole byte
+ * - The window is the message itself: LzssEncoder searches the input it was handed through
+ *   a hash chain (HASH_SIZE + WINDOW 16-bit entries), and decode() copies from the output
+ *   it already wrote, so neither side keeps a window buffer of its own
+ * - Dictionary streams (short messages) start with a pre-shared Dictionary as history, so
+ *   copies can reach back into it (distance past the output start); the id lets the
+ *   decoder refuse a stream made with another dictionary. The encoder searches a copy of
+ *   dictionary + message (WINDOW + DICT_MSG_MAX bytes)
+ * - decode() is streaming: it consumes the whole tokens in however much of the stream has
+ *   arrived and picks up from its bit position on the next call. It can run in place,
+ *   with the stream stored at the end of the output buffer; fitsInPlace() says whether a
+ *   buffer is large enough for that, and decode() refuses to overwrite input it hasn't
+ *   read
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+namespace lzss {
+
+static const uint8_t  HEADER_LEN  = 2;
+static const uint8_t  WINDOW_BITS = 9;
+static const uint8_t  LENGTH_BITS = 4;
+static const uint16_t WINDOW      = 1u << WINDOW_BITS;
+static const uint8_t  MIN_MATCH   = 2; // a 14-bit copy beats two 9-bit literals
+static const uint16_t MAX_MATCH   = MIN_MATCH + (1u << LENGTH_BITS) - 1;
+static const uint16_t HASH_SIZE   = 256;
+static const uint8_t  MAX_CHAIN   = 16; // candidates tried per position
+static const uint8_t  DICT_MARK   = 0x80;
+static const uint16_t DICT_MSG_MAX = 255; // longest message coded against a dictionary
+
+// Pre-shared history for short messages; at most WINDOW bytes are reachable, the most
+// useful strings belong at the end (nearest the message)
+struct Dictionary {
+  const uint8_t *data;
+  uint16_t len;
+  uint8_t  id; // 7 bits
+};
+
+inline bool isDictionaryStream(const uint8_t *stream) { return stream[1] & DICT_MARK; }
+inline uint8_t dictionaryId(const uint8_t *stream) { return stream[1] & (uint8_t)~DICT_MARK; }
+inline uint16_t plainLength(const uint8_t *stream) {
+  return isDictionaryStream(stream) ? stream[0] : (uint16_t)(stream[0] | (stream[1] << 8));
+}
+
+// Can a stream of wireLen bytes expanding to plainLen be decoded in place in a buffer of
+// bufferSize bytes, the stream occupying its last wireLen bytes? A literal spends 9 bits
+// on a byte, so the output gains on the unread input by at most wireLen / 9 on the way.
+inline bool fitsInPlace(uint16_t plainLen, uint16_t wireLen, uint16_t bufferSize) {
+  return wireLen <= bufferSize && (uint32_t)plainLen + (wireLen + 7) / 8 + 2 <= bufferSize;
+}
+
+class LzssEncoder {
+public:
+  // Compress in[0..len) into out. Returns the stream length, or 0 if it would not be
+  // shorter than the input or doesn't fit in outCap.
+  uint16_t compress(const uint8_t *in, uint16_t len, uint8_t *out, uint16_t outCap) {
+    if (len < 2 || len >= 0x8000) return 0;
+    out[0] = (uint8_t)len;
+    out[1] = (uint8_t)(len >> 8);
+    return encode(in, 0, len, out, outCap);
+  }
+
+  // The same against a pre-shared dictionary (messages up to DICT_MSG_MAX bytes)
+  uint16_t compress(const uint8_t *in, uint16_t len, uint8_t *out, uint16_t outCap, const Dictionary &dict) {
+    if (len < 2 || len > DICT_MSG_MAX || dict.len > WINDOW) return 0;
+    memcpy(joined, dict.data, dict.len);
+    memcpy(joined + dict.len, in, len);
+    out[0] = (uint8_t)len;
+    out[1] = (uint8_t)(DICT_MARK | dict.id);
+    return encode(joined, dict.len, (uint16_t)(dict.len + len), out, outCap);
+  }
+
+  // What a sender transmits: the shorter of the dictionary stream (if there is a
+  // dictionary) and the plain one, as long as it decodes in place in a receiver buffer of
+  // bufferSize bytes. 0 = send the message as it is.
+  uint16_t compressBest(const uint8_t *in, uint16_t len, uint8_t *out, uint16_t outCap, const Dictionary *dict,
+                        uint16_t bufferSize) {
+    uint16_t best = dict && dict->len ? compress(in, len, out, outCap, *dict) : 0;
+    if (best) {
+      const uint16_t n = compress(in, len, spare, (uint16_t)(best - 1));
+      if (n) {
+        memcpy(out, spare, n);
+        best = n;
+      }
+    } else {
+      best = compress(in, len, out, outCap);
+    }
+    return best && fitsInPlace(len, best, bufferSize) ? best : 0;
+  }
+
+private:
+  // Tokens for buf[from..to), buf[0..from) being history that is already known
+  uint16_t encode(const uint8_t *buf, uint16_t from, uint16_t to, uint8_t *out, uint16_t outCap) {
+    const uint16_t len = (uint16_t)(to - from);
+    if (outCap <= HEADER_LEN) return 0;
+    const uint16_t cap = outCap < len ? outCap : (uint16_t)(len - 1);
+    memset(head, 0xFF, sizeof(head));
+    for (uint16_t i = 0; i < from; ++i) insert(buf, to, i);
+    o = out;
+    outLen = cap;
+    byte = HEADER_LEN;
+    bits = 0;
+    acc = 0;
+    uint16_t i = from;
+    while (i < to) {
+      uint16_t dist = 0;
+      const uint16_t n = longestMatch(buf, to, i, dist);
+      if (n >= MIN_MATCH) {
+        if (!put(0, 1) || !put(dist - 1, WINDOW_BITS) || !put(n - MIN_MATCH, LENGTH_BITS)) return 0;
+        for (uint16_t k = 0; k < n; ++k) insert(buf, to, (uint16_t)(i + k));
+        i = (uint16_t)(i + n);
+      } else {
+        if (!put(1, 1) || !put(buf[i], 8)) return 0;
+        insert(buf, to, i);
+        i++;
+      }
+    }
+    if (bits && !put(0, (uint8_t)(8 - bits))) return 0;
+    return byte;
+  }
+
+  static uint8_t hash(const uint8_t *p) { return (uint8_t)((p[0] * 33) ^ p[1]); }
+
+  void insert(const uint8_t *in, uint16_t len, uint16_t i) {
+    if (i + 1 >= len) return;
+    const uint8_t h = hash(in + i);
+    prev[i & (WINDOW - 1)] = head[h];
+    head[h] = i;
+  }
+
+  uint16_t longestMatch(const uint8_t *in, uint16_t len, uint16_t i, uint16_t &dist) const {
+    if (i + MIN_MATCH > len) return 0;
+    const uint16_t limit = len - i < MAX_MATCH ? (uint16_t)(len - i) : MAX_MATCH;
+    uint16_t best = 0;
+    uint16_t cand = head[hash(in + i)];
+    for (uint8_t tries = 0; tries < MAX_CHAIN && cand != NONE && cand < i && i - cand <= WINDOW; ++tries) {
+      if (in[cand + best] == in[i + best]) {
+        uint16_t n = 0;
+        while (n < limit && in[cand + n] == in[i + n]) n++;
+        if (n > best) {
+          best = n;
+          dist = (uint16_t)(i - cand);
+          if (n == limit) break;
+        }
+      }
+      const uint16_t next = prev[cand & (WINDOW - 1)];
+      if (next >= cand) break; // slot reused by a newer position: chain ends
+      cand = next;
+    }
+    return best;
+  }
+
+  bool put(uint16_t v, uint8_t n) {
+    while (n--) {
+      acc = (uint8_t)((acc << 1) | ((v >> n) & 1));
+      if (++bits == 8) {
+        if (byte >= outLen) return false;
+        o[byte++] = acc;
+        bits = 0;
+        acc = 0;
+      }
+    }
+    return true;
+  }
+
+  static const uint16_t NONE = 0xFFFF;
+  uint16_t head[HASH_SIZE];
+  uint16_t prev[WINDOW];
+  uint8_t  joined[WINDOW + DICT_MSG_MAX]; // dictionary + message
+  uint8_t  spare[DICT_MSG_MAX];          // plain stream, to compare with the dictionary one
+  uint8_t *o;
+  uint16_t outLen;
+  uint16_t byte;
+  uint8_t  bits;
+  uint8_t  acc;
+};
+
+inline uint16_t readBits(const uint8_t *in, uint32_t &bit, uint8_t n) {
+  uint16_t v = 0;
+  while (n--) {
+    v = (uint16_t)((v << 1) | ((in[bit >> 3] >> (7 - (bit & 7))) & 1));
+    bit++;
+  }
+  return v;
+}
+
+enum DecodeResult : uint8_t {
+  DECODE_MORE,  // waiting for more of the stream
+  DECODE_DONE,  // plainLen bytes written
+  DECODE_ERROR, // copy from before the start (of the dictionary), or output would overrun unread input
+};
+
+// Decode the whole tokens in stream[0..avail) into out[pos..plainLen). `bit` is the read
+// position, HEADER_LEN * 8 before the first call; both it and `pos` carry over between
+// calls. `streamAt` is the stream's offset in `out` when decoding in place; pass plainLen
+// (or more) for separate buffers. A dictionary stream needs the dictionary it was made with.
+inline DecodeResult decode(const uint8_t *stream, uint32_t avail, uint32_t &bit, uint8_t *out, uint16_t &pos,
+                           uint16_t plainLen, uint32_t streamAt, const Dictionary *dict = nullptr) {
+  const uint16_t history = dict ? dict->len : 0;
+  const uint32_t end = avail * 8;
+  while (pos < plainLen) {
+    if (bit >= end) return DECODE_MORE;
+    uint32_t b = bit;
+    if (readBits(stream, b, 1)) {
+      if (b + 8 > end) return DECODE_MORE;
+      const uint8_t v = (uint8_t)readBits(stream, b, 8);
+      if (pos + 1u > streamAt + (b >> 3)) return DECODE_ERROR;
+      out[pos++] = v;
+    } else {
+      if (b + WINDOW_BITS + LENGTH_BITS > end) return DECODE_MORE;
+      const uint16_t dist = (uint16_t)(readBits(stream, b, WINDOW_BITS) + 1);
+      uint16_t n = (uint16_t)(readBits(stream, b, LENGTH_BITS) + MIN_MATCH);
+      if (dist > pos + history || n > plainLen - pos || pos + (uint32_t)n > streamAt + (b >> 3)) return DECODE_ERROR;
+      while (n && dist > pos) { // from the dictionary
+        out[pos] = dict->data[history + pos - dist];
+        pos++;
+        n--;
+      }
+      const uint8_t *from = out + pos - dist;
+      while (n--) out[pos++] = *from++; // overlapping copies repeat the pattern
+    }
+    bit = b;
+  }
+  return DECODE_DONE;
+}
+
+} // namespace lzss
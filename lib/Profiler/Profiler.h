@@ -0,0 +1,161 @@
+/*
+ * Scoped-timer profiling probes
+ * - PROFILE_SCOPE("name") times the rest of the enclosing block and aggregates
+ *   count/min/avg/max plus a power-of-two histogram in a static probe table
+ * - Ticks: the Xtensa CCOUNT register on the ESP32 (one per CPU cycle),
+ *   std::chrono::steady_clock nanoseconds elsewhere
+ * - Off unless built with -D PROFILE=1: PROFILE_SCOPE then expands to nothing and
+ *   the probe table isn't compiled in
+ * - Probes aren't atomic: each probe should be hit from one task (they're cheap
+ *   because of that); different probes can live on different tasks
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef PROFILE
+#define PROFILE 0
+#endif
+
+#if PROFILE
+
+#if defined(__XTENSA__)
+#ifndef PROFILE_TICKS_PER_US
+#define PROFILE_TICKS_PER_US 240 // CPU clock in MHz; CCOUNT counts cycles
+#endif
+#else
+#include <chrono>
+#define PROFILE_TICKS_PER_US 1000 // steady_clock nanoseconds
+#endif
+
+#ifndef PROFILE_MAX_PROBES
+#define PROFILE_MAX_PROBES 16
+#endif
+
+namespace profiler {
+
+static const uint8_t HIST_BUCKETS = 24; // bucket b: 2^(b-1) <= ticks < 2^b, last one open-ended
+
+inline uint32_t ticks() {
+#if defined(__XTENSA__)
+  uint32_t c;
+  __asm__ __volatile__("rsr %0, ccount" : "=a"(c));
+  return c;
+#else
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+struct Probe {
+  const char *name;
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t sum;
+  uint32_t hist[HIST_BUCKETS];
+
+  void record(uint32_t t) {
+    count++;
+    sum += t;
+    if (t < min) min = t;
+    if (t > max) max = t;
+    uint8_t b = 0;
+    while (b < HIST_BUCKETS - 1 && t >= (1u << b)) b++;
+    hist[b]++;
+  }
+  void reset() {
+    count = 0;
+    min = 0xFFFFFFFF;
+    max = 0;
+    sum = 0;
+    memset(hist, 0, sizeof(hist));
+  }
+};
+
+struct ProbeTable {
+  Probe probes[PROFILE_MAX_PROBES];
+  uint8_t used;
+  Probe overflow; // shared by probes registered after the table filled up
+};
+
+inline ProbeTable &table() {
+  static ProbeTable t;
+  return t;
+}
+
+// Find or register a probe; called once per PROFILE_SCOPE site (function-local static)
+inline Probe &probe(const char *name) {
+  ProbeTable &t = table();
+  for (uint8_t i = 0; i < t.used; ++i) {
+    if (strcmp(t.probes[i].name, name) == 0) return t.probes[i];
+  }
+  if (t.used >= PROFILE_MAX_PROBES) {
+    if (!t.overflow.name) {
+      t.overflow.name = "(overflow)";
+      t.overflow.reset();
+    }
+    return t.overflow;
+  }
+  Probe &p = t.probes[t.used++];
+  p.name = name;
+  p.reset();
+  return p;
+}
+
+class ScopedTimer {
+public:
+  explicit ScopedTimer(Probe &p) : probe(p), start(ticks()) {}
+  ~ScopedTimer() { probe.record(ticks() - start); }
+
+private:
+  Probe &probe;
+  uint32_t start;
+};
+
+inline void reset() {
+  ProbeTable &t = table();
+  for (uint8_t i = 0; i < t.used; ++i) t.probes[i].reset();
+  t.overflow.reset();
+}
+
+// One line per probe (times in microseconds), then its non-empty histogram buckets;
+// each line goes to sink(const char *) without a trailing newline
+template <typename Sink>
+void dump(Sink &sink) {
+  char line[160];
+  ProbeTable &t = table();
+  snprintf(line, sizeof(line), "%-20s %9s %10s %10s %10s  (%u ticks/us)", "probe", "count", "min us", "avg us",
+           "max us", (unsigned)PROFILE_TICKS_PER_US);
+  sink(line);
+  for (uint8_t i = 0; i <= t.used; ++i) {
+    const Probe &p = i < t.used ? t.probes[i] : t.overflow;
+    if (p.count == 0) continue;
+    const double perUs = PROFILE_TICKS_PER_US;
+    snprintf(line, sizeof(line), "%-20s %9lu %10.3f %10.3f %10.3f", p.name, (unsigned long)p.count, p.min / perUs,
+             (double)p.sum / p.count / perUs, p.max / perUs);
+    sink(line);
+    int n = snprintf(line, sizeof(line), "  hist(ticks <2^b):");
+    for (uint8_t b = 0; b < HIST_BUCKETS && n < (int)sizeof(line) - 16; ++b) {
+      if (p.hist[b]) n += snprintf(line + n, sizeof(line) - n, " %u:%lu", b, (unsigned long)p.hist[b]);
+    }
+    sink(line);
+  }
+}
+
+} // namespace profiler
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name)                                                              \
+  static profiler::Probe &PROFILE_CONCAT(profileProbe_, __LINE__) = profiler::probe(name); \
+  profiler::ScopedTimer PROFILE_CONCAT(profileTimer_, __LINE__)(PROFILE_CONCAT(profileProbe_, __LINE__))
+
+#else // !PROFILE
+
+#define PROFILE_SCOPE(name) do {} while (0)
+
+#endif // PROFILE
@@ -0,0 +1,1363 @@
+#ifdef ROLE_BENCH
+/*
+ * Host-side benchmarks for the CAN transport (PlatformIO `bench` environment)
+ * - Runs on Linux, no hardware needed
+ * - Build & run: pio run -e bench -t exec   (or .pio/build/bench/program [name])
+ *
+ * Benchmarks:
+ * - framing: frames per message for legacy, compact and extended-ID framing, lengths 1..65535
+ * - transport: CanSegmenter -> LoopbackHal -> CanReassembler round trip, byte-exact check and
+ *   host throughput per framing and message length (plus the reassembler's probes when built
+ *   with -D PROFILE=1)
+ * - sim: 500 kbps bus simulation (lib/CanSim) - utilisation, goodput and latency per framing,
+ *   broadcast vs unicast, and a slow receiver with and without TX pacing
+ * - log: cost of an AsyncLog record on the producer side, and of formatting it in drain()
+ * - loss: goodput of unicast 2 KB messages at 0 / 0.1% / 1% random frame loss, dropping a
+ *   message on a gap vs NACK/resume vs an ACK window of 8 (repairs: resumes, or frames
+ *   retransmitted); fails unless resume and the window deliver every message
+ * - window: ACK window sizes per framing at 0 and 1% loss - goodput, RTT, ACKs and
+ *   retransmissions; fails if a windowed run loses a message
+ * - reorder: host cost per frame of reassembling every framing with continuation frames
+ *   shuffled (seeded) as far as the wire sequence can place them, against in order (the
+ *   byte-exact check is in test/test_reorder)
+ * - compress: LZSS compression ratio, host encode/decode cost and simulated net goodput for
+ *   JSON, log, CSV and random corpora; fails unless every compressed message reassembles
+ *   (decompressed in place, frames in order and shuffled) byte for byte. Then the short
+ *   messages of bench/corpus/messages.txt against include/MessageDictionary.h: frames per
+ *   message raw / LZSS / as the sender picks; fails unless every one reassembles, and unless
+ *   a receiver without the dictionary refuses them
+ * - crc: CRC-32 cost per byte, slice-by-8 vs the one-table loop (ns and, on x86, TSC cycles),
+ *   the trailer's cost on a host round trip and on the simulated bus; fails unless the CRC
+ *   folds piecewise, messages with a trailer round-trip in every framing, and a frame
+ *   spliced in from a restarted transfer is caught
+ * - fec [file.csv]: rebuilding a lost frame from its group's parity, checked in every
+ *   framing and group size, plain, compressed and with the CRC trailer (fails unless each
+ *   message comes back byte for byte, and unless two losses in a group drop it); then
+ *   simulated goodput of 2 KB messages at 0..5% loss without FEC and with K = 4, 8, 16,
+ *   optionally written as CSV for plotting
+ * - prio: worst-case and median latency of 1-frame urgent messages submitted while a 2 KB
+ *   transfer is running, urgent preempting the bulk class vs both in one class (queued
+ *   behind it); fails if a preempting urgent message waits more than 5 frame times
+ * - capture [file.pcap]: CaptureRing push cost, bytes per frame and a decode check over
+ *   overwrites and clock wraps; optionally writes what the ring holds as PCAP
+ * - sniffer: per-frame cost of the sniffer's per-ID table and bus load windows on a
+ *   saturated bus, and a check of the load and jitter figures they report
+ * - suite [baseline.json] [--results file] [--write]: simulated sweep over message length,
+ *   TX pacing and receiver count, compared against the committed baseline (default
+ *   bench/baseline.json); exits non-zero on a regression beyond the baseline's tolerances,
+ *   --write replaces it. --results compares lines captured elsewhere (the sender's
+ *   "bench <target>" output from a board) instead of simulating
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include <CanFraming.h>
+#include <AsyncLog.h>
+#include <CanSegmenter.h>
+#include <CanReassembler.h>
+#include <Lzss.h>
+#include <Crc32.h>
+#include <MessageDictionary.h>
+#include <SimScenario.h>
+#include <Profiler.h>
+#include <CaptureRing.h>
+#include <CaptureExport.h>
+#include <IdStats.h>
+#include <BusLoad.h>
+
+using canframing::FRAMING_LEGACY;
+using canframing::FRAMING_COMPACT;
+using canframing::FRAMING_EXTENDED;
+
+static int benchFraming(int, char **) {
+  printf("== framing: frames per message (legacy 0xAA/0xCC, compact 1-byte PCI, extended 29-bit ID) ==\n");
+  printf("%8s %10s %10s %10s %12s %12s %12s\n", "len", "legacy", "compact", "extended",
+         "legacy eff", "compact eff", "ext eff");
+
+  static const uint32_t samples[] = {1, 4, 5, 6, 8, 10, 11, 12, 14, 64, 100, 256, 1024, 1534, 2048, 4095, 16384, 65535};
+  for (size_t i = 0; i < sizeof(samples) / sizeof(samples[0]); ++i) {
+    const uint32_t len = samples[i];
+    const uint32_t legacy = canframing::framesForLength(FRAMING_LEGACY, len);
+    const uint32_t compact = canframing::framesForLength(FRAMING_COMPACT, len);
+    const uint32_t extended = canframing::framesForLength(FRAMING_EXTENDED, len);
+    printf("%8u %10u %10u %10u %11.1f%% %11.1f%% %11.1f%%\n", len, legacy, compact, extended,
+           100.0 * len / (legacy * 8.0), 100.0 * len / (compact * 8.0), 100.0 * len / (extended * 8.0));
+  }
+
+  // Every length 1..65535: totals relative to legacy framing
+  uint64_t legacyTotal = 0, compactTotal = 0, extendedTotal = 0;
+  uint32_t worse = 0;
+  for (uint32_t len = 1; len <= canframing::MAX_MESSAGE_LEN; ++len) {
+    const uint32_t legacy = canframing::framesForLength(FRAMING_LEGACY, len);
+    const uint32_t compact = canframing::framesForLength(FRAMING_COMPACT, len);
+    const uint32_t extended = canframing::framesForLength(FRAMING_EXTENDED, len);
+    legacyTotal += legacy;
+    compactTotal += compact;
+    extendedTotal += extended;
+    if (compact > legacy || extended > compact) worse++;
+  }
+  printf("all lengths 1..65535 (legacy %llu frames):\n", (unsigned long long)legacyTotal);
+  printf("  compact  %llu frames, %.2f%% fewer, goodput +%.2f%%\n", (unsigned long long)compactTotal,
+         100.0 * (double)(legacyTotal - compactTotal) / legacyTotal, 100.0 * ((double)legacyTotal / compactTotal - 1.0));
+  printf("  extended %llu frames, %.2f%% fewer, goodput +%.2f%%\n", (unsigned long long)extendedTotal,
+         100.0 * (double)(legacyTotal - extendedTotal) / legacyTotal, 100.0 * ((double)legacyTotal / extendedTotal - 1.0));
+  printf("  lengths where a newer framing needs more frames: %u\n\n", worse);
+  return 0;
+}
+
+static double nsSince(std::chrono::steady_clock::time_point start, uint32_t n) {
+  const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  return (double)ns / n;
+}
+
+typedef LoopbackHal<16384> BenchHal; // holds a whole 65535-byte legacy message
+
+// Segment one message into the loopback HAL, then reassemble it. Returns the
+// number of frames, or 0 if the message didn't come back byte for byte.
+template <typename Reassembler>
+static uint32_t roundTrip(BenchHal &hal, CanSegmenter<BenchHal> &seg, Reassembler &rx,
+                          canframing::Framing f, const uint8_t *msg, uint16_t len) {
+  const uint32_t before = hal.sent;
+  if (!seg.send(0x01, f, msg, len)) return 0;
+  RxEvent ev;
+  bool ok = false;
+  while (rx.poll(ev)) {
+    if (ev.type == RxEvent::COMPLETE) ok = ev.received == len && memcmp(ev.data, msg, len) == 0;
+  }
+  return ok ? hal.sent - before : 0;
+}
+
+#if PROFILE
+static void printLine(const char *s) { printf("%s\n", s); }
+#endif
+
+static int benchTransport(int, char **) {
+  printf("== transport: segment + reassemble on the host (receiver 1, loopback HAL) ==\n");
+  printf("%8s %10s %8s %12s %12s\n", "len", "framing", "frames", "ns/message", "MB/s");
+  static BenchHal hal;
+  static CanSegmenter<BenchHal> seg(hal, 0x200, 16);
+  static CanReassembler<BenchHal, 4, 4, 65535> rx(hal, 0x200, 1);
+  static uint8_t msg[65535];
+  for (uint32_t i = 0; i < sizeof(msg); ++i) msg[i] = (uint8_t)(i * 131 + 7);
+
+  static const uint16_t lengths[] = {1, 5, 100, 2048, 4095, 65535};
+  static const canframing::Framing framings[] = {FRAMING_LEGACY, FRAMING_COMPACT, FRAMING_EXTENDED};
+  static const char *names[] = {"legacy", "compact", "extended"};
+  uint32_t failures = 0;
+  for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l) {
+    for (size_t k = 0; k < 3; ++k) {
+      const uint16_t len = lengths[l];
+      const uint32_t reps = 200000 / (len + 64) + 1;
+      uint32_t frames = 0;
+      auto t0 = std::chrono::steady_clock::now();
+      for (uint32_t r = 0; r < reps; ++r) {
+        frames = roundTrip(hal, seg, rx, framings[k], msg, len);
+        if (!frames) break;
+      }
+      const double ns = nsSince(t0, reps);
+      if (!frames) failures++;
+      printf("%8u %10s %8u %12.0f %12.1f%s\n", len, names[k], frames, ns, len * 1000.0 / ns, frames ? "" : "  MISMATCH");
+    }
+  }
+  const ReassemblyStats &st = rx.stats();
+  printf("sessions opened %u, completed %u, aborted %u; mismatches %u\n\n", st.opened, st.completed, st.aborted, failures);
+#if PROFILE
+  profiler::dump(printLine);
+  printf("\n");
+#endif
+  return 0;
+}
+
+static void printScenario(const char *label, const cansim::ScenarioResult &r) {
+  printf("%-28s %6.1f%% %9.0f %10.0f %9.2f %9.2f %6u %6u %9.0fx\n", label, 100.0 * r.utilization, r.framesPerSec,
+         r.goodputBps, r.p50Ns / 1e6, r.p99Ns / 1e6, r.lost, r.rxOverflows, r.speedup);
+}
+
+static int benchSim(int, char **) {
+  printf("== sim: 500 kbps bus, sender + receivers (lib/CanSim) ==\n");
+  printf("%-28s %7s %9s %10s %9s %9s %6s %6s %10s\n", "scenario", "bus", "frames/s", "goodput", "p50 ms",
+         "p99 ms", "lost", "ovf", "speed");
+  static uint8_t payload[65535];
+  for (uint32_t i = 0; i < sizeof(payload); ++i) payload[i] = (uint8_t)('a' + i % 26);
+
+  static const canframing::Framing framings[] = {FRAMING_LEGACY, FRAMING_COMPACT, FRAMING_EXTENDED};
+  static const char *names[] = {"legacy", "compact", "extended"};
+  char label[64];
+
+  // Saturated stream of 100-byte messages, about 10 s of bus time
+  for (size_t k = 0; k < 3; ++k) {
+    cansim::ScenarioConfig c = cansim::defaultScenario();
+    c.framing = framings[k];
+    c.messages = 3000;
+    snprintf(label, sizeof(label), "100B x%u %s", c.messages, names[k]);
+    printScenario(label, cansim::runScenario(c, payload));
+  }
+
+  // 10 messages/s (~20 KB/s, below bus capacity): latency without queueing
+  for (size_t k = 0; k < 3; ++k) {
+    cansim::ScenarioConfig c = cansim::defaultScenario();
+    c.framing = framings[k];
+    c.len = 2048;
+    c.messages = 100;
+    c.intervalUs = 100000;
+    snprintf(label, sizeof(label), "2048B @10/s %s", names[k]);
+    printScenario(label, cansim::runScenario(c, payload));
+  }
+
+  // Broadcast: goodput is per receiver, all five get the same bytes
+  {
+    cansim::ScenarioConfig c = cansim::defaultScenario();
+    c.receivers = 5;
+    c.len = 1024;
+    c.messages = 200;
+    c.targetMask = canframing::RECEIVER_MASK_ALL;
+    printScenario("1024B broadcast to 5", cansim::runScenario(c, payload));
+  }
+
+  // Receiver that needs 4 ms per frame (synchronous 115200 baud printing)
+  {
+    cansim::ScenarioConfig c = cansim::defaultScenario();
+    c.len = 200;
+    c.messages = 20;
+    c.serviceNs = 4000000;
+    printScenario("slow receiver, no gap", cansim::runScenario(c, payload));
+    c.minGapUs = 5000;
+    printScenario("slow receiver, 5 ms gap", cansim::runScenario(c, payload));
+  }
+  printf("\n");
+  return 0;
+}
+
+struct NullSink {
+  uint32_t chars;
+  void operator()(const char *line) { chars += (uint32_t)strlen(line); }
+};
+
+static int benchLog(int, char **) {
+  static asynclog::Logger<1024> log(0, 0);
+  printf("== log: AsyncLog record cost (ring %u, no rate limit) ==\n", (unsigned)log.capacity());
+  NullSink sink = {0};
+  const uint32_t rounds = 2000;
+  double writeNs = 0, drainNs = 0;
+  for (uint32_t r = 0; r < rounds; ++r) {
+    auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < 1000; ++i) {
+      log.write(LOG_LEVEL_DEBUG, "Added chunk seq=%u size=%u progress=%u/%u", i, 7, i * 7, 2048);
+    }
+    writeNs += nsSince(t0, 1000);
+    t0 = std::chrono::steady_clock::now();
+    const uint32_t n = log.drain(sink);
+    drainNs += nsSince(t0, n);
+  }
+  printf("  write (producer, per record): %8.1f ns\n", writeNs / rounds);
+  printf("  drain (format, per record):   %8.1f ns\n", drainNs / rounds);
+  printf("  records written %u, dropped %u\n\n", log.stats().written, log.stats().dropped);
+  return 0;
+}
+
+// Unicast 2 KB messages to a receiver that misses frames at random: without resume a
+// single missed frame loses the message; with it the sender resends from the gap
+static int benchLoss(int, char **) {
+  printf("== loss: goodput with random receive loss, drop-on-gap vs NACK/resume vs ACK window 8 (compact, 2048 B) ==\n");
+  printf("%-8s %-8s %9s %10s %9s %9s %7s %7s %7s %7s\n", "loss", "mode", "delivered", "goodput", "p50 ms",
+         "p99 ms", "missed", "nacks", "repairs", "unconf");
+  static uint8_t payload[2048];
+  for (uint32_t i = 0; i < sizeof(payload); ++i) payload[i] = (uint8_t)('a' + i % 26);
+  static const uint32_t lossPpm[] = {0, 1000, 10000};
+  static const char *lossNames[] = {"0", "0.1%", "1%"};
+  int status = 0;
+  static const char *modes[] = {"drop", "resume", "window"};
+  for (size_t l = 0; l < 3; ++l) {
+    double goodput[3] = {0, 0, 0};
+    for (int mode = 0; mode < 3; ++mode) {
+      cansim::ScenarioConfig c = cansim::defaultScenario();
+      c.len = sizeof(payload);
+      c.messages = 200;
+      c.rxLossPpm = lossPpm[l];
+      c.resumeWindowUs = mode == 1 ? 50000 : 0;
+      c.window = mode == 2 ? 8 : 0;
+      const cansim::ScenarioResult r = cansim::runScenario(c, payload);
+      goodput[mode] = r.goodputBps;
+      printf("%-8s %-8s %5u/%-3u %10.0f %9.2f %9.2f %7u %7u %7u %7u\n", lossNames[l], modes[mode], r.delivered,
+             c.messages, r.goodputBps, r.p50Ns / 1e6, r.p99Ns / 1e6, r.framesMissed, r.nacks, r.resumes + r.retransmits,
+             r.unconfirmed);
+      if (mode && r.delivered != c.messages) status = 1;
+    }
+    if (goodput[0] > 0) {
+      printf("%-8s resume/drop goodput x%.2f, window/drop x%.2f\n", "", goodput[1] / goodput[0], goodput[2] / goodput[0]);
+    }
+  }
+  printf("\n");
+  return status;
+}
+
+static int benchWindow(int, char **) {
+  printf("== window: sliding window with bitmap ACKs (2048 B unicast, RTO 20 ms) ==\n");
+  printf("%-9s %6s %4s %5s %9s %10s %9s %9s %7s %7s %7s\n", "framing", "window", "ack", "loss", "delivered",
+         "goodput", "rtt us", "rtt max", "acks", "resent", "rto");
+  static uint8_t payload[2048];
+  for (uint32_t i = 0; i < sizeof(payload); ++i) payload[i] = (uint8_t)('a' + i % 26);
+  struct Case {
+    canframing::Framing framing;
+    uint8_t window;
+    uint8_t ackEvery;
+  };
+  static const Case cases[] = {
+    {FRAMING_COMPACT, 0, 4},  {FRAMING_COMPACT, 2, 1},   {FRAMING_COMPACT, 4, 2},   {FRAMING_COMPACT, 8, 4},
+    {FRAMING_COMPACT, 8, 8},  {FRAMING_EXTENDED, 0, 4},  {FRAMING_EXTENDED, 8, 4},  {FRAMING_EXTENDED, 16, 8},
+    {FRAMING_EXTENDED, 32, 16},
+  };
+  static const uint32_t lossPpm[] = {0, 10000};
+  static const char *names[] = {"legacy", "compact", "extended"};
+  int status = 0;
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+    for (size_t l = 0; l < 2; ++l) {
+      cansim::ScenarioConfig c = cansim::defaultScenario();
+      c.framing = cases[i].framing;
+      c.len = sizeof(payload);
+      c.messages = 100;
+      c.rxLossPpm = lossPpm[l];
+      c.window = cases[i].window;
+      c.ackEvery = cases[i].ackEvery;
+      const cansim::ScenarioResult r = cansim::runScenario(c, payload);
+      printf("%-9s %6u %4u %5s %5u/%-3u %10.0f %9.0f %9u %7u %7u %7u\n", names[c.framing], c.window, c.ackEvery,
+             l ? "1%" : "0", r.delivered, c.messages, r.goodputBps, r.rttAvgUs, r.rttMaxUs, r.acks, r.retransmits,
+             r.timeouts);
+      if (c.window && r.delivered != c.messages) status = 1;
+    }
+  }
+  printf("window 0 = no ACKs (fire and forget); ack = receiver ACKs every n frames; compact windows stop at 8\n\n");
+  return status;
+}
+
+static uint32_t xorshift(uint32_t &s) {
+  s ^= s << 13;
+  s ^= s >> 17;
+  s ^= s << 5;
+  return s;
+}
+
+// Shuffle frames[1..n) within consecutive blocks of `block` frames
+static void shuffleBlocks(struct can_frame *frames, uint32_t n, uint16_t block, uint32_t &rng) {
+  for (uint32_t b = 1; b < n; b += block) {
+    const uint32_t end = b + block < n ? b + block : n;
+    for (uint32_t i = end - 1; i > b; --i) {
+      const uint32_t j = b + xorshift(rng) % (i - b + 1);
+      const struct can_frame tmp = frames[i];
+      frames[i] = frames[j];
+      frames[j] = tmp;
+    }
+  }
+}
+
+// Host cost of reassembling a message with its continuation frames shuffled in blocks as
+// wide as the wire sequence can place (the start frame stays first) against in order.
+// Correctness is checked by the native tests (test/test_reorder).
+static int benchReorder(int, char **) {
+  printf("== reorder: reassembly cost with continuation frames in random order (seeded) ==\n");
+  printf("%-9s %6s %6s %7s %12s %12s\n", "framing", "len", "block", "frames", "in order ns", "shuffled ns");
+  static BenchHal txHal, rxHal;
+  static CanSegmenter<BenchHal> seg(txHal, 0x200, 16);
+  static CanReassembler<BenchHal, 4, 4, 8192> rx(rxHal, 0x200, 1);
+  static uint8_t msg[8192];
+  for (uint32_t i = 0; i < sizeof(msg); ++i) msg[i] = (uint8_t)(i * 131 + 7);
+  static struct can_frame frames[sizeof(msg) / 6 + 2], order[sizeof(msg) / 6 + 2];
+  static const uint16_t lengths[] = {100, 2048, 4095};
+  static const canframing::Framing framings[] = {FRAMING_LEGACY, FRAMING_COMPACT, FRAMING_EXTENDED};
+  static const char *names[] = {"legacy", "compact", "extended"};
+  static const uint32_t TRIALS = 200;
+  uint32_t rng = 1;
+  for (size_t k = 0; k < 3; ++k) {
+    const canframing::Framing f = framings[k];
+    const uint16_t block = (uint16_t)(canframing::seqMask(f) / 2);
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l) {
+      const uint16_t len = lengths[l];
+      seg.send(0x01, f, msg, len);
+      uint32_t n = 0;
+      while (txHal.receiveFrame(order[n])) n++;
+      double ns[2] = {0, 0};
+      for (int shuffled = 0; shuffled < 2; ++shuffled) {
+        for (uint32_t t = 0; t < TRIALS; ++t) {
+          memcpy(frames, order, n * sizeof(frames[0]));
+          if (shuffled) shuffleBlocks(frames, n, block, rng);
+          RxEvent ev;
+          const auto start = std::chrono::steady_clock::now();
+          for (uint32_t i = 0; i < n; ++i) rx.onFrame(frames[i], ev);
+          ns[shuffled] += nsSince(start, n);
+        }
+      }
+      printf("%-9s %6u %6u %7u %12.1f %12.1f\n", names[k], len, block, n, ns[0] / TRIALS, ns[1] / TRIALS);
+    }
+  }
+  const ReassemblyStats &st = rx.stats();
+  printf("sessions opened %u, completed %u, aborted %u\n\n", st.opened, st.completed, st.aborted);
+  return 0;
+}
+
+// Sample corpora for the compression bench, generated so runs repeat: JSON telemetry
+// like the "stats" lines, log lines, CSV sensor rows, and random bytes
+static uint16_t corpusJson(uint8_t *out, uint16_t len, uint32_t seed) {
+  static const char *states[] = {"RUN", "IDLE", "FAULT"};
+  uint16_t n = 0;
+  for (uint32_t i = 0; n < len; ++i) {
+    char rec[160];
+    const int w = snprintf(rec, sizeof(rec),
+                           "{\"id\":%u,\"ts\":%u,\"temp\":%u.%02u,\"rpm\":%u,\"state\":\"%s\",\"fault\":%s}\n",
+                           (unsigned)(xorshift(seed) % 5 + 1), (unsigned)(1700000000 + i * 100),
+                           (unsigned)(20 + xorshift(seed) % 10), (unsigned)(xorshift(seed) % 100),
+                           (unsigned)(1500 + xorshift(seed) % 200), states[xorshift(seed) % 3],
+                           xorshift(seed) % 8 ? "false" : "true");
+    for (int k = 0; k < w && n < len; ++k) out[n++] = (uint8_t)rec[k];
+  }
+  return n;
+}
+
+static uint16_t corpusLog(uint8_t *out, uint16_t len, uint32_t seed) {
+  static const char *msgs[] = {"rx frame ok", "session opened", "ACK sent", "message complete", "TX buffer busy"};
+  uint16_t n = 0;
+  for (uint32_t i = 0; n < len; ++i) {
+    char rec[96];
+    const int w = snprintf(rec, sizeof(rec), "I (%u) can: id=0x%03X len=%u %s\n", (unsigned)(i * 1375 + xorshift(seed) % 50),
+                           (unsigned)(0x200 + xorshift(seed) % 6), (unsigned)(xorshift(seed) % 9),
+                           msgs[xorshift(seed) % 5]);
+    for (int k = 0; k < w && n < len; ++k) out[n++] = (uint8_t)rec[k];
+  }
+  return n;
+}
+
+static uint16_t corpusCsv(uint8_t *out, uint16_t len, uint32_t seed) {
+  uint16_t n = 0;
+  for (uint32_t i = 0; n < len; ++i) {
+    char rec[64];
+    const int w = snprintf(rec, sizeof(rec), "%u,%u.%u,%u.%u,%u,OK\n", (unsigned)i, (unsigned)(12 + xorshift(seed) % 3),
+                           (unsigned)(xorshift(seed) % 10), (unsigned)(45 + xorshift(seed) % 2),
+                           (unsigned)(xorshift(seed) % 10), (unsigned)(xorshift(seed) % 4096));
+    for (int k = 0; k < w && n < len; ++k) out[n++] = (uint8_t)rec[k];
+  }
+  return n;
+}
+
+static uint16_t corpusRandom(uint8_t *out, uint16_t len, uint32_t seed) {
+  for (uint16_t i = 0; i < len; ++i) out[i] = (uint8_t)xorshift(seed);
+  return len;
+}
+
+// Short messages coded against the compiled-in dictionary (what the sender's compressBest()
+// picks), through a receiver that has it and one that doesn't
+static bool benchDictionary(lzss::LzssEncoder &enc, CanSegmenter<BenchHal> &seg, BenchHal &txHal,
+                            struct can_frame *frames) {
+  static const char *corpusPath = "bench/corpus/messages.txt";
+  static BenchHal rxHal;
+  static CanReassembler<BenchHal, 4, 4, 2048> rx(rxHal, 0x200, 1), bare(rxHal, 0x200, 1);
+  rx.setDictionary(&MESSAGE_DICT);
+  printf("== compress: short messages, dictionary 0x%02X (%u bytes), compact ==\n", MESSAGE_DICT_ID, MESSAGE_DICT.len);
+  FILE *fp = fopen(corpusPath, "r");
+  if (!fp) {
+    printf("cannot read %s\n\n", corpusPath);
+    return false;
+  }
+  char line[512];
+  uint8_t wire[512];
+  uint32_t messages = 0, bytes = 0, wireBytes = 0, dictUsed = 0, failures = 0, refused = 0;
+  uint32_t rawFrames = 0, lzssFrames = 0, sentFrames = 0;
+  double encNs = 0;
+  while (fgets(line, sizeof(line), fp)) {
+    uint16_t len = (uint16_t)strlen(line);
+    while (len && (line[len - 1] == '\n' || line[len - 1] == '\r')) len--;
+    if (!len) continue;
+    const uint8_t *plain = (const uint8_t *)line;
+    const uint16_t plainOnly = enc.compress(plain, len, wire, sizeof(wire));
+    auto t0 = std::chrono::steady_clock::now();
+    uint16_t n = enc.compressBest(plain, len, wire, sizeof(wire), &MESSAGE_DICT, 2048);
+    encNs += nsSince(t0, 1) / len;
+    const bool dict = n && lzss::isDictionaryStream(wire);
+    messages++;
+    bytes += len;
+    wireBytes += n ? n : len;
+    dictUsed += dict;
+    rawFrames += canframing::framesForLength(FRAMING_COMPACT, len);
+    lzssFrames += canframing::framesForLength(FRAMING_COMPACT, plainOnly ? plainOnly : len);
+    sentFrames += canframing::framesForLength(FRAMING_COMPACT, n ? n : len);
+    if (!n) continue;
+    seg.send(0x01, FRAMING_COMPACT, wire, n, canframing::START_FLAG_COMPRESSED);
+    uint32_t count = 0;
+    while (txHal.receiveFrame(frames[count])) count++;
+    RxEvent ev;
+    bool complete = false;
+    for (uint32_t i = 0; i < count; ++i) {
+      rx.onFrame(frames[i], ev);
+      if (ev.type == RxEvent::COMPLETE) complete = ev.received == len && memcmp(ev.data, plain, len) == 0;
+    }
+    failures += !complete;
+    if (!dict) continue;
+    bare.onFrame(frames[0], ev);
+    refused += ev.type == RxEvent::ERROR && ev.error == RxEvent::ERR_DICTIONARY && ev.seq == MESSAGE_DICT_ID;
+    for (uint32_t i = 1; i < count; ++i) bare.onFrame(frames[i], ev); // stray continuations
+  }
+  fclose(fp);
+  if (!messages) {
+    printf("no messages in %s\n\n", corpusPath);
+    return false;
+  }
+  const bool ok = failures == 0 && refused == dictUsed;
+  printf("%u messages, %.1f bytes on average, %.1f on the wire (x%.2f), %u dictionary-coded, encode %.0f ns/B\n",
+         messages, (double)bytes / messages, (double)wireBytes / messages, (double)bytes / wireBytes, dictUsed,
+         encNs / messages);
+  printf("frames per message: raw %.2f, LZSS %.2f, sent %.2f (%.1f%% fewer); round trip %s, refused without "
+         "dictionary %u/%u\n\n",
+         (double)rawFrames / messages, (double)lzssFrames / messages, (double)sentFrames / messages,
+         100.0 * (rawFrames - sentFrames) / rawFrames, failures ? "FAIL" : "ok", refused, dictUsed);
+  return ok;
+}
+
+// Compressed vs raw messages per corpus: ratio, host codec cost, a byte-exact round
+// trip through a 2 KB receiver buffer (in order and shuffled) and net goodput in the
+// simulator with the default sender settings (compact, window 8)
+static int benchCompress(int, char **) {
+  printf("== compress: LZSS payload compression (window %u, compact, ACK window 8) ==\n", lzss::WINDOW);
+  printf("%-7s %5s %5s %6s %8s %8s %6s %10s %10s %6s\n", "corpus", "len", "wire", "ratio", "enc ns/B", "dec ns/B",
+         "check", "raw B/s", "net B/s", "gain");
+  struct Corpus {
+    const char *name;
+    uint16_t (*make)(uint8_t *, uint16_t, uint32_t);
+  };
+  static const Corpus corpora[] = {{"json", corpusJson}, {"log", corpusLog}, {"csv", corpusCsv}, {"random", corpusRandom}};
+  static const uint16_t lengths[] = {64, 256, 1536};
+  static uint8_t plain[2048], wire[2048], out[2048];
+  static struct can_frame frames[2048 / 6 + 2];
+  static lzss::LzssEncoder enc;
+  static BenchHal txHal, rxHal;
+  static CanSegmenter<BenchHal> seg(txHal, 0x200, 16);
+  static CanReassembler<BenchHal, 4, 4, 2048> rx(rxHal, 0x200, 1);
+  uint32_t rng = 7;
+  int status = 0;
+  for (size_t c = 0; c < sizeof(corpora) / sizeof(corpora[0]); ++c) {
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l) {
+      const uint16_t len = corpora[c].make(plain, lengths[l], 1234 + (uint32_t)l);
+      const uint32_t reps = 200000 / (len + 64) + 1;
+      uint16_t n = 0;
+      auto t0 = std::chrono::steady_clock::now();
+      for (uint32_t r = 0; r < reps; ++r) n = enc.compress(plain, len, wire, sizeof(wire));
+      const double encNs = nsSince(t0, reps) / len;
+      const bool packed = n && lzss::fitsInPlace(len, n, sizeof(out));
+      double decNs = 0;
+      bool ok = true;
+      if (packed) {
+        t0 = std::chrono::steady_clock::now();
+        for (uint32_t r = 0; r < reps; ++r) {
+          uint32_t bit = lzss::HEADER_LEN * 8;
+          uint16_t pos = 0;
+          ok &= lzss::decode(wire, n, bit, out, pos, len, len) == lzss::DECODE_DONE;
+        }
+        decNs = nsSince(t0, reps) / len;
+        ok &= memcmp(out, plain, len) == 0;
+        // Through the reassembler, decompressing in place, frames in order then shuffled
+        for (int shuffled = 0; shuffled < 2 && ok; ++shuffled) {
+          seg.send(0x01, FRAMING_COMPACT, wire, n, canframing::START_FLAG_COMPRESSED);
+          uint32_t count = 0;
+          while (txHal.receiveFrame(frames[count])) count++;
+          if (shuffled) shuffleBlocks(frames, count, canframing::seqMask(FRAMING_COMPACT) / 2, rng);
+          RxEvent ev;
+          bool complete = false;
+          for (uint32_t i = 0; i < count; ++i) {
+            rx.onFrame(frames[i], ev);
+            if (ev.type == RxEvent::ERROR) ok = false;
+            if (ev.type == RxEvent::COMPLETE) {
+              complete = ev.received == len && ev.wire == n && memcmp(ev.data, plain, len) == 0;
+            }
+          }
+          ok &= complete;
+        }
+      }
+      cansim::ScenarioConfig cfg = cansim::defaultScenario();
+      cfg.len = len;
+      cfg.messages = 50;
+      cfg.window = 8;
+      const cansim::ScenarioResult raw = cansim::runScenario(cfg, plain);
+      cansim::ScenarioResult net = raw;
+      if (packed) {
+        cfg.len = n;
+        cfg.payloadFlags = canframing::START_FLAG_COMPRESSED;
+        net = cansim::runScenario(cfg, wire);
+      }
+      if (!ok || raw.delivered != cfg.messages || net.delivered != cfg.messages) status = 1;
+      printf("%-7s %5u %5u %5.2fx %8.1f %8.1f %6s %10.0f %10.0f %5.2fx\n", corpora[c].name, len, packed ? n : len,
+             packed ? (double)len / n : 1.0, encNs, decNs, !packed ? "raw" : ok ? "ok" : "FAIL", raw.goodputBps,
+             net.goodputBps, net.goodputBps / raw.goodputBps);
+    }
+  }
+  printf("raw = didn't shrink, sent uncompressed; goodput counts decompressed bytes\n\n");
+  return benchDictionary(enc, seg, txHal, frames) ? status : 1;
+}
+
+// Timestamp counter ticks, for cycles per byte; 0 where there is none
+static uint64_t cycleCount() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+// Frames of one message as a sender produces them
+static uint32_t collectFrames(CanSegmenter<BenchHal> &seg, canframing::Framing f, const uint8_t *msg, uint16_t len,
+                              struct can_frame *out, uint8_t payloadFlags = 0, uint8_t fecGroup = 0) {
+  seg.start(0x01, f, msg, len, payloadFlags, fecGroup);
+  uint32_t n = 0;
+  while (seg.next(out[n])) n++;
+  return n;
+}
+
+static int benchCrc(int, char **) {
+  printf("== crc: CRC-32 trailer (lib/Crc32, host update() = slice-by-8) ==\n");
+  static uint8_t buf[65535];
+  for (uint32_t i = 0; i < sizeof(buf); ++i) buf[i] = (uint8_t)(i * 131 + 7);
+  int status = 0;
+
+  const uint8_t *check = (const uint8_t *)"123456789";
+  bool ok = crc32::updateBytewise(0, check, 9) == crc32::CHECK && crc32::updateSlice8(0, check, 9) == crc32::CHECK;
+  const uint32_t whole = crc32::updateBytewise(0, buf, 4096);
+  for (uint32_t split = 0; split <= 4096; split += 13) {
+    ok &= crc32::update(crc32::updateBytewise(0, buf, split), buf + split, 4096 - split) == whole;
+  }
+  printf("check value and piecewise folding: %s\n", ok ? "ok" : "FAIL");
+  if (!ok) status = 1;
+
+  printf("%8s %12s %12s %14s %14s\n", "len", "slice8 ns/B", "slice8 cyc/B", "bytewise ns/B", "bytewise cyc/B");
+  static const uint32_t lengths[] = {8, 64, 1536, 65535};
+  for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l) {
+    const uint32_t len = lengths[l];
+    const uint32_t reps = 20000000 / (len + 64) + 1;
+    volatile uint32_t sink = 0;
+    uint64_t c0 = cycleCount();
+    auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < reps; ++r) sink = crc32::updateSlice8(sink, buf, len);
+    const double sliceNs = nsSince(t0, reps) / len;
+    const double sliceCyc = (double)(cycleCount() - c0) / reps / len;
+    c0 = cycleCount();
+    t0 = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < reps; ++r) sink = crc32::updateBytewise(sink, buf, len);
+    const double byteNs = nsSince(t0, reps) / len;
+    const double byteCyc = (double)(cycleCount() - c0) / reps / len;
+    printf("%8u %12.2f %12.2f %14.2f %14.2f\n", len, sliceNs, sliceCyc, byteNs, byteCyc);
+  }
+  printf("cycles are timestamp-counter ticks (0 off x86); on the ESP32 the sender's \"crc\" command\n"
+         "measures the ROM's crc32_le() the same way\n");
+
+  // Host round trip of 2 KB compact messages with and without the trailer
+  static BenchHal hal;
+  static CanSegmenter<BenchHal> seg(hal, 0x200, 16);
+  static CanReassembler<BenchHal, 4, 4, 8192> rx(hal, 0x200, 1);
+  double ns[2] = {0, 0};
+  for (int on = 0; on < 2; ++on) {
+    seg.setChecksum(on != 0);
+    const uint32_t reps = 2000;
+    auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < reps; ++r) {
+      if (!roundTrip(hal, seg, rx, FRAMING_COMPACT, buf, 2048)) status = 1;
+    }
+    ns[on] = nsSince(t0, reps);
+  }
+  printf("round trip, 2048 B compact: %.0f ns without, %.0f ns with the trailer (%+.1f%%)\n", ns[0], ns[1],
+         100.0 * (ns[1] - ns[0]) / ns[0]);
+
+  // Every framing, plain and compressed, must come back byte for byte with the trailer
+  static const canframing::Framing framings[] = {FRAMING_LEGACY, FRAMING_COMPACT, FRAMING_EXTENDED};
+  static const char *names[] = {"legacy", "compact", "extended"};
+  static const uint16_t sizes[] = {1, 4, 5, 100, 2048, 8000};
+  static lzss::LzssEncoder enc;
+  static uint8_t text[1536], packed[1536];
+  const uint16_t textLen = corpusJson(text, sizeof(text), 99);
+  const uint16_t packedLen = enc.compress(text, textLen, packed, sizeof(packed));
+  uint32_t failures = 0;
+  seg.setChecksum(true);
+  for (size_t k = 0; k < 3; ++k) {
+    for (size_t l = 0; l < sizeof(sizes) / sizeof(sizes[0]); ++l) {
+      if (!roundTrip(hal, seg, rx, framings[k], buf, sizes[l])) failures++;
+    }
+    seg.send(0x01, framings[k], packed, packedLen, canframing::START_FLAG_COMPRESSED);
+    RxEvent ev;
+    bool complete = false;
+    while (rx.poll(ev)) {
+      if (ev.type == RxEvent::COMPLETE) complete = ev.received == textLen && memcmp(ev.data, text, textLen) == 0;
+    }
+    if (!complete) failures++;
+  }
+  printf("round trips with the trailer (every framing, 1..8000 B and compressed): %u failures\n", failures);
+  if (failures) status = 1;
+
+  // A sender restarts mid-message (its message ids start over) and a frame of the old
+  // transfer turns up among the new one's: the byte count still matches
+  static uint8_t other[2048];
+  for (uint32_t i = 0; i < sizeof(other); ++i) other[i] = (uint8_t)(i * 17 + 1);
+  static struct can_frame oldFrames[8192 / 6 + 2], newFrames[8192 / 6 + 2];
+  printf("%-9s %-16s %-16s\n", "framing", "without trailer", "with trailer");
+  for (size_t k = 0; k < 3; ++k) {
+    const char *outcome[2];
+    for (int on = 0; on < 2; ++on) {
+      CanSegmenter<BenchHal> before(hal, 0x200, 16), after(hal, 0x200, 16);
+      before.setChecksum(on != 0);
+      after.setChecksum(on != 0);
+      collectFrames(before, framings[k], other, 600, oldFrames);
+      const uint32_t n = collectFrames(after, framings[k], buf, 600, newFrames);
+      newFrames[n / 2] = oldFrames[n / 2];
+      RxEvent ev;
+      outcome[on] = "lost";
+      for (uint32_t i = 0; i < n; ++i) {
+        rx.onFrame(newFrames[i], ev);
+        if (ev.type == RxEvent::COMPLETE) outcome[on] = memcmp(ev.data, buf, 600) ? "delivered CORRUPT" : "delivered";
+        if (ev.type == RxEvent::ERROR && ev.error == RxEvent::ERR_CRC) outcome[on] = "dropped (CRC)";
+      }
+    }
+    printf("%-9s %-16s %-16s\n", names[k], outcome[0], outcome[1]);
+    if (strcmp(outcome[1], "dropped (CRC)") != 0) status = 1;
+  }
+
+  // What the 4 bytes cost on the bus (compact, ACK window 8)
+  printf("%-24s %12s %12s\n", "simulated goodput", "without", "with trailer");
+  static const uint16_t simLengths[] = {10, 100, 2048};
+  for (size_t l = 0; l < sizeof(simLengths) / sizeof(simLengths[0]); ++l) {
+    cansim::ScenarioConfig cfg = cansim::defaultScenario();
+    cfg.len = simLengths[l];
+    cfg.messages = 50;
+    cfg.window = 8;
+    const cansim::ScenarioResult plain = cansim::runScenario(cfg, buf);
+    cfg.crc = true;
+    const cansim::ScenarioResult checked = cansim::runScenario(cfg, buf);
+    if (checked.delivered != cfg.messages) status = 1;
+    char label[32];
+    snprintf(label, sizeof(label), "%u B messages", simLengths[l]);
+    printf("%-24s %10.0f B/s %10.0f B/s (%+.1f%%)\n", label, plain.goodputBps, checked.goodputBps,
+           100.0 * (checked.goodputBps - plain.goodputBps) / plain.goodputBps);
+  }
+  printf("\n");
+  return status;
+}
+
+// Feed frames[0..n) to `rx`, skipping those `drop` selects; what became of the message
+// (the first error counts: the frames after it only find no session)
+template <typename Reassembler, typename Drop>
+static const char *deliver(Reassembler &rx, const struct can_frame *frames, uint32_t n, Drop drop, const uint8_t *msg,
+                           uint16_t len) {
+  const char *outcome = "lost";
+  RxEvent ev;
+  for (uint32_t i = 0; i < n; ++i) {
+    if (drop(i)) continue;
+    rx.onFrame(frames[i], ev);
+    if (ev.type == RxEvent::COMPLETE) outcome = ev.received == len && memcmp(ev.data, msg, len) == 0 ? "ok" : "CORRUPT";
+    if (ev.type == RxEvent::ERROR && strcmp(outcome, "lost") == 0) outcome = ev.error == RxEvent::ERR_FEC ? "dropped (FEC)" : "error";
+  }
+  return outcome;
+}
+
+static bool isParity(const struct can_frame &frm) {
+  canframing::Framing f;
+  return canframing::classify(frm, f) == canframing::KIND_PARITY;
+}
+
+static int benchFec(int argc, char **argv) {
+  printf("== fec: XOR parity per group of K frames ==\n");
+  static uint8_t buf[8000];
+  for (uint32_t i = 0; i < sizeof(buf); ++i) buf[i] = (uint8_t)(i * 131 + 7);
+  int status = 0;
+
+  // One frame lost in every group is rebuilt, in every framing, plain, compressed and with
+  // the trailer; two in a group drop the message
+  static BenchHal hal;
+  static CanSegmenter<BenchHal> seg(hal, 0x200, 16);
+  static CanReassembler<BenchHal, 4, 4, 8192> rx(hal, 0x200, 1);
+  static lzss::LzssEncoder enc;
+  static uint8_t text[1536], packed[1536];
+  const uint16_t textLen = corpusJson(text, sizeof(text), 7);
+  const uint16_t packedLen = enc.compress(text, textLen, packed, sizeof(packed));
+  static const canframing::Framing framings[] = {FRAMING_LEGACY, FRAMING_COMPACT, FRAMING_EXTENDED};
+  static const char *names[] = {"legacy", "compact", "extended"};
+  static const uint8_t groups[] = {4, 8, 16, 32};
+  static struct can_frame frames[8192 / 6 * 2 + 4];
+  uint32_t failures = 0, rebuiltBefore = rx.resumeStats().rebuilt;
+  for (size_t k = 0; k < 3; ++k) {
+    for (size_t g = 0; g < sizeof(groups) / sizeof(groups[0]); ++g) {
+      const uint8_t K = groups[g];
+      for (int crc = 0; crc < 2; ++crc) {
+        seg.setChecksum(crc != 0);
+        // A different frame of each group goes missing: data frame 1 + j * (K + 1) + j % K
+        // (every group is K data frames and its parity frame after the start frame)
+        uint32_t n = collectFrames(seg, framings[k], buf, 2000, frames, 0, K);
+        const char *a = deliver(rx, frames, n, [&](uint32_t i) {
+          if (i == 0) return false;
+          const uint32_t j = (i - 1) / (K + 1u);
+          return (i - 1) % (K + 1u) == j % K;
+        }, buf, 2000);
+        // Parity frames lost instead: nothing to rebuild
+        const char *b = deliver(rx, frames, n, [&](uint32_t i) { return isParity(frames[i]); }, buf, 2000);
+        n = collectFrames(seg, framings[k], packed, packedLen, frames, canframing::START_FLAG_COMPRESSED, K);
+        uint8_t plain[1536];
+        memcpy(plain, text, textLen);
+        const char *c = deliver(rx, frames, n, [&](uint32_t i) { return i == 2; }, plain, textLen);
+        if (strcmp(a, "ok") || strcmp(b, "ok") || strcmp(c, "ok")) {
+          printf("  %s K=%u crc=%d: one per group %s, parity lost %s, compressed %s\n", names[k], K, crc, a, b, c);
+          failures++;
+        }
+      }
+      seg.setChecksum(false);
+      const uint32_t n = collectFrames(seg, framings[k], buf, 2000, frames, 0, K);
+      const char *twice = deliver(rx, frames, n, [&](uint32_t i) { return i == 1 || i == 2; }, buf, 2000);
+      if (strcmp(twice, "dropped (FEC)") != 0) {
+        printf("  %s K=%u: two lost in a group %s\n", names[k], K, twice);
+        failures++;
+      }
+    }
+  }
+  printf("rebuilds (every framing, K=4..32, plain/compressed, with and without CRC): %u failures, %u frames rebuilt\n",
+         failures, rx.resumeStats().rebuilt - rebuiltBefore);
+  if (failures) status = 1;
+
+  // Goodput vs loss on the simulated bus: unicast 2 KB compact messages, dropped on a
+  // gap the parity can't fill
+  FILE *csv = nullptr;
+  if (argc > 0) {
+    csv = fopen(argv[0], "w");
+    if (!csv) {
+      fprintf(stderr, "cannot write %s\n", argv[0]);
+      return 1;
+    }
+    fprintf(csv, "loss_ppm,k,delivered,messages,goodput_bps,rebuilt,frames\n");
+  }
+  static const uint32_t lossPpm[] = {0, 1000, 5000, 10000, 20000, 50000};
+  static const char *lossNames[] = {"0", "0.1%", "0.5%", "1%", "2%", "5%"};
+  static const uint8_t ks[] = {0, 4, 8, 16};
+  printf("goodput, B/s (delivered of 100), compact 2048 B:\n%-6s", "loss");
+  for (size_t k = 0; k < 4; ++k) {
+    char label[16];
+    snprintf(label, sizeof(label), ks[k] ? "K=%u" : "no FEC", ks[k]);
+    printf(" %18s", label);
+  }
+  printf("\n");
+  for (size_t l = 0; l < sizeof(lossPpm) / sizeof(lossPpm[0]); ++l) {
+    printf("%-6s", lossNames[l]);
+    for (size_t k = 0; k < 4; ++k) {
+      cansim::ScenarioConfig c = cansim::defaultScenario();
+      c.len = 2048;
+      c.messages = 100;
+      c.rxLossPpm = lossPpm[l];
+      c.fecGroup = ks[k];
+      const cansim::ScenarioResult r = cansim::runScenario(c, buf);
+      printf(" %10.0f (%3u)  ", r.goodputBps, r.delivered);
+      if (csv) {
+        fprintf(csv, "%u,%u,%u,%u,%.0f,%u,%llu\n", lossPpm[l], ks[k], r.delivered, c.messages, r.goodputBps, r.rebuilt,
+                (unsigned long long)r.frames);
+      }
+      if (lossPpm[l] == 0 && r.delivered != c.messages) status = 1;
+    }
+    printf("\n");
+  }
+  if (csv) {
+    fclose(csv);
+    printf("wrote %s\n", argv[0]);
+  }
+  printf("parity costs 1/K more frames; without FEC a 2 KB message is lost to any missed frame\n\n");
+  return status;
+}
+
+// One 2 KB bulk message to receiver 1 at t=0 and `n` one-frame urgent messages to it
+// spread over the transfer, urgent in class `urgent` and bulk in class `bulk`
+struct PrioRun {
+  std::vector<uint64_t> urgentNs; // submission -> complete
+  uint64_t bulkNs;                // the bulk message, submission -> complete
+  uint32_t delivered;
+};
+
+static PrioRun runPrio(canframing::Framing f, uint8_t urgent, uint8_t bulk, const uint8_t *data, uint16_t bulkLen,
+                       uint16_t urgentLen, uint32_t n, uint32_t firstUs, uint32_t everyUs) {
+  cansim::Bus bus;
+  cansim::SenderNode sender(0x200, 16);
+  cansim::ReceiverNode<> rx(0x200, 1);
+  bus.attach(sender);
+  bus.attach(rx);
+  sender.submit(0x01, f, data, bulkLen, 0, 0, 0, bulk);
+  for (uint32_t i = 0; i < n; ++i) {
+    sender.submit(0x01, f, data, urgentLen, (uint64_t)(firstUs + i * everyUs) * 1000, 0, 0, urgent);
+  }
+  uint64_t horizon = 0;
+  while (rx.completions().size() < n + 1 && bus.run(horizon += 100000000ULL)) {}
+
+  PrioRun r;
+  r.delivered = (uint32_t)rx.completions().size();
+  r.bulkNs = 0;
+  for (size_t i = 0; i < rx.completions().size(); ++i) {
+    if (rx.completions()[i].len == bulkLen) r.bulkNs = rx.completions()[i].atNs;
+  }
+  std::vector<uint64_t> lat;
+  cansim::latencies(sender, rx, 1, lat, false, urgent);
+  // Same class as the bulk message: it is first in the match, drop it
+  if (urgent == bulk && !lat.empty()) lat.erase(lat.begin());
+  r.urgentNs = lat;
+  return r;
+}
+
+static int benchPrio(int, char **) {
+  printf("== prio: 1-frame urgent messages during a 2 KB transfer (500 kbps) ==\n");
+  static uint8_t data[2048];
+  for (uint32_t i = 0; i < sizeof(data); ++i) data[i] = (uint8_t)(i * 131 + 7);
+  static const canframing::Framing framings[] = {FRAMING_LEGACY, FRAMING_COMPACT, FRAMING_EXTENDED};
+  static const char *names[] = {"legacy", "compact", "extended"};
+  const uint32_t n = 40, firstUs = 700, everyUs = 1370; // staggered against the frame times
+  int status = 0;
+  printf("%-10s %-22s %9s %9s %9s %10s\n", "framing", "scheduling", "p50 us", "max us", "frames", "bulk ms");
+  for (size_t k = 0; k < 3; ++k) {
+    const uint16_t urgentLen = (uint16_t)canframing::startPayloadMax(framings[k]);
+    // Worst case stuffed 8-byte data frame, 11- or 29-bit ID, including the interframe space
+    const double frameUs = (framings[k] == FRAMING_EXTENDED ? 160 : 135) * 1e6 / cansim::BITRATE_DEFAULT;
+    for (int preempt = 1; preempt >= 0; --preempt) {
+      const uint8_t urgent = preempt ? canframing::PRIO_URGENT : canframing::PRIO_NORMAL;
+      const uint8_t bulk = preempt ? canframing::PRIO_BULK : canframing::PRIO_NORMAL;
+      const PrioRun r = runPrio(framings[k], urgent, bulk, data, sizeof(data), urgentLen, n, firstUs, everyUs);
+      const double maxUs = r.urgentNs.empty() ? 0 : *std::max_element(r.urgentNs.begin(), r.urgentNs.end()) / 1e3;
+      printf("%-10s %-22s %9.0f %9.0f %9.1f %10.2f\n", names[k], preempt ? "urgent preempts bulk" : "one class (FIFO)",
+             cansim::percentile(r.urgentNs, 0.50) / 1e3, maxUs, maxUs / frameUs, r.bulkNs / 1e6);
+      if (r.delivered != n + 1 || r.urgentNs.size() != n) {
+        printf("  %s: delivered %u of %u\n", names[k], r.delivered, n + 1);
+        status = 1;
+      }
+      // The frame on the bus, the three already in TX buffers, then ours
+      if (preempt && maxUs > 5 * frameUs) {
+        printf("  %s: urgent worst case %.0f us is over 5 frame times (%.0f us)\n", names[k], maxUs, 5 * frameUs);
+        status = 1;
+      }
+    }
+  }
+  printf("frames = worst case in worst-case 8-byte frame times; a preempting urgent message waits\n"
+         "for the frame on the bus and the TX buffers already loaded (MCP2515 sends in load order)\n\n");
+  return status;
+}
+
+// Frames from real transport traffic (compact, extended and an RTR), with bus-like
+// timestamps including gaps long enough to need 4- and 5-byte deltas
+static int benchCapture(int argc, char **argv) {
+  static CaptureRing<8192> ring;
+  printf("== capture: CaptureRing<%u> push cost and decode check ==\n", (unsigned)ring.capacity());
+  static BenchHal hal;
+  static CanSegmenter<BenchHal> seg(hal, 0x200, 16);
+  static uint8_t msg[1000];
+  for (uint32_t i = 0; i < sizeof(msg); ++i) msg[i] = (uint8_t)(i * 131 + 7);
+  seg.send(0x01, FRAMING_COMPACT, msg, sizeof(msg));
+  seg.send(0x15, FRAMING_EXTENDED, msg, sizeof(msg));
+  static std::vector<can_frame> frames;
+  frames.clear();
+  struct can_frame frm;
+  while (hal.receiveFrame(frm)) frames.push_back(frm);
+  memset(&frm, 0, sizeof(frm));
+  frm.can_id = 0x7DF | CAN_RTR_FLAG;
+  frm.can_dlc = 8;
+  frames.push_back(frm);
+
+  // Reference timestamps for the last frames pushed, to check what the ring kept
+  const uint32_t total = 200000;
+  static std::vector<uint64_t> stamps;
+  stamps.assign(total, 0);
+  uint64_t t = 0xFFFF0000ULL; // start just before the 32-bit clock wraps
+  auto t0 = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < total; ++i) {
+    t += (i % 1000 == 999) ? 300000000 : 230 + (i % 17); // 300 s gaps: 5-byte deltas, many wraps
+    stamps[i] = t;
+    ring.push((uint32_t)t, frames[i % frames.size()]);
+  }
+  const double pushNs = nsSince(t0, total);
+
+  // The ring's timestamps restart from the 32-bit clock, so compare offsets from the oldest
+  ring.freeze();
+  const uint32_t oldest = total - ring.count();
+  uint32_t index = oldest, mismatches = 0;
+  uint64_t firstTs = 0;
+  ring.forEach([&](uint64_t ts, const can_frame &got) {
+    const can_frame &want = frames[index % frames.size()];
+    const bool rtr = (want.can_id & CAN_RTR_FLAG) != 0;
+    if (index == oldest) firstTs = ts;
+    if (ts - firstTs != stamps[index] - stamps[oldest] || got.can_id != want.can_id ||
+        got.can_dlc != want.can_dlc || (!rtr && memcmp(got.data, want.data, want.can_dlc) != 0)) {
+      mismatches++;
+    }
+    index++;
+  });
+  const CaptureStats &st = ring.stats();
+  printf("  push: %.1f ns/frame; %u frames held in %u bytes (%.1f B/frame)\n", pushNs, ring.count(), ring.bytesUsed(),
+         (double)ring.bytesUsed() / ring.count());
+  printf("  captured %u, overwritten %u, skipped %u; decode mismatches %u\n", st.captured, st.overwritten, st.skipped,
+         mismatches);
+
+  char line[64];
+  uint32_t shown = 0;
+  ring.forEach([&](uint64_t ts, const can_frame &f) {
+    if (shown++ < 3 && capture::candumpLine(line, sizeof(line), ts, f) > 0) printf("  %s\n", line);
+  });
+  if (argc > 0) {
+    FILE *out = fopen(argv[0], "wb");
+    if (!out) {
+      fprintf(stderr, "cannot write %s\n", argv[0]);
+      ring.thaw();
+      return 1;
+    }
+    uint8_t header[capture::PCAP_GLOBAL_HEADER_LEN];
+    capture::pcapGlobalHeader(header);
+    fwrite(header, 1, sizeof(header), out);
+    ring.forEach([&](uint64_t ts, const can_frame &f) {
+      uint8_t rec[capture::PCAP_RECORD_LEN];
+      capture::pcapRecord(rec, ts, f);
+      fwrite(rec, 1, sizeof(rec), out);
+    });
+    fclose(out);
+    printf("  wrote %u frames to %s\n", ring.count(), argv[0]);
+  }
+  ring.thaw();
+  printf("\n");
+  return mismatches ? 1 : 0;
+}
+
+// A saturated 500 kbps bus: transport traffic back to back, plus a 10 ms periodic ID
+// whose arrivals wobble by +-50 us, fed through the sniffer's per-frame work
+static int benchSniffer(int, char **) {
+  printf("== sniffer: per-frame cost of IdStatsTable + BusLoad + frameBits at 100%% load ==\n");
+  static BenchHal hal;
+  static CanSegmenter<BenchHal> seg(hal, 0x200, 16);
+  static uint8_t msg[4000];
+  for (uint32_t i = 0; i < sizeof(msg); ++i) msg[i] = (uint8_t)(i * 131 + 7);
+  static std::vector<can_frame> frames;
+  frames.clear();
+  struct can_frame frm;
+  for (uint8_t target = 1; target <= 0x1F; target <<= 1) {
+    seg.send(target, target & 1 ? FRAMING_EXTENDED : FRAMING_COMPACT, msg, sizeof(msg));
+    while (hal.receiveFrame(frm)) frames.push_back(frm);
+  }
+
+  static IdStatsTable<256> ids(0x1FFFE000); // the sniffer's default: one entry per extended stream
+  static BusLoad<61> load(500000, 1000000);
+  ids.clear();
+  load.clear();
+  const uint32_t seconds = 60;
+  uint64_t t = 0, nextPeriodic = 10000;
+  uint32_t n = 0, periodic = 0;
+  struct can_frame tick;
+  memset(&tick, 0, sizeof(tick));
+  tick.can_id = 0x100;
+  tick.can_dlc = 8;
+  double ns = 0;
+  while (t < seconds * 1000000ULL) {
+    const bool isTick = t >= nextPeriodic;
+    const struct can_frame &f = isTick ? tick : frames[n++ % frames.size()];
+    if (isTick) {
+      nextPeriodic += 10000 + (periodic++ % 3) * 50 - 50;
+    }
+    auto t0 = std::chrono::steady_clock::now();
+    const uint16_t bits = cansim::frameBits(f).total;
+    ids.record(f, (uint32_t)t);
+    load.add((uint32_t)t, bits);
+    ns += nsSince(t0, 1);
+    t += bits * 2; // 2 us per bit at 500 kbps: the next frame starts right after this one
+  }
+  load.advance((uint32_t)t);
+  const uint32_t total = n + periodic;
+  printf("  %u frames (%.0f/s), %.0f ns per frame; %u IDs, %u untracked frames\n", total, total / (double)seconds,
+         ns / total, ids.ids(), ids.untracked());
+  printf("  bus load 1s %.1f%%, 10s %.1f%%, 60s %.1f%%, peak %.1f%%\n", 100 * load.load(1), 100 * load.load(10),
+         100 * load.load(60), 100 * load.peak(60));
+  bool ok = load.load(60) > 0.99f && load.load(60) < 1.01f && ids.untracked() == 0;
+  ids.forEach([&](const IdStats &s) {
+    if (s.key != 0x100) return;
+    printf("  ID 100: %u frames, avg gap %.3f ms (min %.3f, max %.3f), jitter %.3f ms\n", s.frames,
+           s.avgGapUs() / 1000.0, s.minGapUs / 1000.0, s.maxGapUs / 1000.0, s.jitterUs() / 1000.0);
+    ok = ok && s.frames == periodic && s.avgGapUs() > 9800 && s.avgGapUs() < 10200;
+  });
+  printf("  %s\n\n", ok ? "load and periodic ID as expected" : "UNEXPECTED load or periodic ID stats");
+  return ok ? 0 : 1;
+}
+
+// ---- suite: simulated sweep vs. stored baseline ----
+
+struct SuiteRow {
+  std::string name;
+  double framesPerSec;
+  double goodputBps;
+  double p50Ms;
+  double p99Ms;
+  double cpuNsPerFrame;
+};
+
+struct SuiteMetric {
+  const char *key;
+  bool higherIsBetter;
+  double SuiteRow::*field;
+  double defaultTolerance; // relative; < 0 = reported but never fails the run
+};
+
+// The simulation is deterministic, so bus metrics get tight tolerances. Host CPU time
+// depends on the machine and its load, so it is only reported unless the baseline
+// file gives it a tolerance of its own
+static const SuiteMetric suiteMetrics[] = {
+  {"frames_per_sec",   true,  &SuiteRow::framesPerSec,  0.01},
+  {"goodput_bps",      true,  &SuiteRow::goodputBps,    0.01},
+  {"p50_ms",           false, &SuiteRow::p50Ms,         0.02},
+  {"p99_ms",           false, &SuiteRow::p99Ms,         0.02},
+  {"cpu_ns_per_frame", false, &SuiteRow::cpuNsPerFrame, -1},
+};
+static const size_t SUITE_METRICS = sizeof(suiteMetrics) / sizeof(suiteMetrics[0]);
+
+static double cpuSeconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Minimal reader for the flat JSON this file writes: `"key": number` / `"key": "text"`
+static bool jsonNumber(const char *line, const char *key, double &out) {
+  char pattern[48];
+  snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+  const char *p = strstr(line, pattern);
+  if (!p) return false;
+  out = strtod(p + strlen(pattern), nullptr);
+  return true;
+}
+
+static bool jsonString(const char *line, const char *key, std::string &out) {
+  char pattern[48];
+  snprintf(pattern, sizeof(pattern), "\"%s\": \"", key);
+  const char *p = strstr(line, pattern);
+  if (!p) return false;
+  p += strlen(pattern);
+  const char *end = strchr(p, '"');
+  if (!end) return false;
+  out.assign(p, end - p);
+  return true;
+}
+
+static bool loadBaseline(const char *path, std::vector<SuiteRow> &rows, double *tolerance) {
+  FILE *fp = fopen(path, "r");
+  if (!fp) return false;
+  char line[512];
+  while (fgets(line, sizeof(line), fp)) {
+    if (strstr(line, "\"tolerance\"")) {
+      for (size_t m = 0; m < SUITE_METRICS; ++m) jsonNumber(line, suiteMetrics[m].key, tolerance[m]);
+      continue;
+    }
+    SuiteRow r;
+    if (!jsonString(line, "name", r.name)) continue;
+    for (size_t m = 0; m < SUITE_METRICS; ++m) {
+      double v = 0;
+      jsonNumber(line, suiteMetrics[m].key, v);
+      r.*(suiteMetrics[m].field) = v;
+    }
+    rows.push_back(r);
+  }
+  fclose(fp);
+  return true;
+}
+
+static bool writeBaseline(const char *path, const std::vector<SuiteRow> &rows, const double *tolerance) {
+  FILE *fp = fopen(path, "w");
+  if (!fp) return false;
+  fprintf(fp, "{\n  \"tolerance\": {");
+  bool first = true;
+  for (size_t m = 0; m < SUITE_METRICS; ++m) {
+    if (tolerance[m] < 0) continue; // not gated
+    fprintf(fp, "%s\"%s\": %.2f", first ? "" : ", ", suiteMetrics[m].key, tolerance[m]);
+    first = false;
+  }
+  fprintf(fp, "},\n  \"results\": [\n");
+  for (size_t i = 0; i < rows.size(); ++i) {
+    const SuiteRow &r = rows[i];
+    // Boards don't measure CPU time: their lines carry null, which reads back as 0
+    char cpu[24];
+    if (r.cpuNsPerFrame > 0) {
+      snprintf(cpu, sizeof(cpu), "%.0f", r.cpuNsPerFrame);
+    } else {
+      snprintf(cpu, sizeof(cpu), "null");
+    }
+    fprintf(fp, "    {\"name\": \"%s\", \"frames_per_sec\": %.1f, \"goodput_bps\": %.1f, \"p50_ms\": %.3f, "
+                "\"p99_ms\": %.3f, \"cpu_ns_per_frame\": %s}%s\n",
+            r.name.c_str(), r.framesPerSec, r.goodputBps, r.p50Ms, r.p99Ms, cpu, i + 1 < rows.size() ? "," : "");
+  }
+  fprintf(fp, "  ]\n}\n");
+  fclose(fp);
+  return true;
+}
+
+static void runSuiteSweep(std::vector<SuiteRow> &rows) {
+  printf("== suite: simulated sweep (compact framing, 500 kbps) ==\n");
+  static uint8_t payload[65535];
+  for (uint32_t i = 0; i < sizeof(payload); ++i) payload[i] = (uint8_t)('a' + i % 26);
+
+  static const uint16_t lengths[] = {1, 4, 5, 10, 100, 1534, 2048, 65535};
+  static const uint32_t gaps[] = {0, 5000};
+  static const uint8_t receiverCounts[] = {1, 5};
+
+  printf("%-26s %9s %10s %9s %9s %9s\n", "case", "frames/s", "goodput", "p50 ms", "p99 ms", "cpu ns/f");
+  for (size_t g = 0; g < sizeof(gaps) / sizeof(gaps[0]); ++g) {
+    for (size_t rc = 0; rc < sizeof(receiverCounts) / sizeof(receiverCounts[0]); ++rc) {
+      for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l) {
+        cansim::ScenarioConfig c = cansim::defaultScenario();
+        c.len = lengths[l];
+        c.minGapUs = gaps[g];
+        c.receivers = receiverCounts[rc];
+        c.targetMask = c.receivers == 1 ? 0x01 : canframing::RECEIVER_MASK_ALL;
+        // Enough messages for stable percentiles, bounded at ~50k frames per case
+        const uint32_t frames = canframing::framesForLength(c.framing, c.len);
+        c.messages = 50000 / frames < 5 ? 5 : (50000 / frames > 500 ? 500 : 50000 / frames);
+
+        const double cpu0 = cpuSeconds();
+        const cansim::ScenarioResult res = cansim::runScenario(c, payload);
+        const double cpu = cpuSeconds() - cpu0;
+
+        char name[64];
+        snprintf(name, sizeof(name), "len=%u gap=%u rx=%u", c.len, c.minGapUs, c.receivers);
+        SuiteRow row;
+        row.name = name;
+        row.framesPerSec = res.framesPerSec;
+        row.goodputBps = res.goodputBps;
+        row.p50Ms = res.xferP50Ns / 1e6;
+        row.p99Ms = res.xferP99Ns / 1e6;
+        row.cpuNsPerFrame = res.frames ? cpu * 1e9 / res.frames : 0;
+        rows.push_back(row);
+        printf("%-26s %9.0f %10.0f %9.3f %9.3f %9.0f%s\n", name, row.framesPerSec, row.goodputBps, row.p50Ms,
+               row.p99Ms, row.cpuNsPerFrame, res.lost ? "  LOST MESSAGES" : "");
+      }
+    }
+  }
+}
+
+static int benchSuite(int argc, char **argv) {
+  const char *baselinePath = "bench/baseline.json";
+  const char *resultsPath = nullptr;
+  bool write = false;
+  for (int i = 0; i < argc; ++i) {
+    if (strcmp(argv[i], "--write") == 0) {
+      write = true;
+    } else if (strcmp(argv[i], "--results") == 0 && i + 1 < argc) {
+      resultsPath = argv[++i];
+    } else {
+      baselinePath = argv[i];
+    }
+  }
+
+  std::vector<SuiteRow> rows;
+  double tolerance[SUITE_METRICS];
+  for (size_t m = 0; m < SUITE_METRICS; ++m) tolerance[m] = suiteMetrics[m].defaultTolerance;
+
+  if (resultsPath) {
+    // Results captured elsewhere, e.g. the sender's "bench <target>" lines from a board
+    double ignored[SUITE_METRICS];
+    if (!loadBaseline(resultsPath, rows, ignored) || rows.empty()) {
+      fprintf(stderr, "no results in %s\n", resultsPath);
+      return 1;
+    }
+    printf("== suite: %u results from %s vs %s ==\n", (unsigned)rows.size(), resultsPath, baselinePath);
+  } else {
+    runSuiteSweep(rows);
+  }
+
+  std::vector<SuiteRow> baseline;
+  const bool haveBaseline = loadBaseline(baselinePath, baseline, tolerance);
+
+  if (write) {
+    if (!writeBaseline(baselinePath, rows, tolerance)) {
+      fprintf(stderr, "cannot write %s\n", baselinePath);
+      return 1;
+    }
+    printf("baseline written to %s\n\n", baselinePath);
+    return 0;
+  }
+  if (!haveBaseline) {
+    printf("no baseline at %s (run with --write to create it)\n\n", baselinePath);
+    return 0;
+  }
+
+  uint32_t regressions = 0, improvements = 0, missing = 0;
+  double ungatedChange[SUITE_METRICS] = {0};
+  uint32_t ungatedCases[SUITE_METRICS] = {0};
+  for (size_t i = 0; i < rows.size(); ++i) {
+    const SuiteRow *base = nullptr;
+    for (size_t j = 0; j < baseline.size(); ++j) {
+      if (baseline[j].name == rows[i].name) base = &baseline[j];
+    }
+    if (!base) {
+      missing++;
+      continue;
+    }
+    for (size_t m = 0; m < SUITE_METRICS; ++m) {
+      const double now = rows[i].*(suiteMetrics[m].field);
+      const double was = base->*(suiteMetrics[m].field);
+      if (was == 0 || now == 0) continue; // 0 = not measured (CPU time on a board)
+      const double change = (now - was) / was; // relative
+      if (tolerance[m] < 0) {
+        ungatedChange[m] += change;
+        ungatedCases[m]++;
+        continue;
+      }
+      const bool worse = suiteMetrics[m].higherIsBetter ? change < -tolerance[m] : change > tolerance[m];
+      const bool better = suiteMetrics[m].higherIsBetter ? change > tolerance[m] : change < -tolerance[m];
+      if (worse || better) {
+        printf("  %s %-22s %-16s %12.3f -> %12.3f (%+.1f%%)\n", worse ? "REGRESSION" : "improved  ",
+               rows[i].name.c_str(), suiteMetrics[m].key, was, now, 100.0 * change);
+      }
+      if (worse) regressions++;
+      if (better) improvements++;
+    }
+  }
+  for (size_t m = 0; m < SUITE_METRICS; ++m) {
+    if (ungatedCases[m] == 0) continue;
+    printf("  %s: %+.1f%% vs baseline on average over %u cases (reported, not gated)\n", suiteMetrics[m].key,
+           100.0 * ungatedChange[m] / ungatedCases[m], ungatedCases[m]);
+  }
+  printf("%u regressions, %u improvements beyond tolerance, %u cases not in baseline%s\n\n", regressions,
+         improvements, missing, improvements || missing ? " (--write to update)" : "");
+  return regressions ? 1 : 0;
+}
+
+struct Benchmark {
+  const char *name;
+  int (*run)(int argc, char **argv); // argv after the benchmark name; non-zero fails the run
+};
+
+static const Benchmark benchmarks[] = {
+  {"framing", benchFraming},
+  {"transport", benchTransport},
+  {"sim", benchSim},
+  {"log", benchLog},
+  {"loss", benchLoss},
+  {"window", benchWindow},
+  {"reorder", benchReorder},
+  {"compress", benchCompress},
+  {"crc", benchCrc},
+  {"fec", benchFec},
+  {"prio", benchPrio},
+  {"capture", benchCapture},
+  {"sniffer", benchSniffer},
+  {"suite", benchSuite},
+};
+
+int main(int argc, char **argv) {
+  bool ran = false;
+  int status = 0;
+  for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); ++i) {
+    if (argc < 2 || strcmp(argv[1], benchmarks[i].name) == 0) {
+      const int r = argc < 2 ? benchmarks[i].run(0, nullptr) : benchmarks[i].run(argc - 2, argv + 2);
+      if (r != 0) status = r;
+      ran = true;
+    }
+  }
+  if (!ran) {
+    fprintf(stderr, "unknown benchmark '%s'; available:", argv[1]);
+    for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); ++i) fprintf(stderr, " %s", benchmarks[i].name);
+    fprintf(stderr, "\n");
+    return 1;
+  }
+  return status;
+}
+
+#endif // ROLE_BENCH
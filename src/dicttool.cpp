@@ -0,0 +1,220 @@
+#ifdef ROLE_DICT
+/*
+ * Host tool for the pre-shared compression dictionary (PlatformIO `dict` environment)
+ * - Runs on Linux: pio run -e dict, then .pio/build/dict/program <command>
+ * - Corpus: a text file with one message per line (bench/corpus/messages.txt)
+ *
+ * Commands:
+ * - train <corpus> [--size bytes] [--write [header]]: builds a dictionary from 4 of every
+ *   5 messages and reports, on the 5th, the frames the sender would need with the
+ *   current dictionary (include/MessageDictionary.h) and with the new one; --write
+ *   replaces the header (default include/MessageDictionary.h). Rebuild and flash the
+ *   sender and every receiver together afterwards: a receiver drops messages coded
+ *   with a dictionary it doesn't have
+ * - report <corpus>: the same report for the current dictionary over the whole corpus
+ *
+ * Training is greedy: substrings of MIN_MATCH + 1 .. MAX_MATCH bytes are scored by the
+ * bits a copy saves over literals times the number of messages containing them; the
+ * best is taken, the substrings it covers stop counting, and so on until the dictionary
+ * is full. The best strings go last, nearest the message, where copies stay in reach.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <CanFraming.h>
+#include <Lzss.h>
+#include <MessageDictionary.h>
+
+static const char *DEFAULT_HEADER = "include/MessageDictionary.h";
+static const uint16_t DEFAULT_SIZE = 384;
+static const uint16_t RX_BUFFER = 2048; // receivers' MAX_MESSAGE
+
+static bool loadCorpus(const char *path, std::vector<std::string> &lines) {
+  FILE *fp = fopen(path, "r");
+  if (!fp) return false;
+  char line[1024];
+  while (fgets(line, sizeof(line), fp)) {
+    size_t n = strlen(line);
+    while (n && (line[n - 1] == '\n' || line[n - 1] == '\r')) n--;
+    if (n) lines.push_back(std::string(line, n));
+  }
+  fclose(fp);
+  return true;
+}
+
+static uint8_t dictionaryId(const std::string &d) {
+  uint32_t h = 2166136261u; // FNV-1a
+  for (size_t i = 0; i < d.size(); ++i) h = (h ^ (uint8_t)d[i]) * 16777619u;
+  return (uint8_t)((h ^ (h >> 7) ^ (h >> 14) ^ (h >> 21) ^ (h >> 28)) & 0x7F);
+}
+
+static std::string train(const std::vector<std::string> &msgs, uint16_t size) {
+  std::map<std::string, uint32_t> count; // messages containing each substring
+  for (size_t m = 0; m < msgs.size(); ++m) {
+    std::set<std::string> seen;
+    const std::string &s = msgs[m];
+    for (size_t i = 0; i < s.size(); ++i) {
+      for (size_t n = lzss::MIN_MATCH + 1; n <= lzss::MAX_MATCH && i + n <= s.size(); ++n) seen.insert(s.substr(i, n));
+    }
+    for (std::set<std::string>::const_iterator it = seen.begin(); it != seen.end(); ++it) count[*it]++;
+  }
+  const uint32_t copyBits = 1 + lzss::WINDOW_BITS + lzss::LENGTH_BITS;
+  std::vector<std::string> picked;
+  uint32_t used = 0;
+  while (used < size) {
+    std::map<std::string, uint32_t>::iterator best = count.end();
+    uint64_t bestScore = 0;
+    for (std::map<std::string, uint32_t>::iterator it = count.begin(); it != count.end(); ++it) {
+      if (it->second < 2 || it->first.size() > size - used) continue;
+      const uint64_t score = (uint64_t)it->second * (it->first.size() * 9 - copyBits);
+      if (score > bestScore) {
+        bestScore = score;
+        best = it;
+      }
+    }
+    if (best == count.end()) break;
+    const std::string s = best->first;
+    picked.push_back(s);
+    used += s.size();
+    for (size_t i = 0; i < s.size(); ++i) {
+      for (size_t n = 1; i + n <= s.size(); ++n) {
+        std::map<std::string, uint32_t>::iterator it = count.find(s.substr(i, n));
+        if (it != count.end()) it->second = 0;
+      }
+    }
+  }
+  std::string dict;
+  for (size_t i = picked.size(); i-- > 0;) dict += picked[i];
+  return dict;
+}
+
+// Frames the sender would need for each message, raw and as it sends them with `dict`
+// (nullptr: plain LZSS only)
+static void report(const char *label, const std::vector<std::string> &msgs, const lzss::Dictionary *dict) {
+  static const canframing::Framing framings[] = {canframing::FRAMING_LEGACY, canframing::FRAMING_COMPACT,
+                                                 canframing::FRAMING_EXTENDED};
+  static const char *names[] = {"legacy", "compact", "extended"};
+  static lzss::LzssEncoder enc;
+  static uint8_t out[RX_BUFFER];
+  uint64_t rawBytes = 0, wireBytes = 0;
+  uint64_t rawFrames[3] = {0, 0, 0}, sentFrames[3] = {0, 0, 0}, short2[3] = {0, 0, 0};
+  for (size_t m = 0; m < msgs.size(); ++m) {
+    const uint16_t len = (uint16_t)msgs[m].size();
+    uint16_t n = enc.compressBest((const uint8_t *)msgs[m].data(), len, out, sizeof(out), dict, RX_BUFFER);
+    if (!n) n = len;
+    rawBytes += len;
+    wireBytes += n;
+    for (size_t k = 0; k < 3; ++k) {
+      const uint32_t raw = canframing::framesForLength(framings[k], len);
+      const uint32_t sent = canframing::framesForLength(framings[k], n);
+      rawFrames[k] += raw;
+      sentFrames[k] += sent;
+      if (sent <= 2) short2[k]++;
+    }
+  }
+  printf("%s: %u messages, %.1f bytes on average, %.1f on the wire (x%.2f)\n", label, (unsigned)msgs.size(),
+         (double)rawBytes / msgs.size(), (double)wireBytes / msgs.size(), (double)rawBytes / wireBytes);
+  printf("  %-9s %11s %11s %7s %9s\n", "framing", "raw frames", "sent frames", "saved", "<=2 frames");
+  for (size_t k = 0; k < 3; ++k) {
+    printf("  %-9s %11.2f %11.2f %6.1f%% %8.1f%%\n", names[k], (double)rawFrames[k] / msgs.size(),
+           (double)sentFrames[k] / msgs.size(), 100.0 * (rawFrames[k] - sentFrames[k]) / rawFrames[k],
+           100.0 * short2[k] / msgs.size());
+  }
+}
+
+static bool writeHeader(const char *path, const std::string &dict, uint8_t id, const char *corpus) {
+  FILE *fp = fopen(path, "w");
+  if (!fp) return false;
+  fprintf(fp, "/*\n"
+              " * Pre-shared dictionary for dictionary-coded messages (lib/Lzss), compiled into the\n"
+              " * sender and every receiver; they must be built from the same version\n"
+              " * - Generated by the dict tool from %s, don't edit; retrain with\n"
+              " *   .pio/build/dict/program train %s --write\n"
+              " */\n\n"
+              "#pragma once\n\n"
+              "#include <stdint.h>\n"
+              "#include <Lzss.h>\n\n"
+              "static const uint8_t MESSAGE_DICT_ID = 0x%02X;\n"
+              "static const char MESSAGE_DICT_TEXT[] =\n",
+          corpus, corpus, id);
+  for (size_t i = 0; i < dict.size(); i += 64) {
+    fprintf(fp, "    \"");
+    for (size_t k = i; k < i + 64 && k < dict.size(); ++k) {
+      const char c = dict[k];
+      if (c == '"' || c == '\\') fprintf(fp, "\\%c", c);
+      else if (c < 0x20 || c > 0x7E) fprintf(fp, "\\x%02X\"\"", (uint8_t)c);
+      else fputc(c, fp);
+    }
+    fprintf(fp, "\"%s\n", i + 64 < dict.size() ? "" : ";");
+  }
+  if (dict.empty()) fprintf(fp, "    \"\";\n");
+  fprintf(fp, "static const lzss::Dictionary MESSAGE_DICT = {(const uint8_t *)MESSAGE_DICT_TEXT,\n"
+              "                                            sizeof(MESSAGE_DICT_TEXT) - 1, MESSAGE_DICT_ID};\n");
+  fclose(fp);
+  return true;
+}
+
+static int usage() {
+  fprintf(stderr, "usage: train <corpus> [--size bytes] [--write [header]]\n"
+                  "       report <corpus>\n");
+  return 1;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) return usage();
+  const char *corpus = argv[2];
+  std::vector<std::string> msgs;
+  if (!loadCorpus(corpus, msgs) || msgs.empty()) {
+    fprintf(stderr, "cannot read messages from %s\n", corpus);
+    return 1;
+  }
+  char label[96];
+  if (strcmp(argv[1], "report") == 0) {
+    report("no dictionary", msgs, nullptr);
+    snprintf(label, sizeof(label), "current dictionary (id 0x%02X, %u bytes)", MESSAGE_DICT_ID, MESSAGE_DICT.len);
+    report(label, msgs, &MESSAGE_DICT);
+    return 0;
+  }
+  if (strcmp(argv[1], "train") != 0) return usage();
+
+  uint16_t size = DEFAULT_SIZE;
+  const char *header = nullptr;
+  for (int i = 3; i < argc; ++i) {
+    if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+      size = (uint16_t)atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--write") == 0) {
+      header = i + 1 < argc && argv[i + 1][0] != '-' ? argv[++i] : DEFAULT_HEADER;
+    } else {
+      return usage();
+    }
+  }
+  if (size > lzss::WINDOW) size = lzss::WINDOW;
+
+  // Hold every 5th message out, so the report shows what unseen messages gain
+  std::vector<std::string> trainSet, heldOut;
+  for (size_t i = 0; i < msgs.size(); ++i) (i % 5 == 4 ? heldOut : trainSet).push_back(msgs[i]);
+  if (heldOut.empty()) heldOut = trainSet;
+
+  const std::string dict = train(trainSet, size);
+  const lzss::Dictionary trained = {(const uint8_t *)dict.data(), (uint16_t)dict.size(), dictionaryId(dict)};
+  printf("trained on %u messages, %u bytes, id 0x%02X; held out %u\n\n", (unsigned)trainSet.size(),
+         trained.len, trained.id, (unsigned)heldOut.size());
+  report("no dictionary", heldOut, nullptr);
+  snprintf(label, sizeof(label), "current dictionary (id 0x%02X, %u bytes)", MESSAGE_DICT_ID, MESSAGE_DICT.len);
+  report(label, heldOut, &MESSAGE_DICT);
+  report("new dictionary", heldOut, &trained);
+  if (!header) return 0;
+  if (!writeHeader(header, dict, trained.id, corpus)) {
+    fprintf(stderr, "cannot write %s\n", header);
+    return 1;
+  }
+  printf("\nwrote %s\n", header);
+  return 0;
+}
+
+#endif // ROLE_DICT
@@ -2,18 +2,102 @@
 /*
  * CAN Bus Receiver supporting multi-frame segmented messages
  * - Compile with -D RECEIVER_ID=1..5
- * - Listens on CAN ID 0x200 + RECEIVER_ID
+ * - Listens on CAN ID 0x200 + RECEIVER_ID, broadcast 0x200 and groups 0x220 | mask
+ *   (bit RECEIVER_ID-1 set); extended IDs with destination 0x20 | mask
+ * - Every priority class of those IDs: urgent 0x0__, normal 0x2__, bulk 0x4__ (see
+ *   lib/CanFraming); an urgent message can complete in the middle of a bulk one
  *
- * Protocol (must match sender):
- * Start frame (magic 0xAA): [0]=0xAA, [1]=lenLow, [2]=lenHigh, [3]=seq(0), [4..]=payload
- * Continuation (magic 0xCC): [0]=0xCC, [1]=seq(>=1), [2..]=payload
+ * Protocol (must match sender), detected per message:
+ * Legacy start (magic 0xAA): [0]=0xAA, [1]=lenLow, [2]=lenHigh, [3]=seq(0), [4..]=payload
+ * Legacy cont  (magic 0xCC): [0]=0xCC, [1]=seq(>=1), [2..]=payload
+ * Compact start (PCI 0x4_):  [0]=0x40|flags, [1]=lenLow, [2]=lenHigh, [3..]=payload
+ * Compact cont  (PCI 0x5_):  [0]=0x50|(seq&0x0F), [1..]=payload
+ * Extended ID (29-bit): prio|type|dest|src|msgId|seq in the identifier, see lib/CanFraming
+ *   start: [0..1]=len, [2..]=payload; data: [0..7]=payload
  *
- * Assembles message in a buffer up to MAX_MESSAGE (configurable)
+ * Assembles messages up to MAX_MESSAGE (configurable); up to RX_SESSIONS messages
+ * from different sources/message ids can be in flight at once, idle ones are evicted
+ * after RX_SESSION_TIMEOUT_MS
+ *
+ * ISO-TP mode (-D CAN_TRANSPORT_ISOTP): ISO 15765-2 SF/FF/CF on 0x200 + RECEIVER_ID,
+ * flow control (ISOTP_BLOCK_SIZE, ISOTP_STMIN) answered on 0x280 + RECEIVER_ID;
+ * messages up to the full 4095 bytes, in a buffer of their own
+ *
+ * Acceptance filtering:
+ * - RXM0/RXF0..1 match our standard ID and the broadcast ID in any priority class; RXM1 only
+ *   checks the group flag and our mask bit, which covers standard group IDs (RXF3)
+ *   and every extended destination that includes us (RXF2/4/5), so frames for
+ *   other receivers are rejected by the MCP2515 and never cross SPI
+ * - Build with -D RX_HW_FILTER=0 to accept everything and filter in software only
+ *
+ * Logging: per-frame diagnostics go through lib/AsyncLog (binary ring, drained to
+ * Serial by a low-priority task); the per-frame "Added chunk" line is debug level,
+ * build with -D LOG_LEVEL=4 to see it
+ *
+ * Resume: a sequence gap in a unicast message from a resuming sender NACKs the sender
+ *   (control frame on CAN_BASE_ID - 0x80 + RECEIVER_ID) instead of dropping the message;
+ *   windowed messages are placed by sequence and ACKed with a bitmap on the same ID;
+ *   see lib/CanTransport/CanReassembler.h
+ *
+ * Compression: messages with START_FLAG_COMPRESSED are decompressed in place in the
+ *   reassembly buffer as they arrive (lib/Lzss), so they must fit MAX_MESSAGE decompressed;
+ *   dictionary-coded ones need the sender's include/MessageDictionary.h (same id)
+ * CRC: messages with START_FLAG_CRC are checked against their CRC-32 trailer as they
+ *   complete (the CRC is folded in frame by frame) and dropped on a mismatch
+ * FEC: messages with START_FLAG_FEC get one lost frame per parity group rebuilt from the
+ *   group's parity frame; a group missing more than one is dropped
+ *
+ * Counters: lib/CanStats atomics; type "stats" for one JSON line with all of them
+ * Profiling: -D PROFILE=1 builds in lib/Profiler probes; "profile" prints them
+ *
+ * Capture: every frame read from the MCP2515 is also kept, with its micros() timestamp,
+ * in a lib/CanCapture ring (RX_CAPTURE_BYTES, 0 = off) holding the most recent
+ * traffic; "capture" prints it as candump, "capture pcap" as hex PCAP lines
+ *
+ * Sniffer (-D RX_SNIFFER, `sniffer` environment): listen-only mode, no acceptance
+ * filters and no reassembly; every frame updates per-ID statistics (lib/CanSniffer)
+ * and the bus load windows. "ids" prints the per-ID table
+ *
+ * Receive path:
+ * - Default: MCP2515 INT pin (active low) wakes a FreeRTOS task that drains RXB0/RXB1 until empty
+ * - Build with -D RX_POLLING to fall back to polling readMessage() from loop(), without
+ *   sleeping between polls
+ * - RX overflow events (EFLG RX0OVR/RX1OVR) are counted and reported
+ * - Frames are handed to loop() through a lock-free SPSC ring, so slow
+ *   reassembly/printing never holds up draining the MCP2515
  */
 
 #include <Arduino.h>
 #include <SPI.h>
 #include <mcp2515.h>
+#include <FrameRing.h>
+#include <CanFraming.h>
+#include <CanReassembler.h>
+#include <MessageDictionary.h>
+#include <AsyncLog.h>
+#include <AsyncLogTask.h>
+#include <CanStats.h>
+#include <Profiler.h>
+#include <CaptureRing.h>
+#include <CaptureExport.h>
+#ifdef RX_SNIFFER
+#include <IdStats.h>
+#include <BusLoad.h>
+#include <FrameBits.h>
+#endif
+#include <freertos/semphr.h>
+#ifdef CAN_TRANSPORT_ISOTP
+#include <IsoTp.h>
+#endif
+
+// The sniffer isn't addressed and must see every frame: no acceptance filters
+#ifdef RX_SNIFFER
+#ifndef RECEIVER_ID
+#define RECEIVER_ID 0
+#endif
+#undef RX_HW_FILTER
+#define RX_HW_FILTER 0
+#endif
 
 #ifndef RECEIVER_ID
 #error "RECEIVER_ID must be defined (1..5)"
@@ -21,97 +105,631 @@
 #endif
 
 #define CAN_CS_PIN 5
+#define CAN_INT_PIN 4 // MCP2515 INT (active low), unused with RX_POLLING
 static const uint16_t CAN_BASE_ID = 0x200; // base for targeted messages
-static const uint8_t FRAME_MAGIC_START = 0xAA;
-static const uint8_t FRAME_MAGIC_CONT  = 0xCC;
+static const uint16_t CAN_BROADCAST_ID = CAN_BASE_ID; // 0x200 reaches every receiver
+static const uint16_t CAN_ISOTP_RESPONSE_BASE = 0x280; // ISO-TP flow control: 0x280 + RECEIVER_ID
+
+// ISO-TP flow control we advertise: CFs per block (0 = unlimited) and STmin byte
+#ifndef ISOTP_BLOCK_SIZE
+#define ISOTP_BLOCK_SIZE 16
+#endif
+#ifndef ISOTP_STMIN
+#define ISOTP_STMIN 0
+#endif
+
+#ifndef RX_HW_FILTER
+#define RX_HW_FILTER 1
+#endif
+
+// Frames buffered between the RX context and the reassembler (power of two, 16 B each)
+#ifndef RX_RING_SIZE
+#define RX_RING_SIZE 256
+#endif
+
+// Recent-traffic capture (power of two, ~14 B per frame; 0 disables it)
+#ifndef RX_CAPTURE_BYTES
+#define RX_CAPTURE_BYTES 8192
+#endif
 
 // Adjust as needed. Large buffers consume RAM; ESP32 usually fine.
-static const uint16_t MAX_MESSAGE = 2048; // 2KB cap
+static const uint16_t MAX_MESSAGE = 2048; // 2KB cap per reassembly buffer
+
+// Messages reassembled at the same time (e.g. from several senders), the buffers
+// shared between them (RX_SESSION_BUFFERS * MAX_MESSAGE bytes), and how long an
+// unfinished message may sit idle before its session is evicted
+#ifndef RX_SESSIONS
+#define RX_SESSIONS 4
+#endif
+#ifndef RX_SESSION_BUFFERS
+#define RX_SESSION_BUFFERS 4
+#endif
+#ifndef RX_SESSION_TIMEOUT_MS
+#define RX_SESSION_TIMEOUT_MS 1000
+#endif
+
+// A resumable message (sender built with TX_RESUME_WINDOW_MS) that gaps or stalls is
+// NACKed, and NACKed again after this long without its resume marker (0 = only on a gap)
+#ifndef RX_NACK_TIMEOUT_MS
+#define RX_NACK_TIMEOUT_MS 20
+#endif
+
+// Windowed messages (sender TX_WINDOW > 0): ACK every this many frames (at most half
+// the sender's window, or it stalls until the ACK delay), and once the stream has been
+// quiet this long
+#ifndef RX_ACK_EVERY
+#define RX_ACK_EVERY 4
+#endif
+#ifndef RX_ACK_DELAY_US
+#define RX_ACK_DELAY_US 1000
+#endif
 
 MCP2515 mcp2515(CAN_CS_PIN);
 
-static uint8_t  buffer[MAX_MESSAGE];
-static uint16_t expectedLen = 0;
-static uint16_t receivedLen = 0;
-static uint8_t  nextSeq = 0;
-static bool     assembling = false;
+// The RX task and loop() both talk to the MCP2515; SPI access must not interleave
+#ifndef RX_POLLING
+static SemaphoreHandle_t spiLock = nullptr;
+static void lockSpi() { xSemaphoreTake(spiLock, portMAX_DELAY); }
+static void unlockSpi() { xSemaphoreGive(spiLock); }
+#else
+static void lockSpi() {}
+static void unlockSpi() {}
+#endif
+
+// Counters shared by the RX task and loop(); all atomic, see lib/CanStats
+static CanCounters counters;
+static std::atomic<uint32_t> spiTransactions(0);
+static std::atomic<uint32_t> framesDelivered(0); // frames addressed to us (written by loop())
+static std::atomic<uint32_t> framesForeign(0);   // frames that crossed SPI but weren't for us
 
-static void resetAssembly() {
-  expectedLen = 0;
-  receivedLen = 0;
-  nextSeq = 0;
-  assembling = false;
+// Transmit a protocol control frame (e.g. ISO-TP flow control) back to the sender
+static bool sendControlFrame(const struct can_frame &frm) {
+  lockSpi();
+  MCP2515::ERROR r = mcp2515.sendMessage(&frm);
+  unlockSpi();
+  if (r != MCP2515::ERROR_OK) {
+    LOG_E("Failed to send control frame 0x%X", frm.can_id);
+    return false;
+  }
+  countAdd(counters.framesTx);
+  return true;
 }
 
-static void handleStartFrame(const struct can_frame &frm) {
-  if (frm.can_dlc < 4) {
-    Serial.println("Start frame too short");
-    return;
+// SPI transactions issued by the arduino-mcp2515 calls on the RX path
+static const uint8_t SPI_OPS_READ_MESSAGE = 5; // READ STATUS, header, RXBnCTRL, data, CANINTF bit modify
+static const uint8_t SPI_OPS_NO_MESSAGE   = 1; // READ STATUS only
+static FrameRing<RX_RING_SIZE> rxRing;
+#if RX_CAPTURE_BYTES
+static CaptureRing<RX_CAPTURE_BYTES> captureRing; // written by the RX context, dumped from loop()
+#endif
+
+#ifdef RX_SNIFFER
+// Per-ID table slots (power of two, 40 B each; 3/4 of them usable)
+#ifndef SNIFF_ID_SLOTS
+#define SNIFF_ID_SLOTS 256
+#endif
+// Extended IDs are grouped under this mask; the default drops our framing's message id
+// and sequence bits (lib/CanFraming) so each sender/destination stream is one entry.
+// 0x1FFFFFFF keeps every extended ID apart
+#ifndef SNIFF_EXT_ID_MASK
+#define SNIFF_EXT_ID_MASK 0x1FFFE000
+#endif
+#ifndef SNIFF_BITRATE
+#define SNIFF_BITRATE 500000
+#endif
+#ifndef SNIFF_REPORT_MS
+#define SNIFF_REPORT_MS 1000
+#endif
+// Updated by the RX context under the SPI lock; loop() copies them under it too
+static IdStatsTable<SNIFF_ID_SLOTS> idStats(SNIFF_EXT_ID_MASK);
+static BusLoad<61> busLoad(SNIFF_BITRATE, 1000000); // 1 s buckets, 60 s of history
+
+static void sniffFrame(const struct can_frame &frm, uint32_t nowUs) {
+  PROFILE_SCOPE("rx.sniffFrame");
+  idStats.record(frm, nowUs);
+  busLoad.add(nowUs, cansim::frameBits(frm).total);
+}
+#endif
+
+// CanReassembler HAL: frames come from the RX ring, replies go out through the MCP2515
+struct ReceiverHal {
+  bool sendFrame(const struct can_frame &frm) { return sendControlFrame(frm); }
+  bool receiveFrame(struct can_frame &frm) { return rxRing.pop(frm); }
+  uint32_t micros() { return ::micros(); }
+};
+
+static ReceiverHal rxHal;
+// Concurrent reassemblies, one per stream (extended: source + message id; standard: CAN ID)
+static CanReassembler<ReceiverHal, RX_SESSIONS, RX_SESSION_BUFFERS, MAX_MESSAGE>
+    reassembler(rxHal, CAN_BASE_ID, RECEIVER_ID, RX_SESSION_TIMEOUT_MS * 1000UL);
+
+// Messages delivered to this receiver, by how they were addressed (indexed by AddressKind)
+static uint32_t messagesDelivered[4] = {0, 0, 0, 0};
+// Of those, messages that arrived compressed, and the bytes that saved on the bus
+static uint32_t messagesDecompressed = 0;
+static uint32_t decompressSavedBytes = 0;
+// Messages dropped because their CRC trailer didn't match
+static uint32_t crcFailures = 0;
+// Messages dropped because an FEC group lost more than its parity frame can rebuild
+static uint32_t fecFailures = 0;
+
+static const char *addressName(canframing::AddressKind kind) {
+  switch (kind) {
+    case canframing::ADDR_GROUP:     return "group";
+    case canframing::ADDR_BROADCAST: return "broadcast";
+    default:                         return "unicast";
+  }
+}
+
+static void printMessage(const uint8_t *data, uint16_t len, canframing::AddressKind kind) {
+  messagesDelivered[kind]++;
+  countAdd(counters.messagesCompleted);
+  countAdd(counters.bytesDelivered, len);
+  Serial.println("\n┌─────────────────────────────────");
+  Serial.print("│ Receiver #"); Serial.print(RECEIVER_ID); Serial.print(" - Message Received ("); Serial.print(addressName(kind)); Serial.println("):");
+  Serial.print("│ Length: "); Serial.print(len); Serial.println(" bytes");
+  Serial.print("│ Delivered: "); Serial.print(messagesDelivered[canframing::ADDR_UNICAST]); Serial.print(" unicast, ");
+  Serial.print(messagesDelivered[canframing::ADDR_GROUP]); Serial.print(" group, ");
+  Serial.print(messagesDelivered[canframing::ADDR_BROADCAST]); Serial.print(" broadcast, ");
+  Serial.print(countGet(counters.bytesDelivered)); Serial.println(" bytes total");
+  Serial.println("├─────────────────────────────────");
+  Serial.print("│ "); Serial.write(data, len); Serial.println();
+  Serial.println("└─────────────────────────────────\n");
+}
+
+static void handleRxEvent(const RxEvent &ev) {
+  switch (ev.type) {
+    case RxEvent::FOREIGN:
+      return;
+    case RxEvent::STARTED:
+      LOG_I("Start message len=%u firstChunk=%u sessions=%u", ev.expected, ev.chunk, reassembler.activeSessions());
+      break;
+    case RxEvent::PROGRESS:
+      LOG_D("Added chunk seq=%u size=%u progress=%u/%u", ev.seq, ev.chunk, ev.received, ev.expected);
+      break;
+    case RxEvent::COMPLETE:
+      if (ev.wire < ev.received) {
+        messagesDecompressed++;
+        decompressSavedBytes += ev.received - ev.wire;
+        LOG_I("Decompressed %u -> %u bytes", ev.wire, ev.received);
+      }
+      if (ev.prio == canframing::PRIO_URGENT) LOG_I("Urgent message, %u bytes", ev.received);
+      printMessage(ev.data, ev.received, ev.addr);
+      break;
+    case RxEvent::NACKED:
+      countAdd(counters.seqMismatches);
+      LOG_W("Sequence gap. Expected %u got %u - NACK sent", ev.expectedSeq, ev.seq);
+      break;
+    case RxEvent::RESUMED:
+      LOG_I("Resumed at seq=%u progress=%u/%u", ev.seq, ev.received, ev.expected);
+      break;
+    case RxEvent::STALE:
+      LOG_D("Ignored seq=%u (duplicate, or waiting for resume)", ev.seq);
+      break;
+    case RxEvent::ERROR:
+      if (ev.error == RxEvent::ERR_SEQ_MISMATCH) countAdd(counters.seqMismatches);
+      if (ev.error == RxEvent::ERR_TOO_LONG) countAdd(counters.oversizeDrops);
+      switch (ev.error) {
+        case RxEvent::ERR_START_TOO_SHORT:  LOG_W("Start frame too short (dlc=%u)", ev.chunk); break;
+        case RxEvent::ERR_TOO_LONG:         LOG_W("Incoming message length %u exceeds buffer. Dropping.", ev.expected); break;
+        case RxEvent::ERR_NO_SESSION:       LOG_W("Incoming message length %u - no free reassembly session. Dropping.", ev.expected); break;
+        case RxEvent::ERR_NO_ASSEMBLY:      LOG_W("Unexpected continuation (no assembly in progress)"); break;
+        case RxEvent::ERR_FRAMING_MISMATCH: LOG_W("Continuation framing differs from start frame"); break;
+        case RxEvent::ERR_CONT_TOO_SHORT:   LOG_W("Continuation frame too short (dlc=%u)", ev.chunk); break;
+        case RxEvent::ERR_SEQ_MISMATCH:     LOG_W("Sequence mismatch. Expected %u got %u", ev.expectedSeq, ev.seq); break;
+        case RxEvent::ERR_DECOMPRESS:       LOG_W("Compressed message malformed. Dropping."); break;
+        case RxEvent::ERR_CRC:              crcFailures++; LOG_W("CRC trailer mismatch. Dropping."); break;
+        case RxEvent::ERR_FEC:              fecFailures++; LOG_W("FEC group %u unrecoverable. Dropping.", ev.seq); break;
+        case RxEvent::ERR_DICTIONARY:       LOG_W("Message coded with dictionary 0x%02X, ours is 0x%02X. Dropping.", ev.seq, MESSAGE_DICT_ID); break;
+        default:                            LOG_W("Unknown frame magic 0x%02X", ev.firstByte); break;
+      }
+      break;
   }
-  expectedLen = (uint16_t)frm.data[1] | ((uint16_t)frm.data[2] << 8);
-  nextSeq = 1; // next expected continuation seq
-  receivedLen = 0;
-  assembling = true;
+}
 
-  if (expectedLen > MAX_MESSAGE) {
-    Serial.print("Incoming message length "); Serial.print(expectedLen); Serial.println(" exceeds buffer. Dropping.");
-    resetAssembly();
+#ifdef CAN_TRANSPORT_ISOTP
+// Sized for the largest ISO-TP message (12-bit length), not MAX_MESSAGE
+static uint8_t isoBuffer[isotp::MAX_LEN];
+static IsoTpReceiver isoRx(isoBuffer, sizeof(isoBuffer), ISOTP_BLOCK_SIZE, ISOTP_STMIN);
+
+// Called from loop(), so flow control goes out only once the reassembler has
+// actually consumed the block: a slow receiver slows the sender down.
+static void handleIsoTpFrame(const struct can_frame &frm) {
+  PROFILE_SCOPE("rx.isoTpFrame");
+  struct can_frame fc;
+  bool sendFc = false;
+  const IsoTpReceiver::Result r = isoRx.onFrame(frm, micros(), fc, sendFc);
+  if (sendFc) {
+    fc.can_id = CAN_ISOTP_RESPONSE_BASE + RECEIVER_ID;
+    sendControlFrame(fc);
+  }
+  if (r == IsoTpReceiver::COMPLETE) {
+    printMessage(isoRx.data(), isoRx.length(), canframing::ADDR_UNICAST);
+  } else if (r == IsoTpReceiver::ERROR) {
+    if (isoRx.expectedLength() > sizeof(isoBuffer)) countAdd(counters.oversizeDrops);
+    LOG_W("ISO-TP receive aborted (len=%u, got %u)", isoRx.expectedLength(), isoRx.length());
+  }
+}
+#endif // CAN_TRANSPORT_ISOTP
+
+static void processFrame(const struct can_frame &rx) {
+  PROFILE_SCOPE("rx.processFrame");
+  // Hardware filters do most of the address check (group matching is looser);
+  // RX_HW_FILTER=0 relies on it entirely
+#ifdef CAN_TRANSPORT_ISOTP
+  const canframing::AddressKind addr = canframing::addressFor(rx, CAN_BASE_ID, RECEIVER_ID);
+  if (addr == canframing::ADDR_NONE) {
+    countAdd(framesForeign);
     return;
   }
+  countAdd(framesDelivered);
+  // ISO-TP flow control is point-to-point
+  if (addr == canframing::ADDR_UNICAST && !canframing::isExtended(rx)) handleIsoTpFrame(rx);
+#else
+  RxEvent ev;
+  reassembler.onFrame(rx, ev);
+  countAdd(ev.type == RxEvent::FOREIGN ? framesForeign : framesDelivered);
+  handleRxEvent(ev);
+#endif
+}
+
+static bool readMessage(struct can_frame &rx) {
+  PROFILE_SCOPE("rx.readMessage");
+  return mcp2515.readMessage(&rx) == MCP2515::ERROR_OK;
+}
 
-  uint8_t payload = frm.can_dlc - 4; // bytes after header
-  for (uint8_t i = 0; i < payload; ++i) {
-    buffer[receivedLen++] = frm.data[4 + i];
+// Read every pending frame out of RXB0/RXB1 into the ring, then account for and
+// clear any overflow the chip flagged (RXnOVR raises ERRIF, so EFLG is only read then).
+static void drainReceiveBuffers() {
+  struct can_frame rx;
+  uint32_t ops = 0;
+  while (readMessage(rx)) {
+    ops += SPI_OPS_READ_MESSAGE;
+    countAdd(counters.framesRx);
+    const uint32_t nowUs = micros();
+#if RX_CAPTURE_BYTES
+    captureRing.push(nowUs, rx);
+#endif
+#ifdef RX_SNIFFER
+    sniffFrame(rx, nowUs);
+#else
+    (void)nowUs;
+    rxRing.push(rx); // a full ring counts the drop itself
+#endif
   }
+  ops += SPI_OPS_NO_MESSAGE;
 
-  Serial.print("Start message len="); Serial.print(expectedLen);
-  Serial.print(" firstChunk="); Serial.print(payload); Serial.println();
+  const uint8_t intf = mcp2515.getInterrupts();
+  ops++;
+  if (intf & MCP2515::CANINTF_ERRIF) {
+    const uint8_t eflg = mcp2515.getErrorFlags();
+    ops++;
+    if (eflg & MCP2515::EFLG_RX0OVR) countAdd(counters.rxOverflows);
+    if (eflg & MCP2515::EFLG_RX1OVR) countAdd(counters.rxOverflows);
+    if (eflg & ~(MCP2515::EFLG_RX0OVR | MCP2515::EFLG_RX1OVR)) countAdd(counters.busErrors); // warning/passive/bus-off
+    if (eflg & (MCP2515::EFLG_RX0OVR | MCP2515::EFLG_RX1OVR)) {
+      mcp2515.clearRXnOVRFlags();
+      ops++;
+    }
+    mcp2515.clearERRIF();
+    ops++;
+  }
+  if (intf & MCP2515::CANINTF_MERRF) {
+    countAdd(counters.busErrors);
+    mcp2515.clearMERR();
+    ops++;
+  }
+  countAdd(spiTransactions, ops);
+}
 
-  if (receivedLen >= expectedLen) {
-    // Complete in one frame
-    buffer[receivedLen] = '\0';
-    Serial.println("\n┌─────────────────────────────────");
-    Serial.print("│ Receiver #"); Serial.print(RECEIVER_ID); Serial.println(" - Message Received:");
-    Serial.print("│ Length: "); Serial.print(expectedLen); Serial.println(" bytes");
-    Serial.println("├─────────────────────────────────");
-    Serial.print("│ "); Serial.println((char*)buffer);
-    Serial.println("└─────────────────────────────────\n");
-    resetAssembly();
+// RXM0 masks RXF0/RXF1 (RXB0): standard IDs, every bit but the priority class must match.
+// RXM1 masks RXF2..RXF5 (RXB1) on the group flag plus our receiver bit only. Its
+// standard-ID part lines up with the extended destination field (ID bits 23..18 are
+// SID bits 5..0), so one mask serves extended destinations (RXF2/4/5) and standard
+// group IDs 0x220 | mask (RXF3). Standard IDs that merely share those two bits get
+// through and are dropped in software.
+static bool configureAcceptanceFilters() {
+  using namespace canframing;
+  const uint32_t ownId = CAN_BASE_ID + RECEIVER_ID;
+  const uint32_t groupBits = EXT_DEST_GROUP | receiverBit(RECEIVER_ID);
+  const uint32_t extGroup = groupBits << EXT_DEST_SHIFT;
+  const uint32_t stdGroup = CAN_BASE_ID + STD_GROUP_OFFSET + receiverBit(RECEIVER_ID);
+  bool ok = true;
+  ok &= mcp2515.setFilterMask(MCP2515::MASK0, false, CAN_SFF_MASK & ~(uint32_t)STD_PRIO_BITS) == MCP2515::ERROR_OK;
+  ok &= mcp2515.setFilter(MCP2515::RXF0, false, ownId) == MCP2515::ERROR_OK;
+  ok &= mcp2515.setFilter(MCP2515::RXF1, false, CAN_BROADCAST_ID) == MCP2515::ERROR_OK;
+  ok &= mcp2515.setFilterMask(MCP2515::MASK1, true, extGroup) == MCP2515::ERROR_OK;
+  ok &= mcp2515.setFilter(MCP2515::RXF2, true, extGroup) == MCP2515::ERROR_OK;
+  ok &= mcp2515.setFilter(MCP2515::RXF3, false, stdGroup) == MCP2515::ERROR_OK;
+  ok &= mcp2515.setFilter(MCP2515::RXF4, true, extGroup) == MCP2515::ERROR_OK;
+  ok &= mcp2515.setFilter(MCP2515::RXF5, true, extGroup) == MCP2515::ERROR_OK;
+  return ok;
+}
+
+#ifndef RX_POLLING
+static TaskHandle_t rxTaskHandle = nullptr;
+
+static void IRAM_ATTR onCanInterrupt() {
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(rxTaskHandle, &woken);
+  if (woken) {
+    portYIELD_FROM_ISR();
   }
 }
 
-static void handleContFrame(const struct can_frame &frm) {
-  if (!assembling) {
-    Serial.println("Unexpected continuation (no assembly in progress)");
-    return;
+static void rxTask(void *) {
+  while (true) {
+    // The timeout is only a safety net in case an edge is ever missed
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+    // INT is level-triggered on the chip: keep draining while it is held low
+    do {
+      lockSpi();
+      drainReceiveBuffers();
+      unlockSpi();
+    } while (digitalRead(CAN_INT_PIN) == LOW);
   }
-  if (frm.can_dlc < 2) {
-    Serial.println("Continuation frame too short");
-    resetAssembly();
-    return;
+}
+
+static void startInterruptReceive() {
+  pinMode(CAN_INT_PIN, INPUT_PULLUP);
+  spiLock = xSemaphoreCreateMutex();
+  xTaskCreatePinnedToCore(rxTask, "can_rx", 4096, nullptr, 3, &rxTaskHandle, 1);
+  attachInterrupt(digitalPinToInterrupt(CAN_INT_PIN), onCanInterrupt, FALLING);
+  Serial.print("✓ Interrupt-driven receive on GPIO "); Serial.println(CAN_INT_PIN);
+}
+#endif // RX_POLLING
+
+static void reportReceiveCounters() {
+  static uint32_t lastReportMs = 0;
+  static uint32_t reportedOverflows = 0;
+  static uint32_t reportedRingDrops = 0;
+  const uint32_t now = millis();
+  if (now - lastReportMs < 1000) return;
+  lastReportMs = now;
+
+  static uint32_t reportedDelivered = 0;
+  const uint32_t delivered = countGet(framesDelivered);
+  if (delivered != reportedDelivered) {
+    reportedDelivered = delivered;
+    const uint32_t spi = countGet(spiTransactions);
+    Serial.print("RX frames delivered: "); Serial.print(delivered);
+    Serial.print(", foreign: "); Serial.print(countGet(framesForeign));
+    Serial.print(", SPI transactions: "); Serial.print(spi);
+    Serial.print(" ("); Serial.print((float)spi / delivered, 2); Serial.println(" per delivered frame)");
   }
-  uint8_t seq = frm.data[1];
-  if (seq != nextSeq) {
-    Serial.print("Sequence mismatch. Expected "); Serial.print(nextSeq); Serial.print(" got "); Serial.println(seq);
-    resetAssembly();
-    return;
+
+  const uint32_t overflows = countGet(counters.rxOverflows);
+  const uint32_t ringDrops = rxRing.overflows();
+  if (overflows != reportedOverflows || ringDrops != reportedRingDrops) {
+    reportedOverflows = overflows;
+    reportedRingDrops = ringDrops;
+    Serial.print("RX overflow events: "); Serial.print(overflows);
+    Serial.print(" (frames read: "); Serial.print(countGet(counters.framesRx));
+    Serial.print(", ring drops: "); Serial.print(ringDrops);
+    Serial.print(", ring high-water: "); Serial.print(rxRing.highWater());
+    Serial.print("/"); Serial.print(rxRing.capacity()); Serial.println(")");
+  }
+
+  static uint32_t reportedEvicted = 0, reportedAborted = 0, reportedDropped = 0;
+  const ReassemblyStats &rs = reassembler.stats();
+  if (rs.evicted != reportedEvicted || rs.aborted != reportedAborted || rs.dropped != reportedDropped) {
+    reportedEvicted = rs.evicted;
+    reportedAborted = rs.aborted;
+    reportedDropped = rs.dropped;
+    Serial.print("Reassembly sessions: "); Serial.print(rs.opened); Serial.print(" opened, ");
+    Serial.print(rs.completed); Serial.print(" completed, ");
+    Serial.print(rs.evicted); Serial.print(" evicted, ");
+    Serial.print(rs.aborted); Serial.print(" aborted, ");
+    Serial.print(rs.dropped); Serial.print(" dropped, ");
+    Serial.print(reassembler.activeSessions()); Serial.println(" active");
   }
-  nextSeq++;
-  uint8_t payload = frm.can_dlc - 2;
-  for (uint8_t i = 0; i < payload && receivedLen < expectedLen; ++i) {
-    buffer[receivedLen++] = frm.data[2 + i];
+}
+
+#ifdef RX_SNIFFER
+struct BusLoadReport {
+  float last1s, last10s, last60s, peak1s;
+};
+
+static BusLoadReport readBusLoad() {
+  BusLoadReport r;
+  lockSpi();
+  busLoad.advance(micros()); // idle seconds count too
+  r.last1s = busLoad.load(1);
+  r.last10s = busLoad.load(10);
+  r.last60s = busLoad.load(60);
+  r.peak1s = busLoad.peak(60);
+  unlockSpi();
+  return r;
+}
+
+// One line per second while frames arrive: bus load windows, frame rate, IDs seen
+static void reportSniffer() {
+  static uint32_t lastReportMs = 0;
+  static uint32_t reportedFrames = 0;
+  const uint32_t now = millis();
+  if (now - lastReportMs < SNIFF_REPORT_MS) return;
+  const uint32_t frames = countGet(counters.framesRx);
+  const float perSec = (frames - reportedFrames) * 1000.0f / (now - lastReportMs);
+  lastReportMs = now;
+  if (frames == reportedFrames) return;
+  reportedFrames = frames;
+  const BusLoadReport load = readBusLoad();
+  Serial.print("Bus load 1s "); Serial.print(100 * load.last1s, 1);
+  Serial.print("%, 10s "); Serial.print(100 * load.last10s, 1);
+  Serial.print("%, 60s "); Serial.print(100 * load.last60s, 1);
+  Serial.print("% (peak "); Serial.print(100 * load.peak1s, 1);
+  Serial.print("%) | "); Serial.print(perSec, 0);
+  Serial.print(" frames/s | "); Serial.print(idStats.ids()); Serial.print(" IDs");
+  if (idStats.untracked()) { Serial.print(", "); Serial.print(idStats.untracked()); Serial.print(" untracked frames"); }
+  Serial.println();
+}
+
+// "ids": per-ID table, sorted by ID, printed from a copy so the RX side only waits for memcpy
+static void printIds() {
+  static IdStatsTable<SNIFF_ID_SLOTS> snapshot;
+  static const IdStats *order[SNIFF_ID_SLOTS];
+  lockSpi();
+  snapshot = idStats;
+  unlockSpi();
+  uint16_t n = 0;
+  snapshot.forEach([&](const IdStats &s) {
+    uint16_t i = n++;
+    while (i > 0 && order[i - 1]->key > s.key) {
+      order[i] = order[i - 1];
+      i--;
+    }
+    order[i] = &s;
+  });
+  char line[112];
+  snprintf(line, sizeof(line), "%-10s %9s %10s %8s %9s %9s %9s %9s", "id", "frames", "bytes", "rate/s", "avg ms",
+           "min ms", "max ms", "jitter ms");
+  Serial.println(line);
+  for (uint16_t k = 0; k < n; ++k) {
+    const IdStats &s = *order[k];
+    const uint32_t spanUs = s.lastUs - s.firstUs;
+    const bool gaps = s.frames > 1;
+    snprintf(line, sizeof(line), (s.key & CAN_EFF_FLAG) ? "%08lX   %9lu %10lu %8.1f %9.3f %9.3f %9.3f %9.3f"
+                                                        : "%03lX        %9lu %10lu %8.1f %9.3f %9.3f %9.3f %9.3f",
+             (unsigned long)(s.key & CAN_EFF_MASK), (unsigned long)s.frames, (unsigned long)s.bytes,
+             spanUs ? (s.frames - 1) * 1e6f / spanUs : 0.0f, gaps ? s.avgGapUs() / 1000.0f : 0.0f,
+             gaps ? s.minGapUs / 1000.0f : 0.0f, s.maxGapUs / 1000.0f, s.jitterUs() / 1000.0f);
+    Serial.println(line);
+  }
+  Serial.print(n); Serial.print(" IDs, "); Serial.print(snapshot.untracked()); Serial.println(" untracked frames");
+}
+#endif // RX_SNIFFER
+
+// "stats": every counter as one JSON line
+static void printStats() {
+  char line[1024];
+  JsonLine j(line, sizeof(line));
+#ifdef RX_SNIFFER
+  const BusLoadReport load = readBusLoad();
+  j.add("role", "sniffer").add("uptime_ms", (uint32_t)millis());
+  j.add("bus_load_1s_permille", (uint32_t)(1000 * load.last1s))
+   .add("bus_load_10s_permille", (uint32_t)(1000 * load.last10s))
+   .add("bus_load_60s_permille", (uint32_t)(1000 * load.last60s))
+   .add("ids", (uint32_t)idStats.ids())
+   .add("untracked_frames", idStats.untracked());
+#else
+  j.add("role", "receiver").add("id", (uint32_t)RECEIVER_ID).add("uptime_ms", (uint32_t)millis());
+#endif
+  addCounters(j, counters);
+  const asynclog::LogStats ls = asynclog::logger().stats();
+  j.add("spi_transactions", countGet(spiTransactions)).add("log_dropped", ls.dropped + ls.rateLimited);
+#ifndef RX_SNIFFER
+  const ReassemblyStats &rs = reassembler.stats();
+  j.add("frames_delivered", countGet(framesDelivered))
+   .add("frames_foreign", countGet(framesForeign))
+   .add("ring_drops", rxRing.overflows())
+   .add("ring_high_water", rxRing.highWater())
+   .add("sessions_opened", rs.opened)
+   .add("sessions_completed", rs.completed)
+   .add("sessions_evicted", rs.evicted)
+   .add("sessions_aborted", rs.aborted)
+   .add("sessions_dropped", rs.dropped);
+  const ResumeStats &res = reassembler.resumeStats();
+  j.add("nacks", res.nacks)
+   .add("resumes", res.resumes)
+   .add("resume_stale", res.stale)
+   .add("confirmed", res.confirmed)
+   .add("acks", res.acks)
+   .add("duplicates", res.duplicates)
+   .add("decompressed", messagesDecompressed)
+   .add("decompress_saved_bytes", decompressSavedBytes)
+   .add("crc_failures", crcFailures)
+   .add("fec_rebuilt", res.rebuilt)
+   .add("fec_failures", fecFailures);
+#endif
+  Serial.println(j.finish());
+}
+
+#if PROFILE
+static void printLine(const char *s) { Serial.println(s); }
+#endif
+
+#if RX_CAPTURE_BYTES
+// Capture is paused while printing (Serial is slow); frames meanwhile count as skipped.
+// PCAP bytes go out as "PCAP <hex>" lines so log output can't corrupt them:
+//   grep '^PCAP ' monitor.log | cut -c6- | xxd -r -p > capture.pcap
+static void dumpCapture(bool pcap) {
+  captureRing.freeze();
+  const CaptureStats st = captureRing.stats();
+  Serial.print("--- capture: "); Serial.print(captureRing.count()); Serial.print(" frames, ");
+  Serial.print(st.overwritten); Serial.print(" overwritten, ");
+  Serial.print(st.skipped); Serial.println(" skipped ---");
+  char line[2 * capture::PCAP_RECORD_LEN + 8];
+  if (pcap) {
+    uint8_t bytes[capture::PCAP_RECORD_LEN];
+    capture::pcapGlobalHeader(bytes);
+    int n = snprintf(line, sizeof(line), "PCAP ");
+    for (uint8_t i = 0; i < capture::PCAP_GLOBAL_HEADER_LEN; ++i) n += snprintf(line + n, sizeof(line) - n, "%02X", bytes[i]);
+    Serial.println(line);
+    captureRing.forEach([&](uint64_t ts, const struct can_frame &frm) {
+      capture::pcapRecord(bytes, ts, frm);
+      int k = snprintf(line, sizeof(line), "PCAP ");
+      for (uint8_t i = 0; i < capture::PCAP_RECORD_LEN; ++i) k += snprintf(line + k, sizeof(line) - k, "%02X", bytes[i]);
+      Serial.println(line);
+    });
+  } else {
+    captureRing.forEach([&](uint64_t ts, const struct can_frame &frm) {
+      capture::candumpLine(line, sizeof(line), ts, frm);
+      Serial.println(line);
+    });
   }
-  Serial.print("Added chunk seq="); Serial.print(seq); Serial.print(" size="); Serial.print(payload); Serial.print(" progress="); Serial.print(receivedLen); Serial.print("/"); Serial.println(expectedLen);
+  captureRing.thaw();
+  Serial.println("--- end of capture ---");
+}
+#endif
 
-  if (receivedLen >= expectedLen) {
-    buffer[receivedLen] = '\0';
-    Serial.println("\n┌─────────────────────────────────");
-    Serial.print("│ Receiver #"); Serial.print(RECEIVER_ID); Serial.println(" - Message Received:");
-    Serial.print("│ Length: "); Serial.print(expectedLen); Serial.println(" bytes");
-    Serial.println("├─────────────────────────────────");
-    Serial.print("│ "); Serial.println((char*)buffer);
-    Serial.println("└─────────────────────────────────\n");
-    resetAssembly();
+// Serial commands, read without blocking so loop() keeps draining the ring
+static void pollSerialCommand() {
+  static char cmd[16];
+  static uint8_t len = 0;
+  while (Serial.available()) {
+    const char c = (char)Serial.read();
+    if (c != '\n' && c != '\r') {
+      if (len < sizeof(cmd) - 1) cmd[len++] = c;
+      continue;
+    }
+    if (len == 0) continue;
+    cmd[len] = '\0';
+    len = 0;
+    if (strcmp(cmd, "stats") == 0) {
+      printStats();
+#ifdef RX_SNIFFER
+    } else if (strcmp(cmd, "ids") == 0) {
+      printIds();
+    } else if (strcmp(cmd, "ids reset") == 0) {
+      lockSpi();
+      idStats.clear();
+      unlockSpi();
+      Serial.println("✓ Per-ID statistics reset");
+#endif
+#if RX_CAPTURE_BYTES
+    } else if (strcmp(cmd, "capture") == 0) {
+      dumpCapture(false);
+    } else if (strcmp(cmd, "capture pcap") == 0) {
+      dumpCapture(true);
+    } else if (strcmp(cmd, "capture clear") == 0) {
+      captureRing.freeze();
+      captureRing.clear();
+      captureRing.thaw();
+      Serial.println("✓ Capture cleared");
+#endif
+#if PROFILE
+    } else if (strcmp(cmd, "profile") == 0) {
+      profiler::dump(printLine);
+    } else if (strcmp(cmd, "profile reset") == 0) {
+      profiler::reset();
+      Serial.println("✓ Profile probes reset");
+#else
+    } else if (strncmp(cmd, "profile", 7) == 0) {
+      Serial.println("⚠ Profiling not built in (add -D PROFILE=1 to build_flags)");
+#endif
+    } else {
+      Serial.print("Unknown command: "); Serial.println(cmd);
+    }
   }
 }
 
@@ -120,8 +738,19 @@ void setup() {
   while (!Serial) { ; }
   delay(600);
   Serial.println();
+#ifdef RX_SNIFFER
+  Serial.println("=== CAN Sniffer (listen-only) ===");
+#else
   Serial.print("=== CAN Receiver #"); Serial.print(RECEIVER_ID); Serial.println(" ===");
   Serial.print("Listening on CAN ID 0x"); Serial.println((CAN_BASE_ID + RECEIVER_ID), HEX);
+#endif
+  asynclog::startSerialTask();
+#ifndef RX_SNIFFER
+  reassembler.setNackTimeoutUs(RX_NACK_TIMEOUT_MS * 1000UL);
+  reassembler.setAckEvery(RX_ACK_EVERY);
+  reassembler.setAckDelayUs(RX_ACK_DELAY_US);
+  reassembler.setDictionary(&MESSAGE_DICT);
+#endif
 
   SPI.begin();
   
@@ -143,38 +772,83 @@ void setup() {
     }
   }
   
+#if RX_HW_FILTER
+  // Filters can only be written in configuration mode, i.e. before setNormalMode()
+  if (configureAcceptanceFilters()) {
+    Serial.print("✓ Acceptance filters: 0x"); Serial.print(CAN_BASE_ID + RECEIVER_ID, HEX);
+    Serial.print(" + broadcast 0x"); Serial.print(CAN_BROADCAST_ID, HEX);
+    Serial.print(", groups 0x"); Serial.print(CAN_BASE_ID + canframing::STD_GROUP_OFFSET, HEX);
+    Serial.print("|mask & 0x"); Serial.print(canframing::receiverBit(RECEIVER_ID), HEX);
+    Serial.println(", extended groups");
+  } else {
+    Serial.println("✗ Error programming acceptance filters!");
+  }
+#else
+  Serial.println("⚠ Hardware filters disabled (RX_HW_FILTER=0), accepting all IDs");
+#endif
+
+#ifdef RX_SNIFFER
+  // Never drives the bus: no ACKs, no error frames, so it can't disturb what it measures
+  result = mcp2515.setListenOnlyMode();
+  if (result == MCP2515::ERROR_OK) {
+    Serial.println("✓ MCP2515 in Listen-only mode");
+  } else {
+    Serial.println("✗ Error setting Listen-only mode!");
+  }
+#else
   result = mcp2515.setNormalMode();
   if (result == MCP2515::ERROR_OK) {
     Serial.println("✓ MCP2515 in Normal mode");
   } else {
     Serial.println("✗ Error setting Normal mode!");
   }
+#endif
   
+#ifndef RX_POLLING
+  startInterruptReceive();
+#else
+  Serial.println("✓ Polling receive (RX_POLLING)");
+#endif
+
   Serial.println("\nDiagnostics:");
   Serial.println("- Verify 120Ω termination resistor on this receiver");
   Serial.println("- Check SPI wiring: CS=GPIO5, MOSI=23, MISO=19, SCK=18");
+  Serial.println("Type 'stats' for counters as JSON, 'profile' for hot-path timings, 'capture' for recent frames");
+#ifdef RX_SNIFFER
+  Serial.println("Type 'ids' for per-ID statistics, 'ids reset' to clear them");
+  Serial.println("Ready. Sniffing...\n");
+#else
   Serial.println("Ready. Waiting for messages...\n");
+#endif
 }
 
 void loop() {
   struct can_frame rx;
-  if (mcp2515.readMessage(&rx) == MCP2515::ERROR_OK) {
-    // Filter by our target ID
-    if (rx.can_id != (CAN_BASE_ID + RECEIVER_ID)) {
-      // Not for us; could log lightly
-      return;
-    }
-
-    uint8_t magic = rx.data[0];
-    if (magic == FRAME_MAGIC_START) {
-      handleStartFrame(rx);
-    } else if (magic == FRAME_MAGIC_CONT) {
-      handleContFrame(rx);
-    } else {
-      Serial.print("Unknown frame magic 0x"); Serial.println(magic, HEX);
-    }
+#ifdef RX_POLLING
+  // No INT task: poll between frames too and never sleep, RXB0/RXB1 hold two frames,
+  // about 0.5 ms at line rate
+  drainReceiveBuffers();
+  while (rxHal.receiveFrame(rx)) {
+    processFrame(rx);
+    drainReceiveBuffers();
+  }
+#else
+  bool idle = true;
+  while (rxHal.receiveFrame(rx)) {
+    processFrame(rx);
+    idle = false;
   }
-  delay(5);
+#endif
+  reassembler.expire();
+  reportReceiveCounters();
+#ifdef RX_SNIFFER
+  reportSniffer();
+#endif
+  pollSerialCommand();
+
+#ifndef RX_POLLING
+  if (idle) delay(1);
+#endif
 }
 
 #endif // ROLE_RECEIVER
@@ -1,19 +1,60 @@
 #ifdef ROLE_SENDER
 /*
  * CAN Bus Sender with Multi-Receiver Targeting and Segmentation
- * - Choose target receiver (1..5) at runtime via Serial
+ * - Choose target receiver (1..5), a group (e.g. "1,3,5") or "all" at runtime via Serial
  * - Send messages of any length by splitting across multiple CAN frames
  *
  * Protocol (standard 11-bit CAN IDs):
- * - CAN ID: 0x200 + targetId (1..5)
- * - Start frame: [0]=0xAA, [1]=lenLow, [2]=lenHigh, [3]=seq(0), [4..]=payload (up to 4 bytes)
- * - Cont frame:  [0]=0xCC, [1]=seq(1..), [2..]=payload (up to 6 bytes)
+ * - CAN ID: 0x200 + targetId (1..5), 0x200 = broadcast, 0x220 | mask = group
+ *   (one transmission reaches every receiver in the group)
+ * - Compact framing (default): one PCI byte per frame, see lib/CanFraming
+ *   Start frame: [0]=0x40, [1]=lenLow, [2]=lenHigh, [3..]=payload (up to 5 bytes)
+ *   Cont frame:  [0]=0x50|(seq&0x0F), [1..]=payload (up to 7 bytes)
+ * - Extended-ID framing (selectable per target with "extended <id>"): 29-bit ID carries
+ *   prio|type|dest|src|msgId|seq, start frame [0..1]=len + 6 payload bytes, data frames 8
+ * - Legacy framing (selectable per target with "legacy <id>"):
+ *   Start frame: [0]=0xAA, [1]=lenLow, [2]=lenHigh, [3]=seq(0), [4..]=payload (up to 4 bytes)
+ *   Cont frame:  [0]=0xCC, [1]=seq(1..), [2..]=payload (up to 6 bytes)
  * - Complete when receiver collects totalLen bytes
+ * - Window (unicast, TX_WINDOW > 0, the default): up to TX_WINDOW frames unacknowledged;
+ *   the receiver ACKs on 0x180 + targetId with a bitmap and we retransmit only the gaps,
+ *   or everything unacknowledged after TX_RTO_MS. Success means the receiver's DONE.
+ * - Compression (TX_COMPRESS): typed messages that shrink under LZSS (lib/Lzss) go out
+ *   compressed with START_FLAG_COMPRESSED; the receiver decompresses while reassembling.
+ *   Short ones are coded against the pre-shared include/MessageDictionary.h when that
+ *   is shorter (see src/dicttool.cpp)
+ * - CRC (TX_CRC): every message ends in a CRC-32 trailer (START_FLAG_CRC), computed as
+ *   the segmenter copies bytes into frames; receivers drop a message that doesn't match
+ * - FEC (TX_FEC, per target with "fec <K> <id>"): a parity frame after every K
+ *   continuation frames lets receivers rebuild one lost frame per group without a round
+ *   trip; such messages are neither windowed nor resumed
+ * - Resume (unicast, TX_WINDOW=0 and TX_RESUME_WINDOW_MS > 0): the receiver NACKs a gap
+ *   on 0x180 + targetId and we re-send from the sequence it names; after the last frame
+ *   we wait up to the window for its DONE (receivers without resume never send one)
+ * - Priority classes (lib/CanTransport/CanScheduler.h): messages of TX_BULK_MIN bytes or
+ *   more go out as bulk (IDs 0x401..), shorter ones as normal (0x201..). "!<target> <text>"
+ *   sends an urgent message (0x001..); typed while a transfer runs, its frames go out
+ *   between the transfer's, behind at most the frames already in the TX buffers
+ *
+ * ISO-TP mode (-D CAN_TRANSPORT_ISOTP): ISO 15765-2 SF/FF/CF on 0x200 + targetId,
+ * pacing driven by the receiver's flow control (BlockSize, STmin) on 0x280 + targetId
  */
 
 #include <Arduino.h>
 #include <SPI.h>
 #include <mcp2515.h>
+#include <CanPacer.h>
+#include <CanFraming.h>
+#include <CanSegmenter.h>
+#include <CanScheduler.h>
+#include <CanStats.h>
+#include <Profiler.h>
+#include <Lzss.h>
+#include <Crc32.h>
+#include <MessageDictionary.h>
+#ifdef CAN_TRANSPORT_ISOTP
+#include <IsoTp.h>
+#endif
 
 // MCP2515 Pinout for ESP32 Pico Kit v4.1
 // CS   -> GPIO 5
@@ -23,89 +64,345 @@
 
 #define CAN_CS_PIN 5
 static const uint16_t CAN_BASE_ID = 0x200; // IDs 0x201..0x205
+static const uint16_t CAN_ISOTP_RESPONSE_BASE = 0x280; // ISO-TP flow control from receivers
+
+// Framing used for targets that haven't been switched with "legacy"/"compact"
+#ifndef FRAMING_DEFAULT
+#define FRAMING_DEFAULT canframing::FRAMING_COMPACT
+#endif
+
+// Source address used in extended-ID frames
+#ifndef SENDER_ID
+#define SENDER_ID 16
+#endif
 
-static const uint8_t FRAME_MAGIC_START = 0xAA;
-static const uint8_t FRAME_MAGIC_CONT  = 0xCC;
+static canframing::Framing targetFraming[6] = {
+  FRAMING_DEFAULT, FRAMING_DEFAULT, FRAMING_DEFAULT,
+  FRAMING_DEFAULT, FRAMING_DEFAULT, FRAMING_DEFAULT,
+};
 
 MCP2515 mcp2515(CAN_CS_PIN);
 
+// Minimum gap between frame loads (0 = as fast as the TX buffers drain). A receiver
+// that sleeps between polls of the MCP2515 takes about one frame per poll; build the
+// sender with e.g. TX_MIN_GAP_US=5000 for one. ISO-TP paces itself from STmin.
+#ifndef TX_MIN_GAP_US
+#define TX_MIN_GAP_US 0
+#endif
+
+// How long a frame may wait for a usable TX buffer before giving up
+#ifndef TX_TIMEOUT_US
+#define TX_TIMEOUT_US 250000
+#endif
+
+// How long a unicast message waits for the receiver's DONE (and takes NACKs) after
+// its last frame; 0 = fire and forget, as before resume existed
+#ifndef TX_RESUME_WINDOW_MS
+#define TX_RESUME_WINDOW_MS 50
+#endif
+
+// Frames a unicast message may have unacknowledged (0 = no ACK window; compact framing
+// caps it at 8), and how long without an ACK before they are all sent again. Receivers
+// should ACK at least every TX_WINDOW / 2 frames (RX_ACK_EVERY).
+#ifndef TX_WINDOW
+#define TX_WINDOW 8
+#endif
+#ifndef TX_RTO_MS
+#define TX_RTO_MS 20
+#endif
+
+// Receivers' MAX_MESSAGE: a message's bytes on the wire (CRC trailer and FEC group byte
+// included) must fit that reassembly buffer, or they drop it as too long
+#ifndef TX_MAX_MESSAGE
+#define TX_MAX_MESSAGE 2048
+#endif
+
+// Compress typed messages when that makes them shorter (0 = always send them as typed).
+// Receivers decompress in place, so a compressed message must fit their MAX_MESSAGE
+// buffer together with lzss::fitsInPlace()'s margin; TX_COMPRESS_MAX is that buffer.
+#ifndef TX_COMPRESS
+#define TX_COMPRESS 1
+#endif
+#ifndef TX_COMPRESS_MAX
+#define TX_COMPRESS_MAX TX_MAX_MESSAGE
+#endif
+
+// Append a CRC-32 trailer (START_FLAG_CRC) so receivers verify what they reassembled;
+// 0 for receivers built before it
+#ifndef TX_CRC
+#define TX_CRC 1
+#endif
+
+// Continuation frames per XOR parity frame for targets not set with "fec" (0 = no FEC,
+// otherwise canframing::FEC_GROUP_MIN..MAX); receivers built before it drop such messages
+#ifndef TX_FEC
+#define TX_FEC 0
+#endif
+
+static uint8_t targetFec[6] = {TX_FEC, TX_FEC, TX_FEC, TX_FEC, TX_FEC, TX_FEC};
+
+// Messages (as sent, after compression) of at least this many bytes go in the bulk class
+#ifndef TX_BULK_MIN
+#define TX_BULK_MIN 256
+#endif
+
+// Longest urgent message ("!<target> <text>"), kept short so it stays a frame or two
+#ifndef TX_URGENT_MAX
+#define TX_URGENT_MAX 64
+#endif
+
+// Adapts the MCP2515 driver to CanPacer: TXREQ bits come from the READ STATUS
+// instruction (bit 2 = TXB0, bit 4 = TXB1, bit 6 = TXB2).
+struct Mcp2515TxDriver {
+  uint8_t txPendingMask() {
+    const uint8_t s = mcp2515.getStatus();
+    return ((s >> 2) & 0x01) | ((s >> 3) & 0x02) | ((s >> 4) & 0x04);
+  }
+  bool loadTxBuffer(uint8_t n, const struct can_frame &frm) {
+    MCP2515::ERROR r = mcp2515.sendMessage((MCP2515::TXBn)n, &frm);
+    // ERROR_FAILTX only reflects MLOA/TXERR left over on the buffer; the chip
+    // keeps TXREQ set and retries on its own, so the frame is still queued.
+    return r == MCP2515::ERROR_OK || r == MCP2515::ERROR_FAILTX;
+  }
+  uint32_t micros() { return ::micros(); }
+  void idle() { delayMicroseconds(20); }
+};
+
+static Mcp2515TxDriver txDriver;
+static CanPacer<Mcp2515TxDriver> pacer(txDriver, TX_MIN_GAP_US, TX_TIMEOUT_US);
+
+// Lock-free counters for the "stats" command, see lib/CanStats
+static CanCounters counters;
+
+// Bytes and time (first frame to DONE) of confirmed messages, for goodput in "stats"
+static uint32_t confirmedBytes = 0;
+static uint32_t confirmedUs = 0;
+
+// Messages sent compressed (of them, against the dictionary), and the bytes that saved
+static uint32_t compressedMessages = 0;
+static uint32_t dictionaryMessages = 0;
+static uint32_t compressedSavedBytes = 0;
+
 static bool sendFrame(const struct can_frame &frm) {
-  // Retry logic to handle TX busy
-  const int maxRetries = 50;
-  for (int attempt = 0; attempt < maxRetries; ++attempt) {
-    MCP2515::ERROR r = mcp2515.sendMessage(const_cast<struct can_frame*>(&frm));
-    
-    if (r == MCP2515::ERROR_OK) {
-      return true;
+  PROFILE_SCOPE("tx.sendFrame");
+  const CanPacerStats before = pacer.stats();
+  const bool ok = pacer.send(frm);
+  countAdd(counters.txBusyRetries, pacer.stats().busyPolls - before.busyPolls);
+  if (ok) {
+    countAdd(counters.framesTx);
+    return true;
+  }
+  if (pacer.stats().timeouts != before.timeouts) {
+    countAdd(counters.txTimeouts);
+    Serial.println("✗ Send failed: TX buffers busy (timeout)");
+  } else {
+    Serial.println("✗ Send failed: could not load TX buffer");
+  }
+  return false;
+}
+
+// CanSegmenter HAL: frames go out through the pacer, replies (ISO-TP flow control)
+// are read straight from the MCP2515
+struct SenderHal {
+  bool sendFrame(const struct can_frame &frm) { return ::sendFrame(frm); }
+  bool receiveFrame(struct can_frame &frm) {
+    PROFILE_SCOPE("tx.readMessage");
+    if (mcp2515.readMessage(&frm) != MCP2515::ERROR_OK) return false;
+    countAdd(counters.framesRx);
+    return true;
+  }
+  uint32_t micros() { return ::micros(); }
+};
+
+static SenderHal txHal;
+static CanScheduler<SenderHal> scheduler(txHal, CAN_BASE_ID, SENDER_ID);
+
+#ifdef CAN_TRANSPORT_ISOTP
+static IsoTpSender isoTx;
+
+static bool sendIsoTpTo(uint8_t targetId, const uint8_t* data, uint16_t len) {
+  if (len > isotp::MAX_LEN) {
+    Serial.println("Message too long for ISO-TP (max 4095 bytes)");
+    return false;
+  }
+
+  const uint32_t responseId = CAN_ISOTP_RESPONSE_BASE + targetId;
+  struct can_frame tx;
+  tx.can_id = CAN_BASE_ID + targetId;
+  isoTx.start(data, len, micros());
+
+  while (true) {
+    // Flow control from the receiver decides when the next block may go out
+    struct can_frame rx;
+    while (txHal.receiveFrame(rx)) {
+      if (rx.can_id == responseId) {
+        isoTx.onFlowControl(rx, micros());
+      }
     }
-    
-    if (r == MCP2515::ERROR_ALLTXBUSY) {
-      // Wait a bit and retry
-      delay(5);
+
+    switch (isoTx.poll(micros(), tx)) {
+      case IsoTpSender::FRAME:
+        if (!sendFrame(tx)) return false;
+        break;
+      case IsoTpSender::WAIT:
+        break;
+      case IsoTpSender::DONE:
+        if (!pacer.flush()) {
+          countAdd(counters.txTimeouts);
+          Serial.println("✗ Send failed: TX buffers did not drain (timeout)");
+          return false;
+        }
+        return true;
+      case IsoTpSender::FAILED:
+        Serial.println("✗ ISO-TP transfer aborted (flow control timeout or overflow)");
+        return false;
+    }
+  }
+}
+#endif // CAN_TRANSPORT_ISOTP
+
+// Longest message the targets in targetMask can reassemble
+static uint16_t receiverRoom(uint8_t targetMask) {
+#ifdef CAN_TRANSPORT_ISOTP
+  (void)targetMask;
+  return isotp::MAX_LEN;
+#else
+  return TX_MAX_MESSAGE - (TX_CRC ? canframing::CRC_LEN : 0) -
+         (targetFec[canframing::firstReceiver(targetMask)] ? 1 : 0);
+#endif
+}
+
+static uint8_t parseTargetMask(const String &s);
+
+// Urgent message typed during a transfer: the line so far, and the message in flight
+static String urgentInput;
+static uint8_t urgentBuf[TX_URGENT_MAX];
+static uint32_t urgentStartUs = 0;
+static bool urgentReported = true;
+
+// "!<target> <text>": the target mask, with the text copied to urgentBuf; 0 if not one
+static uint8_t parseUrgent(const String &line, uint16_t &len) {
+  if (!line.startsWith("!")) return 0;
+  const int space = line.indexOf(' ');
+  if (space < 0) return 0;
+  const uint8_t mask = parseTargetMask(line.substring(1, space));
+  const String text = line.substring(space + 1);
+  if (mask == 0 || text.length() == 0) return 0;
+  len = text.length() < TX_URGENT_MAX ? (uint16_t)text.length() : (uint16_t)TX_URGENT_MAX;
+  memcpy(urgentBuf, text.c_str(), len);
+  return mask;
+}
+
+// While a transfer runs: read Serial without blocking and start an urgent message once
+// a "!<target> <text>" line is in, then report it when it is through
+static void pollUrgentInput() {
+  if (!scheduler.busy(canframing::PRIO_URGENT) && !urgentReported) {
+    urgentReported = true;
+    Serial.print("✓ Urgent message sent ahead of the transfer in "); Serial.print(micros() - urgentStartUs);
+    Serial.println(" us");
+  }
+  while (Serial.available()) {
+    const char c = Serial.read();
+    if (c != '\n' && c != '\r') {
+      if (isPrintable(c) && urgentInput.length() < TX_URGENT_MAX + 8) urgentInput += c;
       continue;
     }
-    
-    // Other errors are fatal
-    Serial.print("✗ Send failed: ");
-    switch(r) {
-      case MCP2515::ERROR_FAILINIT: Serial.println("Initialization failed"); break;
-      case MCP2515::ERROR_FAILTX: Serial.println("Transmission failed"); break;
-      default: Serial.println("Unknown error"); break;
+    uint16_t len = 0;
+    const uint8_t mask = parseUrgent(urgentInput, len);
+    urgentInput = "";
+    if (mask == 0) continue;
+    if (scheduler.busy(canframing::PRIO_URGENT)) {
+      Serial.println("⚠ Urgent message still in flight, skipped");
+      continue;
     }
-    return false;
+    const uint8_t firstId = canframing::firstReceiver(mask);
+    urgentStartUs = micros();
+    urgentReported = !scheduler.submit(canframing::PRIO_URGENT, mask, targetFraming[firstId], urgentBuf, len);
   }
-  
-  Serial.println("✗ Send failed: TX buffers busy (timeout)");
-  return false;
 }
 
-static bool sendMessageTo(uint8_t targetId, const uint8_t* data, uint16_t len) {
-  if (targetId < 1 || targetId > 5) {
-    Serial.println("Target ID must be 1..5");
+// targetMask: bit n-1 = receiver n; one transmission reaches every receiver in it.
+// payloadFlags: START_FLAG_COMPRESSED when data is an lzss stream. prio: priority
+// class; more urgent messages typed meanwhile go out between this one's frames.
+static bool sendMessageTo(uint8_t targetMask, const uint8_t* data, uint16_t len, uint8_t payloadFlags = 0,
+                          uint8_t prio = canframing::PRIO_NORMAL) {
+  PROFILE_SCOPE("tx.sendMessageTo");
+  if (targetMask == 0 || (targetMask & ~canframing::RECEIVER_MASK_ALL)) {
+    Serial.println("Target must be receivers 1..5");
     return false;
   }
+  const uint8_t firstId = canframing::firstReceiver(targetMask);
 
-  if (len > 65535) {
-    Serial.println("Message too long (max 65535 bytes)");
+#ifdef CAN_TRANSPORT_ISOTP
+  // Flow control is point-to-point: ISO-TP can't address a group
+  if (canframing::maskCount(targetMask) != 1) {
+    Serial.println("ISO-TP mode supports a single target only");
     return false;
   }
+  return sendIsoTpTo(firstId, data, len);
+#endif
 
-  const uint16_t canId = CAN_BASE_ID + targetId;
-  struct can_frame tx;
-  tx.can_id = canId;
-
-  uint8_t seq = 0;
-  uint16_t offset = 0;
-
-  // Start frame
-  const uint8_t firstChunk = (len >= 4) ? 4 : (uint8_t)len;
-  tx.data[0] = FRAME_MAGIC_START;
-  tx.data[1] = (uint8_t)(len & 0xFF);
-  tx.data[2] = (uint8_t)((len >> 8) & 0xFF);
-  tx.data[3] = seq; // 0
-  for (uint8_t i = 0; i < firstChunk; ++i) {
-    tx.data[4 + i] = data[i];
-  }
-  tx.can_dlc = 4 + firstChunk; // 4..8
-  if (!sendFrame(tx)) return false;
-  offset += firstChunk;
-  delay(10); // Give receiver time to process start frame
-
-  // Continuation frames
-  while (offset < len) {
-    seq++;
-    const uint8_t chunk = (len - offset >= 6) ? 6 : (uint8_t)(len - offset);
-    tx.data[0] = FRAME_MAGIC_CONT;
-    tx.data[1] = seq;
-    for (uint8_t i = 0; i < chunk; ++i) {
-      tx.data[2 + i] = data[offset + i];
+  if (len > receiverRoom(targetMask)) {
+    Serial.print("Message too long (receivers take at most "); Serial.print(receiverRoom(targetMask));
+    Serial.println(" bytes)");
+    return false;
+  }
+
+  CanSegmenter<SenderHal> &segmenter = scheduler.segmenter(prio);
+  const CanSegmenter<SenderHal>::Stats before = segmenter.stats();
+  const uint32_t t0 = micros();
+  if (!scheduler.submit(prio, targetMask, targetFraming[firstId], data, len, payloadFlags, targetFec[firstId])) {
+    return false;
+  }
+  urgentInput = "";
+  while (scheduler.busy(prio) || scheduler.busy(canframing::PRIO_URGENT)) {
+    if (scheduler.poll() == CanScheduler<SenderHal>::BLOCKED) {
+      // The pacer gave up on a TX buffer
+      for (uint8_t c = 0; c < canframing::PRIO_CLASSES; ++c) scheduler.cancel(c);
+      urgentReported = true;
+      return false;
     }
-    tx.can_dlc = 2 + chunk; // 2..8
-    if (!sendFrame(tx)) return false;
-    offset += chunk;
-    delay(10); // Increased pacing to prevent TX buffer saturation
+    if (prio != canframing::PRIO_URGENT) pollUrgentInput();
+  }
+  if (prio != canframing::PRIO_URGENT) pollUrgentInput(); // report one that finished last
+  const CanSegmenter<SenderHal>::Stats &after = segmenter.stats();
+  if (after.parity != before.parity) {
+    Serial.print("FEC: "); Serial.print(after.parity - before.parity); Serial.println(" parity frame(s)");
+  }
+  if (after.resumes != before.resumes) {
+    Serial.print("⚠ Receiver NACKed, resumed "); Serial.print(after.resumes - before.resumes); Serial.println(" time(s)");
+  }
+  if (after.retransmits != before.retransmits) {
+    Serial.print("⚠ Retransmitted "); Serial.print(after.retransmits - before.retransmits); Serial.print(" frame(s), ");
+    Serial.print(after.timeouts - before.timeouts); Serial.println(" timeout(s)");
+  }
+  const bool unconfirmed = after.unconfirmed != before.unconfirmed;
+  if (unconfirmed) {
+    Serial.println(segmenter.windowed() ? "⚠ No DONE from receiver (gave up after repeated timeouts)"
+                                        : "⚠ No DONE from receiver within the resume window");
+  }
+  if (segmenter.confirmedDone()) {
+    const uint32_t us = micros() - t0;
+    confirmedBytes += len;
+    confirmedUs += us;
+    Serial.print("✓ Confirmed by receiver #"); Serial.print(firstId); Serial.print(" after "); Serial.print(us);
+    Serial.print(" us");
+    if (us > 0) {
+      Serial.print(", goodput "); Serial.print((uint32_t)((uint64_t)len * 1000000ULL / us)); Serial.print(" B/s");
+    }
+    Serial.println();
   }
 
+  // Don't report success while frames are still sitting in TX buffers
+  if (!pacer.flush()) {
+    countAdd(counters.txTimeouts);
+    Serial.println("✗ Send failed: TX buffers did not drain (timeout)");
+    return false;
+  }
+  // Given up on without DONE: counted in the segmenter's unconfirmed, not as completed
+  if (unconfirmed) return false;
+  countAdd(counters.messagesCompleted);
+  countAdd(counters.bytesDelivered, len);
   return true;
 }
 
@@ -152,14 +449,301 @@ static String readLineWithEcho() {
   }
 }
 
-static int readTargetIdBlocking() {
+// "legacy <id>" / "compact <id>" / "extended <id>" switch the framing used for a target (no id = all targets)
+static bool handleFramingCommand(const String &line) {
+  canframing::Framing f;
+  String rest;
+  if (line.startsWith("legacy")) {
+    f = canframing::FRAMING_LEGACY;
+    rest = line.substring(6);
+  } else if (line.startsWith("extended")) {
+    f = canframing::FRAMING_EXTENDED;
+    rest = line.substring(8);
+  } else if (line.startsWith("compact")) {
+    f = canframing::FRAMING_COMPACT;
+    rest = line.substring(7);
+  } else {
+    return false;
+  }
+
+  const int id = rest.toInt();
+  if (id >= 1 && id <= 5) {
+    targetFraming[id] = f;
+  } else {
+    for (uint8_t i = 1; i <= 5; ++i) targetFraming[i] = f;
+  }
+  Serial.print("Framing for ");
+  if (id >= 1 && id <= 5) { Serial.print("receiver "); Serial.print(id); } else { Serial.print("all receivers"); }
+  switch (f) {
+    case canframing::FRAMING_LEGACY:   Serial.println(": legacy (0xAA/0xCC)"); break;
+    case canframing::FRAMING_COMPACT:  Serial.println(": compact (1-byte PCI)"); break;
+    case canframing::FRAMING_EXTENDED: Serial.println(": extended (29-bit ID header)"); break;
+  }
+  return true;
+}
+
+// "fec <K> <id>" sets the parity group size for a target (no id = all targets, 0 = off)
+static bool handleFecCommand(const String &line) {
+  if (!line.startsWith("fec")) return false;
+  String rest = line.substring(3);
+  rest.trim();
+  const int sp = rest.indexOf(' ');
+  const int k = rest.toInt();
+  const int id = sp > 0 ? rest.substring(sp + 1).toInt() : 0;
+  if (k != 0 && (k < canframing::FEC_GROUP_MIN || k > canframing::FEC_GROUP_MAX)) {
+    Serial.print("FEC group must be 0 (off) or "); Serial.print(canframing::FEC_GROUP_MIN); Serial.print("..");
+    Serial.println(canframing::FEC_GROUP_MAX);
+    return true;
+  }
+  for (uint8_t i = 1; i <= 5; ++i) {
+    if (id < 1 || id > 5 || id == i) targetFec[i] = (uint8_t)k;
+  }
+  Serial.print("FEC for ");
+  if (id >= 1 && id <= 5) { Serial.print("receiver "); Serial.print(id); } else { Serial.print("all receivers"); }
+  if (k) {
+    Serial.print(": one parity frame per "); Serial.print(k); Serial.println(" frames");
+  } else {
+    Serial.println(": off");
+  }
+  return true;
+}
+
+// "3" -> receiver 3, "1,3,5" (or "1 3 5") -> group, "all" or "0" -> broadcast. Returns 0 if invalid.
+static uint8_t parseTargetMask(const String &s) {
+  if (s == "all" || s == "0") return canframing::RECEIVER_MASK_ALL;
+  uint8_t mask = 0;
+  for (unsigned i = 0; i < s.length(); ++i) {
+    const char c = s[i];
+    if (c >= '1' && c <= '5') {
+      mask |= canframing::receiverBit((uint8_t)(c - '0'));
+    } else if (c != ',' && c != ' ') {
+      return 0;
+    }
+  }
+  return mask;
+}
+
+static void printTarget(uint8_t mask) {
+  if (mask == canframing::RECEIVER_MASK_ALL) {
+    Serial.print("all receivers (broadcast)");
+    return;
+  }
+  Serial.print(canframing::maskCount(mask) == 1 ? "receiver " : "receivers ");
+  bool first = true;
+  for (uint8_t id = 1; id <= 5; ++id) {
+    if (!(mask & canframing::receiverBit(id))) continue;
+    if (!first) Serial.print(",");
+    Serial.print(id);
+    first = false;
+  }
+}
+
+#if TX_COMPRESS && !defined(CAN_TRANSPORT_ISOTP)
+static lzss::LzssEncoder encoder;
+static uint8_t packed[TX_COMPRESS_MAX];
+#endif
+
+static uint8_t classFor(uint16_t len) { return len >= TX_BULK_MIN ? canframing::PRIO_BULK : canframing::PRIO_NORMAL; }
+
+// Send a typed message, compressed when that saves bytes (ISO-TP has no flag for it)
+static bool sendTyped(uint8_t targetMask, const uint8_t *data, uint16_t len) {
+#if TX_COMPRESS && !defined(CAN_TRANSPORT_ISOTP)
+  uint16_t n;
+  {
+    PROFILE_SCOPE("tx.compress");
+    // A CRC trailer sits behind the stream in the receiver's buffer, the FEC group byte
+    // before it
+    n = encoder.compressBest(data, len, packed, sizeof(packed), &MESSAGE_DICT,
+                             TX_COMPRESS_MAX - (TX_CRC ? canframing::CRC_LEN : 0) -
+                                 (targetFec[canframing::firstReceiver(targetMask)] ? 1 : 0));
+  }
+  if (n) {
+    const bool dict = lzss::isDictionaryStream(packed);
+    Serial.print("Compressed "); Serial.print(len); Serial.print(" -> "); Serial.print(n);
+    Serial.println(dict ? " bytes (dictionary)" : " bytes");
+    if (!sendMessageTo(targetMask, packed, n, canframing::START_FLAG_COMPRESSED, classFor(n))) return false;
+    compressedMessages++;
+    if (dict) dictionaryMessages++;
+    compressedSavedBytes += len - n;
+    return true;
+  }
+#endif
+  return sendMessageTo(targetMask, data, len, 0, classFor(len));
+}
+
+// "!<target> <text>" at the ID prompt: send it right away in the urgent class
+static bool handleUrgentCommand(const String &line) {
+  uint16_t len = 0;
+  const uint8_t mask = parseUrgent(line, len);
+  if (mask == 0) return false;
+  Serial.print("Sending urgent "); Serial.print(len); Serial.println(" bytes");
+  Serial.println(sendMessageTo(mask, urgentBuf, len, 0, canframing::PRIO_URGENT) ? "✓ Urgent message sent"
+                                                                                    : "✗ Failed to send urgent message");
+  return true;
+}
+
+// "bench <target>": send the benchmark suite's message lengths to a target and print
+// one line per length in bench/baseline.json's format. Timing is sender-side (until
+// the TX buffers drained); CPU time isn't measured on the board, so it prints as null.
+// Lengths the receivers can't reassemble (receiverRoom()) are skipped rather than
+// timed as sent-and-dropped.
+static const uint16_t HW_BENCH_LENGTHS[] = {1, 4, 5, 10, 100, 1534, 2048, 65535};
+static const uint8_t HW_BENCH_REPEATS = 10;
+
+static void sortUs(uint32_t *v, uint8_t n) {
+  for (uint8_t i = 1; i < n; ++i) {
+    const uint32_t x = v[i];
+    int8_t j = i - 1;
+    while (j >= 0 && v[j] > x) {
+      v[j + 1] = v[j];
+      j--;
+    }
+    v[j + 1] = x;
+  }
+}
+
+static bool handleBenchCommand(const String &line) {
+  if (!line.startsWith("bench")) return false;
+  String rest = line.substring(5);
+  rest.trim();
+  const uint8_t mask = parseTargetMask(rest);
+  if (mask == 0) {
+    Serial.println("Usage: bench <target>, e.g. bench 1 or bench all");
+    return true;
+  }
+  const uint16_t room = receiverRoom(mask);
+  uint8_t *payload = (uint8_t *)malloc(room);
+  if (!payload) {
+    Serial.println("✗ Not enough memory for the benchmark payload");
+    return true;
+  }
+  for (uint16_t i = 0; i < room; ++i) payload[i] = (uint8_t)('a' + i % 26);
+
+  for (uint8_t l = 0; l < sizeof(HW_BENCH_LENGTHS) / sizeof(HW_BENCH_LENGTHS[0]); ++l) {
+    const uint16_t len = HW_BENCH_LENGTHS[l];
+    if (len > room) {
+      Serial.printf("- bench len=%u skipped (receivers take at most %u bytes)\n", len, room);
+      continue;
+    }
+    uint32_t us[HW_BENCH_REPEATS];
+    uint32_t totalUs = 0;
+    const uint32_t framesBefore = pacer.stats().frames;
+    uint8_t done = 0;
+    for (; done < HW_BENCH_REPEATS; ++done) {
+      const uint32_t t0 = micros();
+      if (!sendMessageTo(mask, payload, len)) break;
+      us[done] = micros() - t0;
+      totalUs += us[done];
+    }
+    if (done < HW_BENCH_REPEATS || totalUs == 0) {
+      Serial.print("✗ bench len="); Serial.print(len); Serial.println(" failed");
+      continue;
+    }
+    const uint32_t frames = pacer.stats().frames - framesBefore;
+    sortUs(us, HW_BENCH_REPEATS);
+    Serial.printf("{\"name\": \"hw len=%u gap=%u rx=%u\", \"frames_per_sec\": %.1f, \"goodput_bps\": %.1f, "
+                  "\"p50_ms\": %.3f, \"p99_ms\": %.3f, \"cpu_ns_per_frame\": null}\n",
+                  len, (unsigned)TX_MIN_GAP_US, canframing::maskCount(mask), frames * 1e6 / totalUs,
+                  (double)len * HW_BENCH_REPEATS * 1e6 / totalUs, us[HW_BENCH_REPEATS / 2] / 1000.0,
+                  us[HW_BENCH_REPEATS - 1] / 1000.0);
+  }
+  free(payload);
+  return true;
+}
+
+// Error flags (warning/passive/bus-off, failed arbitration is not an error) since the last check
+static void checkBusErrors() {
+  const uint8_t intf = mcp2515.getInterrupts();
+  if (intf & (MCP2515::CANINTF_ERRIF | MCP2515::CANINTF_MERRF)) {
+    countAdd(counters.busErrors);
+    if (intf & MCP2515::CANINTF_ERRIF) mcp2515.clearERRIF();
+    if (intf & MCP2515::CANINTF_MERRF) mcp2515.clearMERR();
+  }
+}
+
+// "stats": every counter as one JSON line
+static bool handleStatsCommand(const String &line) {
+  if (line != "stats") return false;
+  checkBusErrors();
+  char buf[768];
+  JsonLine j(buf, sizeof(buf));
+  j.add("role", "sender").add("id", (uint32_t)SENDER_ID).add("uptime_ms", (uint32_t)millis());
+  addCounters(j, counters);
+  j.add("tx_waits", pacer.stats().waits).add("tx_load_errors", pacer.stats().loadErrors);
+  const CanSegmenter<SenderHal>::Stats ss = scheduler.stats();
+  j.add("resumes", ss.resumes)
+   .add("confirmed", ss.confirmed)
+   .add("unconfirmed", ss.unconfirmed)
+   .add("acks", ss.acks)
+   .add("retransmits", ss.retransmits)
+   .add("rto_expiries", ss.timeouts)
+   .add("rtt_avg_us", ss.rttSamples ? ss.rttTotalUs / ss.rttSamples : 0)
+   .add("rtt_max_us", ss.rttMaxUs)
+   .add("goodput_bps", confirmedUs ? (uint32_t)((uint64_t)confirmedBytes * 1000000ULL / confirmedUs) : 0)
+   .add("compressed", compressedMessages)
+   .add("compressed_dictionary", dictionaryMessages)
+   .add("compress_saved_bytes", compressedSavedBytes);
+  Serial.println(j.finish());
+  return true;
+}
+
+// "crc": CRC-32 cost on this chip, the ROM's crc32_le() (what trailers use) vs the
+// portable one-table loop, and a check that both compute the same CRC
+static bool handleCrcCommand(const String &line) {
+  if (line != "crc") return false;
+  static uint8_t buf[2048];
+  for (uint16_t i = 0; i < sizeof(buf); ++i) buf[i] = (uint8_t)(i * 7 + 3);
+  const uint8_t REPEATS = 16;
+  uint32_t rom = crc32::updateBytewise(0, buf, 1), portable = 0; // builds the table
+  uint32_t t0 = ESP.getCycleCount();
+  for (uint8_t r = 0; r < REPEATS; ++r) rom = crc32::update(0, buf, sizeof(buf));
+  const uint32_t romCycles = ESP.getCycleCount() - t0;
+  t0 = ESP.getCycleCount();
+  for (uint8_t r = 0; r < REPEATS; ++r) portable = crc32::updateBytewise(0, buf, sizeof(buf));
+  const uint32_t portableCycles = ESP.getCycleCount() - t0;
+  Serial.printf("CRC-32 over %u bytes: ROM crc32_le %.2f cycles/byte, one-table loop %.2f cycles/byte\n",
+                (unsigned)sizeof(buf), (double)romCycles / (REPEATS * sizeof(buf)),
+                (double)portableCycles / (REPEATS * sizeof(buf)));
+  const bool ok = rom == portable && crc32::update(0, (const uint8_t *)"123456789", 9) == crc32::CHECK;
+  Serial.println(ok ? "✓ ROM and portable CRC agree" : "✗ ROM CRC differs from the portable one - trailers won't verify");
+  return true;
+}
+
+#if PROFILE
+static void printLine(const char *s) { Serial.println(s); }
+#endif
+
+// "profile" / "profile reset": scoped-timer probes (build with -D PROFILE=1)
+static bool handleProfileCommand(const String &line) {
+  if (line != "profile" && line != "profile reset") return false;
+#if PROFILE
+  if (line == "profile reset") {
+    profiler::reset();
+    Serial.println("✓ Profile probes reset");
+  } else {
+    profiler::dump(printLine);
+  }
+#else
+  Serial.println("⚠ Profiling not built in (add -D PROFILE=1 to build_flags)");
+#endif
+  return true;
+}
+
+static uint8_t readTargetBlocking() {
   while (true) {
-    Serial.print("Enter target ID (1-5): ");
+    Serial.print("Enter target (1-5, group e.g. 1,3,5, or all): ");
     String s = readLineWithEcho();
     if (s.length() == 0) continue;
-    int id = s.toInt();
-    if (id >= 1 && id <= 5) return id;
-    Serial.println("Invalid ID. Please enter a number 1..5.");
+    if (handleFramingCommand(s)) continue;
+    if (handleBenchCommand(s)) continue;
+    if (handleStatsCommand(s)) continue;
+    if (handleProfileCommand(s)) continue;
+    if (handleCrcCommand(s)) continue;
+    if (handleFecCommand(s)) continue;
+    if (handleUrgentCommand(s)) continue;
+    const uint8_t mask = parseTargetMask(s);
+    if (mask != 0) return mask;
+    Serial.println("Invalid target. Enter 1..5, a list like 1,3,5, or all.");
   }
 }
 
@@ -169,8 +753,14 @@ void setup() {
 
   delay(600);
   Serial.println("\n=== CAN Bus Sender ===");
-  Serial.println("- Choose a receiver 1..5");
-  Serial.println("- Type any length message to send\n");
+  Serial.println("- Choose a receiver 1..5, a group like 1,3,5, or all");
+  Serial.println("- Type any length message to send");
+  Serial.println("- Type 'legacy <id>', 'compact <id>' or 'extended <id>' at the ID prompt to switch framing");
+  Serial.println("- Type 'bench <target>' at the ID prompt to run the throughput benchmark on this bus");
+  Serial.println("- Type 'stats' at the ID prompt for counters as JSON, 'profile' for hot-path timings");
+  Serial.println("- Type 'fec <K> <id>' at the ID prompt for a parity frame every K frames (0 = off)");
+  Serial.println("- Type '!<target> <text>' for an urgent message, also while a long one is going out");
+  Serial.println("- Type 'crc' at the ID prompt for the CRC trailer's cost on this chip\n");
 
   SPI.begin();
   
@@ -198,6 +788,11 @@ void setup() {
   } else {
     Serial.println("✗ Error setting Normal mode - check wiring!");
   }
+
+  scheduler.setResumeWindowUs(TX_RESUME_WINDOW_MS * 1000UL);
+  scheduler.setWindow(TX_WINDOW);
+  scheduler.setRtoUs(TX_RTO_MS * 1000UL);
+  scheduler.setChecksum(TX_CRC);
   
   // Optionally test in loopback mode first (for hardware verification)
   // Uncomment the next 3 lines to test without needing a receiver connected:
@@ -213,7 +808,7 @@ void setup() {
 }
 
 void loop() {
-  const int target = readTargetIdBlocking();
+  const uint8_t target = readTargetBlocking();
   Serial.print("Enter message text: ");
   String msg = readLineWithEcho();
 
@@ -225,14 +820,29 @@ void loop() {
     return;
   }
   
-  Serial.print("Sending "); Serial.print(len); Serial.print(" bytes to receiver "); Serial.print(target);
+  Serial.print("Sending "); Serial.print(len); Serial.print(" bytes to "); printTarget(target);
   Serial.print(": \""); Serial.print(msg); Serial.println("\"");
 
-  if (sendMessageTo((uint8_t)target, (const uint8_t*)msg.c_str(), len)) {
-    Serial.println("✓ Message sent successfully\n");
+  const uint32_t framesBefore = pacer.stats().frames;
+  const uint32_t waitsBefore = pacer.stats().waits;
+  const uint32_t t0 = micros();
+  if (sendTyped(target, (const uint8_t*)msg.c_str(), len)) {
+    const uint32_t elapsedUs = micros() - t0;
+    const uint32_t frames = pacer.stats().frames - framesBefore;
+    Serial.print("✓ Message sent successfully ("); Serial.print(frames); Serial.print(" frames in ");
+    Serial.print(elapsedUs); Serial.print(" us");
+    if (elapsedUs > 0) {
+      Serial.print(", "); Serial.print((uint32_t)((uint64_t)frames * 1000000ULL / elapsedUs)); Serial.print(" frames/s");
+    }
+    Serial.print(", buffer waits="); Serial.print(pacer.stats().waits - waitsBefore);
+    if (canframing::maskCount(target) > 1) {
+      Serial.print(", one transmission for "); Serial.print(canframing::maskCount(target)); Serial.print(" receivers");
+    }
+    Serial.println(")\n");
   } else {
     Serial.println("✗ Failed to send message\n");
   }
+  checkBusErrors();
 
   // Allow next command
   delay(100);
@@ -0,0 +1,131 @@
+/*
+ * FrameRing (pio test -e native)
+ * - Single-threaded: capacity, overflow counting and the high-water mark
+ * - Two threads: a producer pushing millions of numbered frames against a consumer,
+ *   which must see every accepted frame exactly once, in order, bytes intact
+ */
+
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <unity.h>
+#include <FrameRing.h>
+
+static const uint32_t STRESS_FRAMES = 4000000;
+
+static struct can_frame numbered(uint32_t i) {
+  struct can_frame f;
+  memset(&f, 0, sizeof(f));
+  f.can_id = i & CAN_EFF_MASK;
+  f.can_dlc = (uint8_t)(i % 9);
+  for (uint8_t b = 0; b < 8; ++b) f.data[b] = (uint8_t)(i >> (b % 4 * 8)) ^ b;
+  return f;
+}
+
+static bool matches(const struct can_frame &f, uint32_t i) {
+  const struct can_frame want = numbered(i);
+  return f.can_id == want.can_id && f.can_dlc == want.can_dlc && memcmp(f.data, want.data, 8) == 0;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_fills_to_capacity_then_counts_overflows(void) {
+  static FrameRing<8> ring;
+  for (uint32_t i = 0; i < 8; ++i) TEST_ASSERT_TRUE(ring.push(numbered(i)));
+  TEST_ASSERT_FALSE(ring.push(numbered(8)));
+  TEST_ASSERT_FALSE(ring.push(numbered(9)));
+  TEST_ASSERT_EQUAL_UINT32(2, ring.overflows());
+  TEST_ASSERT_EQUAL_UINT32(8, ring.size());
+  TEST_ASSERT_EQUAL_UINT32(8, ring.highWater());
+  struct can_frame f;
+  for (uint32_t i = 0; i < 8; ++i) {
+    TEST_ASSERT_TRUE(ring.pop(f));
+    TEST_ASSERT_TRUE(matches(f, i));
+  }
+  TEST_ASSERT_FALSE(ring.pop(f));
+  TEST_ASSERT_EQUAL_UINT32(8, ring.highWater()); // sticks after draining
+}
+
+void test_wraps_around_many_times(void) {
+  static FrameRing<4> ring;
+  struct can_frame f;
+  for (uint32_t i = 0; i < 1000; ++i) {
+    TEST_ASSERT_TRUE(ring.push(numbered(i)));
+    TEST_ASSERT_TRUE(ring.pop(f));
+    TEST_ASSERT_TRUE(matches(f, i));
+  }
+  TEST_ASSERT_EQUAL_UINT32(1, ring.highWater());
+  TEST_ASSERT_EQUAL_UINT32(0, ring.overflows());
+}
+
+// Producer retries a full ring: nothing may be lost or reordered
+void test_two_threads_lossless(void) {
+  static FrameRing<256> ring;
+  std::atomic<uint32_t> bad(0);
+  std::thread consumer([&] {
+    struct can_frame f;
+    for (uint32_t i = 0; i < STRESS_FRAMES;) {
+      if (!ring.pop(f)) {
+        std::this_thread::yield(); // one core: let the producer run
+        continue;
+      }
+      if (!matches(f, i)) bad.fetch_add(1, std::memory_order_relaxed);
+      i++;
+    }
+  });
+  for (uint32_t i = 0; i < STRESS_FRAMES;) {
+    if (ring.push(numbered(i))) {
+      i++;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  consumer.join();
+  TEST_ASSERT_EQUAL_UINT32(0, bad.load());
+  TEST_ASSERT_EQUAL_UINT32(0, ring.size());
+  TEST_ASSERT_LESS_OR_EQUAL(256u, ring.highWater());
+}
+
+// Producer never waits (as in the RX task): frames it could not push are counted as
+// overflows, and every other one arrives once, in order
+void test_two_threads_overflow_accounting(void) {
+  static FrameRing<64> ring;
+  std::atomic<bool> done(false);
+  std::atomic<uint32_t> received(0), bad(0);
+  std::thread consumer([&] {
+    struct can_frame f;
+    uint32_t last = 0;
+    bool first = true;
+    while (true) {
+      if (!ring.pop(f)) {
+        if (done.load(std::memory_order_acquire) && ring.size() == 0) break;
+        std::this_thread::yield();
+        continue;
+      }
+      const uint32_t i = f.can_id;
+      if ((!first && i <= last) || !matches(f, i)) bad.fetch_add(1, std::memory_order_relaxed);
+      last = i;
+      first = false;
+      received.fetch_add(1, std::memory_order_relaxed);
+    }
+  });
+  uint32_t accepted = 0;
+  for (uint32_t i = 0; i < STRESS_FRAMES; ++i) {
+    if (ring.push(numbered(i))) accepted++;
+  }
+  done.store(true, std::memory_order_release);
+  consumer.join();
+  TEST_ASSERT_EQUAL_UINT32(0, bad.load());
+  TEST_ASSERT_EQUAL_UINT32(accepted, received.load());
+  TEST_ASSERT_EQUAL_UINT32(STRESS_FRAMES, accepted + ring.overflows());
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_fills_to_capacity_then_counts_overflows);
+  RUN_TEST(test_wraps_around_many_times);
+  RUN_TEST(test_two_threads_lossless);
+  RUN_TEST(test_two_threads_overflow_accounting);
+  return UNITY_END();
+}
@@ -0,0 +1,120 @@
+/*
+ * ISO-TP sender/receiver over a host loopback (pio test -e native)
+ * - Frames take a 500 kbps frame time on a simulated clock; flow control goes back
+ *   the same way
+ * - 4095-byte messages arrive byte for byte, no faster than STmin allows and within a
+ *   frame time or so per consecutive frame of it; every length 1..4095 round-trips;
+ *   an oversize first frame is refused with FS_OVFLW
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+#include <IsoTp.h>
+
+static const uint32_t FRAME_US = 250; // 8-byte frame at 500 kbps, stuffing included
+
+static uint8_t msg[isotp::MAX_LEN];
+static uint8_t rxBuf[isotp::MAX_LEN];
+
+struct Transfer {
+  bool ok;          // sender DONE and the receiver completed with the same bytes
+  bool refused;     // sender FAILED
+  uint32_t us;      // first frame loaded -> sender DONE
+  uint32_t frames;  // data frames
+  uint32_t fcs;     // flow control frames
+};
+
+static Transfer transfer(uint16_t len, uint16_t rxCapacity, uint8_t blockSize, uint8_t stmin) {
+  IsoTpSender tx;
+  IsoTpReceiver rx(rxBuf, rxCapacity, blockSize, stmin);
+  Transfer t = {false, false, 0, 0, 0};
+  uint32_t now = 0;
+  bool complete = false;
+  if (!tx.start(msg, len, now)) return t;
+  for (uint32_t guard = 0; guard < 10000000; ++guard) {
+    struct can_frame frm, fc;
+    bool sendFc = false;
+    const IsoTpSender::Result r = tx.poll(now, frm);
+    if (r == IsoTpSender::DONE) break;
+    if (r == IsoTpSender::FAILED) {
+      t.refused = true;
+      break;
+    }
+    if (r == IsoTpSender::WAIT) {
+      now += 10;
+      continue;
+    }
+    now += FRAME_US;
+    t.frames++;
+    const IsoTpReceiver::Result rr = rx.onFrame(frm, now, fc, sendFc);
+    if (rr == IsoTpReceiver::COMPLETE) complete = true;
+    if (sendFc) {
+      now += FRAME_US;
+      t.fcs++;
+      tx.onFlowControl(fc, now);
+    }
+  }
+  t.us = now;
+  t.ok = complete && !t.refused && rx.length() == len && memcmp(rx.data(), msg, len) == 0;
+  return t;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Consecutive frames of a block are spaced by STmin (when longer than a frame); the
+// first one after a flow control goes right away
+static void checkStminBound(uint8_t blockSize, uint8_t stmin) {
+  const Transfer t = transfer(isotp::MAX_LEN, sizeof(rxBuf), blockSize, stmin);
+  TEST_ASSERT_TRUE(t.ok);
+  const uint32_t cfs = (isotp::MAX_LEN - 6 + 6) / 7;
+  TEST_ASSERT_EQUAL_UINT32(1 + cfs, t.frames);
+  const uint32_t stUs = isotp::stminToUs(stmin);
+  const uint32_t gap = stUs > FRAME_US ? stUs : FRAME_US;
+  const uint32_t blocks = blockSize ? (cfs + blockSize - 1) / blockSize : 1;
+  TEST_ASSERT_GREATER_OR_EQUAL((cfs - blocks) * stUs, t.us);
+  TEST_ASSERT_LESS_OR_EQUAL(cfs * (gap + 20) + (t.fcs + 1) * 2 * FRAME_US, t.us);
+  char line[128];
+  snprintf(line, sizeof(line), "4095 B, BS=%u STmin=0x%02X: %u frames + %u FC in %u us, %u B/s", blockSize, stmin,
+           t.frames, t.fcs, t.us, (unsigned)(isotp::MAX_LEN * 1000000ULL / t.us));
+  TEST_MESSAGE(line);
+}
+
+void test_max_length_at_stmin_rate(void) {
+  checkStminBound(16, 0x00);
+  checkStminBound(16, 0x01); // 1 ms
+  checkStminBound(0, 0xF5);  // 500 us, one flow control only
+  checkStminBound(8, 0x02);  // 2 ms
+}
+
+void test_every_length_round_trips(void) {
+  for (uint16_t len = 1; len <= isotp::MAX_LEN; ++len) {
+    const Transfer t = transfer(len, sizeof(rxBuf), 16, 0);
+    TEST_ASSERT_TRUE_MESSAGE(t.ok, "message did not come back byte for byte");
+  }
+}
+
+void test_oversize_is_refused(void) {
+  const Transfer t = transfer(isotp::MAX_LEN, 2048, 16, 0);
+  TEST_ASSERT_TRUE(t.refused);
+  TEST_ASSERT_FALSE(t.ok);
+  TEST_ASSERT_EQUAL_UINT32(1, t.frames); // just the first frame
+  TEST_ASSERT_EQUAL_UINT32(1, t.fcs);    // answered with FS_OVFLW
+}
+
+void test_invalid_lengths_are_not_started(void) {
+  IsoTpSender tx;
+  TEST_ASSERT_FALSE(tx.start(msg, 0, 0));
+  TEST_ASSERT_FALSE(tx.start(msg, isotp::MAX_LEN + 1, 0));
+}
+
+int main(int, char **) {
+  for (uint32_t i = 0; i < sizeof(msg); ++i) msg[i] = (uint8_t)(i * 131 + 7);
+  UNITY_BEGIN();
+  RUN_TEST(test_max_length_at_stmin_rate);
+  RUN_TEST(test_every_length_round_trips);
+  RUN_TEST(test_oversize_is_refused);
+  RUN_TEST(test_invalid_lengths_are_not_started);
+  return UNITY_END();
+}
@@ -0,0 +1,66 @@
+/*
+ * JsonLine (pio test -e native)
+ * - Fields that fit come out as one JSON object
+ * - A field that doesn't fit is dropped whole, later fields are too, and the line
+ *   still closes with "truncated": 1 inside the buffer
+ */
+
+#include <string.h>
+#include <unity.h>
+#include <CanStats.h>
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_fields_that_fit(void) {
+  char buf[64];
+  JsonLine j(buf, sizeof(buf));
+  j.add("role", "receiver").add("id", 3);
+  TEST_ASSERT_EQUAL_STRING("{\"role\": \"receiver\", \"id\": 3}", j.finish());
+}
+
+void test_empty_object(void) {
+  char buf[32];
+  JsonLine j(buf, sizeof(buf));
+  TEST_ASSERT_EQUAL_STRING("{}", j.finish());
+}
+
+void test_overflowing_field_is_dropped_whole(void) {
+  // Room for {"a": 1 and the reserved tail, not for ", "bb": 4294967295"
+  char buf[8 + 19 + 4];
+  memset(buf, 'x', sizeof(buf));
+  JsonLine j(buf, sizeof(buf));
+  j.add("a", 1).add("bb", 4294967295u).add("c", 2);
+  TEST_ASSERT_EQUAL_STRING("{\"a\": 1, \"truncated\": 1}", j.finish());
+}
+
+void test_first_field_too_long(void) {
+  char buf[24];
+  JsonLine j(buf, sizeof(buf));
+  j.add("a_rather_long_key", 123456);
+  TEST_ASSERT_EQUAL_STRING("{\"truncated\": 1}", j.finish());
+}
+
+void test_never_writes_past_capacity(void) {
+  char buf[200];
+  for (size_t cap = 20; cap < 120; ++cap) {
+    memset(buf, '#', sizeof(buf));
+    JsonLine j(buf, cap);
+    for (uint32_t i = 0; i < 20; ++i) j.add("counter", i * 100003u);
+    const char *out = j.finish();
+    const size_t len = strlen(out);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(cap - 1, len);
+    TEST_ASSERT_EQUAL('}', out[len - 1]);
+    TEST_ASSERT_EQUAL('#', buf[cap]);
+  }
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_fields_that_fit);
+  RUN_TEST(test_empty_object);
+  RUN_TEST(test_overflowing_field_is_dropped_whole);
+  RUN_TEST(test_first_field_too_long);
+  RUN_TEST(test_never_writes_past_capacity);
+  return UNITY_END();
+}
@@ -0,0 +1,136 @@
+/*
+ * CanPacer against a fake MCP2515 (pio test -e native)
+ * - The fake transmits pending TX buffers highest number first, one frame time each,
+ *   on a simulated clock that idle() advances
+ * - Checks that frames reach the bus in load order, reports the frames/s reached, and
+ *   that the minimum gap and the timeout hold
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <unity.h>
+#include <CanPacer.h>
+
+struct FakeMcp2515 {
+  static const uint32_t FRAME_US = 250; // 8-byte standard frame at 500 kbps, stuffing included
+  static const uint32_t IDLE_US = 5;    // one TXREQ poll over SPI
+
+  uint32_t now;
+  uint8_t pending;
+  struct can_frame txb[3];
+  int8_t onBus;          // buffer being transmitted, -1 = bus idle
+  uint32_t busUntil;
+  bool stuck;            // no ACK: nothing ever leaves the buffers
+  std::vector<uint32_t> sent; // can_id of every transmitted frame, in bus order
+  std::vector<uint32_t> loadUs;
+
+  FakeMcp2515() : now(0), pending(0), onBus(-1), busUntil(0), stuck(false) {}
+
+  uint8_t txPendingMask() {
+    step();
+    return pending;
+  }
+  bool loadTxBuffer(uint8_t n, const struct can_frame &frm) {
+    if (n > 2 || (pending & (1u << n))) return false;
+    txb[n] = frm;
+    pending |= (uint8_t)(1u << n);
+    loadUs.push_back(now);
+    step();
+    return true;
+  }
+  uint32_t micros() { return now; }
+  void idle() {
+    now += IDLE_US;
+    step();
+  }
+
+  // Finish the frame on the bus, then start the highest pending buffer (equal TXP)
+  void step() {
+    if (stuck) return;
+    if (onBus >= 0 && now >= busUntil) {
+      sent.push_back(txb[onBus].can_id);
+      pending &= (uint8_t)~(1u << onBus);
+      onBus = -1;
+    }
+    if (onBus < 0) {
+      for (int8_t n = 2; n >= 0; --n) {
+        if (pending & (1u << n)) {
+          onBus = n;
+          busUntil = (busUntil > now ? busUntil : now) + FRAME_US;
+          break;
+        }
+      }
+    }
+  }
+};
+
+static struct can_frame frameNo(uint32_t i) {
+  struct can_frame f;
+  memset(&f, 0, sizeof(f));
+  f.can_id = i & CAN_SFF_MASK;
+  f.can_dlc = 8;
+  return f;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_pick_buffer_never_reorders(void) {
+  TEST_ASSERT_EQUAL_INT(2, CanPacer<FakeMcp2515>::pickBuffer(0x0));
+  TEST_ASSERT_EQUAL_INT(1, CanPacer<FakeMcp2515>::pickBuffer(0x4));
+  TEST_ASSERT_EQUAL_INT(0, CanPacer<FakeMcp2515>::pickBuffer(0x6));
+  TEST_ASSERT_EQUAL_INT(0, CanPacer<FakeMcp2515>::pickBuffer(0x2));
+  TEST_ASSERT_EQUAL_INT(-1, CanPacer<FakeMcp2515>::pickBuffer(0x1));
+  TEST_ASSERT_EQUAL_INT(-1, CanPacer<FakeMcp2515>::pickBuffer(0x3));
+  TEST_ASSERT_EQUAL_INT(-1, CanPacer<FakeMcp2515>::pickBuffer(0x5));
+  TEST_ASSERT_EQUAL_INT(-1, CanPacer<FakeMcp2515>::pickBuffer(0x7));
+}
+
+void test_frames_keep_load_order_at_bus_rate(void) {
+  static FakeMcp2515 mcp;
+  CanPacer<FakeMcp2515> pacer(mcp);
+  const uint32_t n = 2000;
+  for (uint32_t i = 0; i < n; ++i) TEST_ASSERT_TRUE(pacer.send(frameNo(i)));
+  TEST_ASSERT_TRUE(pacer.flush());
+  TEST_ASSERT_EQUAL_UINT32(n, mcp.sent.size());
+  for (uint32_t i = 0; i < n; ++i) TEST_ASSERT_EQUAL_UINT32(i, mcp.sent[i]);
+
+  const double fps = n * 1e6 / mcp.now;
+  char line[96];
+  snprintf(line, sizeof(line), "%u frames in %u us: %.0f frames/s (bus limit %u)", n, mcp.now, fps,
+           1000000u / FakeMcp2515::FRAME_US);
+  TEST_MESSAGE(line);
+  // Within a few percent of the bus: the pacer only waits while all buffers are busy
+  TEST_ASSERT_TRUE(fps >= 0.95 * 1e6 / FakeMcp2515::FRAME_US);
+  TEST_ASSERT_EQUAL_UINT32(n, pacer.stats().frames);
+  TEST_ASSERT_EQUAL_UINT32(0, pacer.stats().timeouts);
+}
+
+void test_min_gap_spaces_loads(void) {
+  static FakeMcp2515 mcp;
+  CanPacer<FakeMcp2515> pacer(mcp, 5000);
+  for (uint32_t i = 0; i < 50; ++i) TEST_ASSERT_TRUE(pacer.send(frameNo(i)));
+  TEST_ASSERT_TRUE(pacer.flush());
+  for (size_t i = 1; i < mcp.loadUs.size(); ++i) TEST_ASSERT_GREATER_OR_EQUAL(5000u, mcp.loadUs[i] - mcp.loadUs[i - 1]);
+  for (uint32_t i = 0; i < 50; ++i) TEST_ASSERT_EQUAL_UINT32(i, mcp.sent[i]);
+}
+
+void test_times_out_when_buffers_never_drain(void) {
+  static FakeMcp2515 mcp;
+  mcp.stuck = true;
+  CanPacer<FakeMcp2515> pacer(mcp, 0, 1000);
+  for (uint32_t i = 0; i < 3; ++i) TEST_ASSERT_TRUE(pacer.send(frameNo(i)));
+  TEST_ASSERT_FALSE(pacer.send(frameNo(3)));
+  TEST_ASSERT_EQUAL_UINT32(1, pacer.stats().timeouts);
+  TEST_ASSERT_FALSE(pacer.flush());
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_pick_buffer_never_reorders);
+  RUN_TEST(test_frames_keep_load_order_at_bus_rate);
+  RUN_TEST(test_min_gap_spaces_loads);
+  RUN_TEST(test_times_out_when_buffers_never_drain);
+  return UNITY_END();
+}
@@ -0,0 +1,183 @@
+/*
+ * ReassemblyTable and concurrent reassembly (pio test -e native)
+ * - Session/buffer pool exhaustion, oversize and restarted messages, idle eviction
+ *   (also across a micros() wrap), each checked against the ReassemblyStats counters
+ * - Interleaved senders through CanReassembler: frames of several messages mixed on
+ *   the bus all complete byte for byte
+ */
+
+#include <string.h>
+#include <vector>
+#include <unity.h>
+#include <CanFraming.h>
+#include <ReassemblyTable.h>
+#include <CanSegmenter.h>
+#include <CanReassembler.h>
+
+typedef LoopbackHal<4096> TestHal;
+
+static uint8_t msg[2048];
+
+static void checkStats(const ReassemblyStats &st, uint32_t opened, uint32_t completed, uint32_t evicted,
+                       uint32_t aborted, uint32_t dropped) {
+  TEST_ASSERT_EQUAL_UINT32(opened, st.opened);
+  TEST_ASSERT_EQUAL_UINT32(completed, st.completed);
+  TEST_ASSERT_EQUAL_UINT32(evicted, st.evicted);
+  TEST_ASSERT_EQUAL_UINT32(aborted, st.aborted);
+  TEST_ASSERT_EQUAL_UINT32(dropped, st.dropped);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_sessions_get_their_own_buffers(void) {
+  ReassemblyTable<4, 4, 256> t;
+  ReassemblySession *s[4];
+  for (uint32_t k = 0; k < 4; ++k) {
+    s[k] = t.open(k, 200, 0);
+    TEST_ASSERT_NOT_NULL(s[k]);
+    memset(s[k]->data, (int)k, 200);
+  }
+  for (uint32_t k = 0; k < 4; ++k) {
+    TEST_ASSERT_TRUE(t.find(k) == s[k]);
+    for (uint16_t i = 0; i < 200; ++i) TEST_ASSERT_EQUAL_UINT8(k, s[k]->data[i]);
+  }
+  TEST_ASSERT_NULL(t.find(99));
+  TEST_ASSERT_EQUAL_UINT8(4, t.activeCount());
+  checkStats(t.stats(), 4, 0, 0, 0, 0);
+}
+
+void test_buffer_pool_exhaustion_drops_new_messages(void) {
+  ReassemblyTable<4, 2, 256> t; // more sessions than buffers
+  TEST_ASSERT_NOT_NULL(t.open(1, 10, 0));
+  TEST_ASSERT_NOT_NULL(t.open(2, 10, 0));
+  TEST_ASSERT_NULL(t.open(3, 10, 0));
+  checkStats(t.stats(), 2, 0, 0, 0, 1);
+  // Completing one frees its buffer for the next message
+  t.close(t.find(1), ReassemblyTable<4, 2, 256>::COMPLETED);
+  TEST_ASSERT_NOT_NULL(t.open(3, 10, 0));
+  checkStats(t.stats(), 3, 1, 0, 0, 1);
+}
+
+void test_session_exhaustion_drops_new_messages(void) {
+  ReassemblyTable<2, 4, 256> t; // more buffers than sessions
+  TEST_ASSERT_NOT_NULL(t.open(1, 10, 0));
+  TEST_ASSERT_NOT_NULL(t.open(2, 10, 0));
+  TEST_ASSERT_NULL(t.open(3, 10, 0));
+  TEST_ASSERT_EQUAL_UINT8(2, t.activeCount());
+  checkStats(t.stats(), 2, 0, 0, 0, 1);
+}
+
+void test_oversize_and_restart(void) {
+  ReassemblyTable<2, 2, 256> t;
+  TEST_ASSERT_NULL(t.open(1, 257, 0));
+  TEST_ASSERT_NOT_NULL(t.open(1, 256, 0));
+  ReassemblySession *again = t.open(1, 100, 10); // the sender restarted
+  TEST_ASSERT_NOT_NULL(again);
+  TEST_ASSERT_EQUAL_UINT16(100, again->expected);
+  TEST_ASSERT_EQUAL_UINT8(1, t.activeCount());
+  checkStats(t.stats(), 2, 0, 0, 1, 1);
+}
+
+void test_idle_sessions_are_evicted(void) {
+  ReassemblyTable<4, 4, 256> t(1000);
+  t.open(1, 10, 0);
+  t.open(2, 10, 600);
+  TEST_ASSERT_EQUAL_UINT8(0, t.expire(1000)); // exactly the timeout: still open
+  TEST_ASSERT_EQUAL_UINT8(1, t.expire(1001));
+  TEST_ASSERT_NULL(t.find(1));
+  TEST_ASSERT_NOT_NULL(t.find(2));
+  TEST_ASSERT_EQUAL_UINT8(1, t.expire(1601));
+  TEST_ASSERT_EQUAL_UINT8(0, t.activeCount());
+  checkStats(t.stats(), 2, 0, 2, 0, 0);
+}
+
+void test_full_table_evicts_expired_before_dropping(void) {
+  ReassemblyTable<2, 2, 256> t(1000);
+  t.open(1, 10, 0);
+  t.open(2, 10, 500);
+  TEST_ASSERT_NULL(t.open(3, 10, 900));   // nothing idle long enough yet
+  TEST_ASSERT_NOT_NULL(t.open(3, 10, 1200)); // session 1 is, and makes room
+  TEST_ASSERT_NULL(t.find(1));
+  TEST_ASSERT_NOT_NULL(t.find(2));
+  checkStats(t.stats(), 3, 0, 1, 0, 1);
+}
+
+void test_eviction_across_clock_wrap(void) {
+  ReassemblyTable<2, 2, 256> t(1000);
+  t.open(1, 10, 0xFFFFFE00u);
+  TEST_ASSERT_EQUAL_UINT8(0, t.expire(0x100));  // 768 us later
+  TEST_ASSERT_EQUAL_UINT8(1, t.expire(0x300));  // 1280 us later
+}
+
+// Two senders (extended IDs, sources 16 and 17) and a third message on a standard ID,
+// their frames alternating on the bus
+void test_interleaved_senders_complete(void) {
+  static TestHal busA, busB, busC, rxHal;
+  static CanSegmenter<TestHal> a(busA, 0x200, 16), b(busB, 0x200, 17), c(busC, 0x200, 18);
+  static CanReassembler<TestHal, 4, 4, 2048> rx(rxHal, 0x200, 1);
+  TEST_ASSERT_TRUE(a.send(0x01, canframing::FRAMING_EXTENDED, msg, 2000));
+  TEST_ASSERT_TRUE(b.send(0x01, canframing::FRAMING_EXTENDED, msg + 1, 1500));
+  TEST_ASSERT_TRUE(c.send(0x01, canframing::FRAMING_COMPACT, msg + 2, 1000));
+  TestHal *queues[] = {&busA, &busB, &busC};
+  bool more = true;
+  while (more) {
+    more = false;
+    for (TestHal *q : queues) {
+      struct can_frame f;
+      if (!q->receiveFrame(f)) continue;
+      rxHal.sendFrame(f);
+      more = true;
+    }
+  }
+  std::vector<uint16_t> done;
+  RxEvent ev;
+  while (rx.poll(ev)) {
+    TEST_ASSERT_TRUE(ev.type != RxEvent::ERROR);
+    if (ev.type != RxEvent::COMPLETE) continue;
+    const uint8_t *want = ev.received == 2000 ? msg : ev.received == 1500 ? msg + 1 : msg + 2;
+    TEST_ASSERT_EQUAL_MEMORY(want, ev.data, ev.received);
+    done.push_back(ev.received);
+  }
+  TEST_ASSERT_EQUAL_UINT32(3, done.size());
+  checkStats(rx.stats(), 3, 3, 0, 0, 0);
+  TEST_ASSERT_EQUAL_UINT8(0, rx.activeSessions());
+}
+
+// A message whose sender went quiet is evicted by expire() after the session timeout
+void test_stalled_message_is_evicted(void) {
+  static TestHal hal;
+  static CanSegmenter<TestHal> seg(hal, 0x200, 16);
+  static CanReassembler<TestHal, 4, 4, 2048> rx(hal, 0x200, 1, 50000);
+  struct can_frame f;
+  TEST_ASSERT_TRUE(seg.start(0x01, canframing::FRAMING_COMPACT, msg, 500));
+  for (int i = 0; i < 3; ++i) {
+    TEST_ASSERT_TRUE(seg.next(f));
+    hal.sendFrame(f);
+  }
+  RxEvent ev;
+  while (rx.poll(ev)) {}
+  TEST_ASSERT_EQUAL_UINT8(1, rx.activeSessions());
+  hal.now += 50000;
+  rx.expire();
+  TEST_ASSERT_EQUAL_UINT8(1, rx.activeSessions());
+  hal.now += 1;
+  rx.expire();
+  TEST_ASSERT_EQUAL_UINT8(0, rx.activeSessions());
+  checkStats(rx.stats(), 1, 0, 1, 0, 0);
+}
+
+int main(int, char **) {
+  for (uint32_t i = 0; i < sizeof(msg); ++i) msg[i] = (uint8_t)(i * 131 + 7);
+  UNITY_BEGIN();
+  RUN_TEST(test_sessions_get_their_own_buffers);
+  RUN_TEST(test_buffer_pool_exhaustion_drops_new_messages);
+  RUN_TEST(test_session_exhaustion_drops_new_messages);
+  RUN_TEST(test_oversize_and_restart);
+  RUN_TEST(test_idle_sessions_are_evicted);
+  RUN_TEST(test_full_table_evicts_expired_before_dropping);
+  RUN_TEST(test_eviction_across_clock_wrap);
+  RUN_TEST(test_interleaved_senders_complete);
+  RUN_TEST(test_stalled_message_is_evicted);
+  return UNITY_END();
+}
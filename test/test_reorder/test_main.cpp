@@ -0,0 +1,126 @@
+/*
+ * Out-of-order reassembly (pio test -e native)
+ * - Every framing: continuation frames shuffled (seeded) in blocks as wide as the wire
+ *   sequence can place them, the start frame first; each message comes back byte for byte
+ * - A frame already received is ignored (STALE)
+ * - A frame one past that reach is refused as a sequence mismatch
+ */
+
+#include <string.h>
+#include <unity.h>
+#include <CanFraming.h>
+#include <CanSegmenter.h>
+#include <CanReassembler.h>
+
+using canframing::FRAMING_COMPACT;
+using canframing::FRAMING_EXTENDED;
+using canframing::FRAMING_LEGACY;
+
+typedef LoopbackHal<2048> TestHal;
+
+static const canframing::Framing FRAMINGS[] = {FRAMING_LEGACY, FRAMING_COMPACT, FRAMING_EXTENDED};
+static const uint32_t TRIALS = 50;
+
+static TestHal txHal, rxHal;
+static CanSegmenter<TestHal> seg(txHal, 0x200, 16);
+static CanReassembler<TestHal, 4, 4, 8192> rx(rxHal, 0x200, 1);
+static uint8_t msg[8192];
+static struct can_frame frames[sizeof(msg) / 6 + 2];
+
+static uint32_t xorshift(uint32_t &s) {
+  s ^= s << 13;
+  s ^= s >> 17;
+  s ^= s << 5;
+  return s;
+}
+
+// Shuffle frames[1..n) within consecutive blocks of `block` frames
+static void shuffleBlocks(struct can_frame *f, uint32_t n, uint16_t block, uint32_t &rng) {
+  for (uint32_t b = 1; b < n; b += block) {
+    const uint32_t end = b + block < n ? b + block : n;
+    for (uint32_t i = end - 1; i > b; --i) {
+      const uint32_t j = b + xorshift(rng) % (i - b + 1);
+      const struct can_frame tmp = f[i];
+      f[i] = f[j];
+      f[j] = tmp;
+    }
+  }
+}
+
+// Segment msg[0..len) into frames[]; the frame count, or 0 if the segmenter refused it
+static uint32_t segment(canframing::Framing f, uint16_t len) {
+  if (!seg.send(0x01, f, msg, len)) return 0;
+  uint32_t n = 0;
+  while (txHal.receiveFrame(frames[n])) n++;
+  return n;
+}
+
+static uint16_t reach(canframing::Framing f) { return (uint16_t)(canframing::seqMask(f) / 2); }
+
+void setUp(void) {
+  for (uint32_t i = 0; i < sizeof(msg); ++i) msg[i] = (uint8_t)(i * 131 + 7);
+}
+void tearDown(void) {}
+
+void test_shuffled_frames_reassemble(void) {
+  static const uint16_t lengths[] = {1, 6, 8, 100, 2048, 4095};
+  uint32_t rng = 1;
+  for (size_t k = 0; k < 3; ++k) {
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l) {
+      const uint16_t len = lengths[l];
+      for (uint32_t t = 0; t < TRIALS; ++t) {
+        const uint32_t n = segment(FRAMINGS[k], len);
+        TEST_ASSERT_EQUAL_UINT32(canframing::framesForLength(FRAMINGS[k], len), n);
+        shuffleBlocks(frames, n, reach(FRAMINGS[k]), rng);
+        RxEvent ev = RxEvent();
+        for (uint32_t i = 0; i < n; ++i) {
+          rx.onFrame(frames[i], ev);
+          TEST_ASSERT_TRUE(ev.type != RxEvent::ERROR);
+          if (i < n - 1) TEST_ASSERT_TRUE(ev.type != RxEvent::COMPLETE);
+        }
+        TEST_ASSERT_TRUE(ev.type == RxEvent::COMPLETE);
+        TEST_ASSERT_EQUAL_UINT32(len, ev.received);
+        TEST_ASSERT_EQUAL_MEMORY(msg, ev.data, len);
+      }
+    }
+  }
+}
+
+void test_duplicate_frame_is_ignored(void) {
+  for (size_t k = 0; k < 3; ++k) {
+    const uint32_t n = segment(FRAMINGS[k], 100);
+    TEST_ASSERT_EQUAL_UINT32(canframing::framesForLength(FRAMINGS[k], 100), n);
+    RxEvent ev;
+    for (uint32_t i = 0; i < n - 1; ++i) rx.onFrame(frames[i], ev);
+    rx.onFrame(frames[1], ev);
+    TEST_ASSERT_TRUE(ev.type == RxEvent::STALE);
+    rx.onFrame(frames[n - 1], ev);
+    TEST_ASSERT_TRUE(ev.type == RxEvent::COMPLETE);
+    TEST_ASSERT_EQUAL_MEMORY(msg, ev.data, 100);
+  }
+}
+
+void test_frame_beyond_reach_is_refused(void) {
+  for (size_t k = 0; k < 3; ++k) {
+    const canframing::Framing f = FRAMINGS[k];
+    const uint16_t block = reach(f);
+    // Swap the first continuation frame with the one `block` further on
+    TEST_ASSERT_GREATER_OR_EQUAL(2u + block, segment(f, (uint16_t)(canframing::contOffset(f, 1 + block) + 1)));
+    const struct can_frame tmp = frames[1];
+    frames[1] = frames[1 + block];
+    frames[1 + block] = tmp;
+    RxEvent ev;
+    rx.onFrame(frames[0], ev);
+    rx.onFrame(frames[1], ev);
+    TEST_ASSERT_TRUE(ev.type == RxEvent::ERROR);
+    TEST_ASSERT_TRUE(ev.error == RxEvent::ERR_SEQ_MISMATCH);
+  }
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_shuffled_frames_reassemble);
+  RUN_TEST(test_duplicate_frame_is_ignored);
+  RUN_TEST(test_frame_beyond_reach_is_refused);
+  return UNITY_END();
+}
@@ -0,0 +1,103 @@
+/*
+ * CanSegmenter -> LoopbackHal -> CanReassembler round trips (pio test -e native)
+ * - Every framing, lengths around the start/continuation frame boundaries up to 65535
+ * - Group, broadcast and foreign targets, the CRC trailer and FEC parity frames
+ */
+
+#include <string.h>
+#include <unity.h>
+#include <CanFraming.h>
+#include <CanSegmenter.h>
+#include <CanReassembler.h>
+
+typedef LoopbackHal<16384> TestHal; // holds a whole 65535-byte legacy message
+
+static const canframing::Framing FRAMINGS[] = {canframing::FRAMING_LEGACY, canframing::FRAMING_COMPACT,
+                                               canframing::FRAMING_EXTENDED};
+
+static TestHal hal;
+static CanSegmenter<TestHal> seg(hal, 0x200, 16);
+static CanReassembler<TestHal, 4, 4, 65535> rx(hal, 0x200, 1);
+static uint8_t msg[65535];
+
+// Reassemble what the segmenter queued: 1 if `len` bytes of msg came back byte for
+// byte, 0 if nothing completed, -1 on a mismatch
+static int drain(uint16_t len) {
+  RxEvent ev;
+  int result = 0;
+  while (rx.poll(ev)) {
+    if (ev.type != RxEvent::COMPLETE) continue;
+    result = ev.received == len && memcmp(ev.data, msg, len) == 0 ? 1 : -1;
+  }
+  return result;
+}
+
+void setUp(void) {
+  seg.setChecksum(false);
+  RxEvent ev;
+  while (rx.poll(ev)) {}
+}
+
+void tearDown(void) {}
+
+void test_round_trip_every_framing(void) {
+  static const uint16_t lengths[] = {0, 1, 4, 5, 6, 7, 8, 11, 12, 13, 14, 15, 100, 1534, 2048, 4095, 65535};
+  for (size_t k = 0; k < 3; ++k) {
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l) {
+      const uint16_t len = lengths[l];
+      const uint32_t before = hal.sent;
+      TEST_ASSERT_TRUE(seg.send(0x01, FRAMINGS[k], msg, len));
+      TEST_ASSERT_EQUAL_UINT32(canframing::framesForLength(FRAMINGS[k], len), hal.sent - before);
+      TEST_ASSERT_EQUAL_INT_MESSAGE(1, drain(len), "message did not come back byte for byte");
+    }
+  }
+}
+
+void test_round_trip_with_crc_trailer(void) {
+  seg.setChecksum(true);
+  for (size_t k = 0; k < 3; ++k) {
+    TEST_ASSERT_TRUE(seg.send(0x01, FRAMINGS[k], msg, 2048));
+    TEST_ASSERT_EQUAL_INT(1, drain(2048));
+  }
+}
+
+void test_round_trip_with_fec(void) {
+  for (size_t k = 0; k < 3; ++k) {
+    TEST_ASSERT_TRUE(seg.send(0x01, FRAMINGS[k], msg, 2000, 0, 8));
+    TEST_ASSERT_EQUAL_INT(1, drain(2000));
+  }
+}
+
+void test_group_and_broadcast_reach_receiver(void) {
+  for (size_t k = 0; k < 3; ++k) {
+    TEST_ASSERT_TRUE(seg.send(0x15, FRAMINGS[k], msg, 100)); // receivers 1, 3, 5
+    TEST_ASSERT_EQUAL_INT(1, drain(100));
+    TEST_ASSERT_TRUE(seg.send(canframing::RECEIVER_MASK_ALL, FRAMINGS[k], msg, 100));
+    TEST_ASSERT_EQUAL_INT(1, drain(100));
+  }
+}
+
+void test_other_receivers_frames_are_foreign(void) {
+  for (size_t k = 0; k < 3; ++k) {
+    TEST_ASSERT_TRUE(seg.send(0x02, FRAMINGS[k], msg, 100));
+    RxEvent ev;
+    while (rx.poll(ev)) TEST_ASSERT_EQUAL(RxEvent::FOREIGN, ev.type);
+  }
+}
+
+void test_invalid_target_is_refused(void) {
+  TEST_ASSERT_FALSE(seg.send(0x00, canframing::FRAMING_COMPACT, msg, 10));
+  TEST_ASSERT_FALSE(seg.send(0x20, canframing::FRAMING_COMPACT, msg, 10));
+}
+
+int main(int, char **) {
+  for (uint32_t i = 0; i < sizeof(msg); ++i) msg[i] = (uint8_t)(i * 131 + 7);
+  UNITY_BEGIN();
+  RUN_TEST(test_round_trip_every_framing);
+  RUN_TEST(test_round_trip_with_crc_trailer);
+  RUN_TEST(test_round_trip_with_fec);
+  RUN_TEST(test_group_and_broadcast_reach_receiver);
+  RUN_TEST(test_other_receivers_frames_are_foreign);
+  RUN_TEST(test_invalid_target_is_refused);
+  return UNITY_END();
+}